@@ -0,0 +1,38 @@
+#ifndef ABSMOUSE_H
+#define ABSMOUSE_H
+
+#include <Arduino.h>
+#include <USBHID.h>
+
+/*
+ * Absolute mouse module
+ * - Extra HID pointer interface reporting X/Y as absolute 0-32767
+ *   coordinates, so one report places the cursor anywhere on screen
+ *   regardless of host acceleration or resolution
+ * - Always present in the USB descriptor; `MOUSE:MOVE`/`MOUSE:RESET`
+ *   only use it when enabled (persisted, see storage.h)
+ * - Pixel coordinates from macros are scaled using the configured
+ *   screen size (default 1920x1080)
+ */
+
+#define HID_REPORT_ID_ABS_MOUSE (HID_REPORT_ID_VENDOR + 1)
+#define ABS_MOUSE_MAX 32767
+
+class USBHIDAbsMouse : public USBHIDDevice {
+public:
+  USBHIDAbsMouse();
+  void begin();
+  bool moveTo(uint16_t x, uint16_t y);  // logical 0..ABS_MOUSE_MAX
+  uint16_t _onGetDescriptor(uint8_t* buffer) override;
+
+private:
+  USBHID hid;
+};
+
+// Runtime configuration (applied from NVS when HID mode starts)
+void absMouseConfigure(bool enabled, uint16_t screenWidth, uint16_t screenHeight);
+bool absMouseEnabled();
+// Place the cursor at screen pixel (x, y); false if disabled
+bool absMouseMoveTo(int x, int y);
+
+#endif
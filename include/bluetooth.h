@@ -2,6 +2,7 @@
 #define BLUETOOTH_H
 
 #include <Arduino.h>
+#include "spscring.h"
 
 // BLE mode constant
 #define MODE_BLE 2
@@ -11,6 +12,7 @@ void startBLEMode();
 void stopBLEMode();
 bool isBLEDataAvailable();
 String readBLEData();
+RingStats bleRxQueueStats();  // BLE callback -> loop() line queue
 void sendBLEResponse(const String& msg);
 void sendBLECSV(const String& name, const String& password);
 bool isBLEConnected();
@@ -45,7 +45,7 @@ void showHelpScreen();
 void drawBootMenu(int selectedIndex);
 
 // File selection menu
-void drawFileMenu(int selectedIndex, String fileList[], int fileCount);
+void drawFileMenu(int selectedIndex, int fileCount);
 
 // Macro recording display
 void showRecordingScreen(const String& filename);
@@ -2,21 +2,84 @@
 #define DUCKYSCRIPT_H
 
 #include <Arduino.h>
+#include <FS.h>
+#include <esp_timer.h>
+#include "keytable.h"
 
 /*
  * DuckyScript module
  * - Parses and executes RubberDucky script format
  * - Compatible with classic DuckyScript syntax (DELAY, STRING, REM, etc.)
  * - Converts DuckyScript commands to USB HID keyboard actions
+ * - Scripts stream through a fixed line buffer, so SD files of any size
+ *   run in constant RAM; a STRING longer than the buffer is typed in
+ *   pieces
+ * - Each line is parsed once into a command record; `REPEAT n` replays
+ *   the previous record without re-parsing
+ * - Pauses run on esp_timer deadlines: `DELAY` and the default delay
+ *   between commands (`DEFAULT_DELAY n`, 10 ms unless set) only move the
+ *   deadline, which the next keystroke waits for
  */
 
+#define DUCKY_LINE_MAX 256          // longest command line kept in the buffer
+#define DUCKY_READ_CHUNK 512        // SD read size for processDuckyScriptFile()
+#define DUCKY_DEFAULT_DELAY_MS 10   // gap between commands until DEFAULT_DELAY
+
+enum DuckyCommandKind : uint8_t {
+  DUCKY_NONE = 0,
+  DUCKY_DELAY,
+  DUCKY_STRING,
+  DUCKY_STRINGLN,
+  DUCKY_KEYS
+};
+
+// Parsed form of one line, kept for REPEAT
+struct DuckyCommand {
+  DuckyCommandKind kind;
+  uint8_t keyCount;
+  uint8_t keys[KEY_COMBO_MAX];
+  uint32_t ms;
+  size_t textLen;
+  char text[DUCKY_LINE_MAX];
+};
+
+// Splits a byte stream into lines and executes each as it completes
+class DuckyScriptStream {
+public:
+  DuckyScriptStream();
+  void feed(const char* data, size_t len);
+  void finish();  // runs the last line and waits out the final pause
+
+private:
+  enum Overflow : uint8_t { OVERFLOW_NONE, OVERFLOW_STRING, OVERFLOW_STRINGLN, OVERFLOW_SKIP };
+
+  void spill();    // line buffer full
+  void endLine();
+  void runLine(const char* s, size_t len);
+  bool parse(const char* s, size_t len, DuckyCommand& cmd);
+  void run(const DuckyCommand& cmd);
+  void schedule(uint32_t ms);
+  void waitDue();
+
+  char line[DUCKY_LINE_MAX];
+  size_t len;
+  Overflow overflow;
+  DuckyCommand last;        // previous command, for REPEAT
+  uint32_t defaultDelayMs;
+  int64_t due;              // esp_timer deadline of the next keystroke
+};
+
 // Process a single line of DuckyScript
 void processDuckyScriptLine(const String& line);
 
 // Process entire DuckyScript text (multi-line)
 void processDuckyScript(const String& script);
 
+// Run a script straight from an open file (from its current position)
+void processDuckyScriptFile(File& f);
+
 // Check if a file appears to be DuckyScript format
 bool isDuckyScriptFile(const String& content);
+bool isDuckyScriptFile(const char* content, size_t len);
 
 #endif
@@ -0,0 +1,27 @@
+#ifndef HIDLOCK_H
+#define HIDLOCK_H
+
+#include <Arduino.h>
+
+/*
+ * HID lock module
+ * - One recursive mutex shared by everything that sends HID reports or
+ *   changes key/button state: the HID task (live input) and loop() (file
+ *   playback, scripts, DuckyScript, BLE typing)
+ * - Taken per report or per op, never across a delay, so live input in
+ *   the HID task waits for at most one report from loop()
+ * - A no-op until hidLockBegin(), while only one task drives HID
+ */
+
+void hidLockBegin();  // before the HID task is started
+void hidLock();
+void hidUnlock();
+
+// Scoped hidLock()/hidUnlock()
+class HidLockGuard {
+public:
+  HidLockGuard() { hidLock(); }
+  ~HidLockGuard() { hidUnlock(); }
+};
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef HIDTASK_H
+#define HIDTASK_H
+
+#include <Arduino.h>
+#include "spscring.h"
+
+/*
+ * HID task module
+ * - Live BLE input (KEY:/MOUSE:/TYPE:/GAMEPAD: and relayed text) is
+ *   decoded in loop(): the BLE callback only splits writes into lines
+ *   (bluetooth.cpp), processBLELine() compiles each line to macro ops
+ *   (livectl.cpp for K:/M: frames) and queues them in a lock-free SPSC ring
+ * - A FreeRTOS task pinned to the core loop() doesn't run on drains the
+ *   ring through its own MacroVM, so HID timing doesn't wait on display,
+ *   SD or command parsing in loop(). That core also runs the BLE host,
+ *   whose tasks have a higher priority but only run briefly per packet
+ * - Relative mouse motion and wheel ticks are coalesced (see mouseacc.h)
+ *   and flushed once per HID poll interval
+ * - Before the task is started, queued text runs synchronously instead
+ * - HID output from loop() still happens (file playback, scripts); both
+ *   sides serialize reports through hidlock.h
+ */
+
+#ifdef ARDUINO_RUNNING_CORE
+#define HID_TASK_CORE (ARDUINO_RUNNING_CORE == 0 ? 1 : 0)  // not loop()'s core
+#else
+#define HID_TASK_CORE 0          // loop() runs on core 1 by default
+#endif
+#define HID_TASK_PRIORITY 2      // above idle, below the BLE host tasks
+#define HID_TASK_STACK 4096
+#define HID_QUEUE_SIZE 2048      // bytes of queued ops
+#define HID_QUEUE_WAIT_MS 100    // producer back-off before dropping an op
+
+void hidTaskStart();
+
+// Compile one line of live macro text and queue it; false if any op was
+// dropped because the HID task couldn't keep up
+bool hidQueueMacroText(const String& text);
+// Queue already encoded macro ops (whole ops, at most MACRO_OP_MAX bytes)
+bool hidQueueOps(const uint8_t* ops, size_t len);
+
+RingStats hidQueueStats();
+
+#endif
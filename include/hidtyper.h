@@ -0,0 +1,40 @@
+#ifndef HIDTYPER_H
+#define HIDTYPER_H
+
+#include <Arduino.h>
+
+/*
+ * HID typer module
+ * - Types ASCII text by building raw keyboard reports from a precomputed
+ *   ASCII -> (usage, shift) table (US layout, like Keyboard.write())
+ * - Paced mode: one key per report, optional per-character gap
+ * - Turbo mode: packs up to 6 non-conflicting keys (same modifier state,
+ *   no repeated usage) into one report, then releases them
+ * - Typed reports are merged with the keys held through hidKeyPress(), and
+ *   releasing the typed keys sends the held report back, so holds made by
+ *   macros and Live Control stay down while text is typed
+ * - Reports are paced by the host: USBHID blocks in sendReport() until the
+ *   previous report has been polled, so no fixed sleeps are needed
+ */
+
+// Map one ASCII byte to a HID usage and report modifier bits; false if
+// the character can't be typed
+bool hidAsciiToKey(uint8_t c, uint8_t& usage, uint8_t& modifiers);
+
+// Keyboard.press/release/releaseAll that also track the held report;
+// use these instead of calling Keyboard directly
+void hidKeyPress(uint8_t k);
+void hidKeyRelease(uint8_t k);
+void hidKeyReleaseAll();
+
+// Type the next report's worth of `s` (one key, or one packed batch in
+// turbo mode) and release it; returns how many bytes were consumed
+size_t hidTypeStep(const uint8_t* s, size_t len, bool turbo);
+
+// Type `len` bytes. `gapMs` is only used in paced mode.
+void hidTypeBytes(const uint8_t* s, size_t len, bool turbo, uint8_t gapMs);
+inline void hidTypeText(const String& text, bool turbo, uint8_t gapMs) {
+  hidTypeBytes((const uint8_t*)text.c_str(), text.length(), turbo, gapMs);
+}
+
+#endif
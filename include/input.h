@@ -57,7 +57,7 @@ void checkCode();
 void showDigitScreen();
 void drawMenu();
 void drawBootMenu(int selectedIndex);
-void drawFileMenu(int selectedIndex, String fileList[], int fileCount);
+void drawFileMenu(int selectedIndex, int fileCount);
 
 // Forward declarations (usb.cpp)
 void sendPassword(String password);
@@ -0,0 +1,30 @@
+#ifndef KEYTABLE_H
+#define KEYTABLE_H
+
+#include <Arduino.h>
+
+/*
+ * Key table module
+ * - One name -> keycode table shared by macros, Live Control key relay
+ *   and DuckyScript (`enter`, `f12`, `ctrl`, `rwin`, ...)
+ * - Kept sorted at compile time (checked by static_assert); lookups are
+ *   case-insensitive binary searches with no allocation
+ * - Keycodes are the USBHIDKeyboard press()/release() codes
+ */
+
+#define KEY_COMBO_MAX 8  // modifiers + final key
+
+// Keycode for a key name, or for a single character as itself; 0 if unknown
+uint8_t keyCodeFromName(const char* name, size_t len);
+inline uint8_t keyCodeFromName(const char* name) { return keyCodeFromName(name, strlen(name)); }
+
+// Keycode for a modifier name (ctrl, alt, shift, gui, r*...); 0 otherwise
+uint8_t keyModifierFromName(const char* name, size_t len);
+
+// Parse "ctrl+alt+delete" (or "CTRL ALT DELETE" with seps = " "): every
+// part before the last is a modifier, unknown modifiers are skipped.
+// Writes press order into `codes`, returns how many were written.
+uint8_t keyParseCombo(const char* spec, size_t len, const char* seps,
+                      uint8_t* codes, uint8_t maxCodes);
+
+#endif
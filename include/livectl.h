@@ -0,0 +1,38 @@
+#ifndef LIVECTL_H
+#define LIVECTL_H
+
+#include <Arduino.h>
+
+/*
+ * Live Control frame module
+ * - Compact keyboard/mouse frames from the Live Control app, decoded
+ *   ahead of the BLE command parser and queued to the HID task as macro
+ *   ops (no macro text is built or re-parsed)
+ * - Key codes sent as numbers are Android KeyEvent keycodes (the app
+ *   forwards them unchanged: 29 = A, 66 = ENTER, 131 = F1, ...)
+ * - Text frames:
+ *     K:code:D / K:code:U   key down / up; `code` is an Android keycode,
+ *                           a single character or a key name (`enter`)
+ *     M:dx:dy[:action]      relative move, then the action: L or R
+ *                           clicks, M is a plain move, W:+ / W:- (or
+ *                           W:+n) scrolls
+ * - Binary frames are LIVE_FRAME_SIZE bytes starting with LIVE_FRAME_MARK
+ *   (a byte UTF-8 text never contains) at the start of a line; the BLE
+ *   callback reassembles one split across writes:
+ *     FF 'K' code(Android) down(0/1) 0 0
+ *     FF 'M' dx(i8) dy(i8) buttons(bit0 L, bit1 R, bit2 M) wheel(i8),
+ *            the buttons stay held until a frame clears them
+ *     FF 'R' 0 0 0 0        release every key and button frames left held
+ *                           (queued by the BLE layer on disconnect)
+ * - Frames don't reply over BLE and aren't recorded by RECORD
+ */
+
+#define LIVE_FRAME_MARK 0xFF
+#define LIVE_FRAME_SIZE 6
+#define LIVE_FRAME_RELEASE 'R'
+
+// Decode and queue one frame; false if `line` isn't a valid frame (it is
+// then handled as a normal command)
+bool liveControlFrame(const char* line, size_t len);
+
+#endif
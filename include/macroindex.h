@@ -0,0 +1,89 @@
+#ifndef MACROINDEX_H
+#define MACROINDEX_H
+
+#include <Arduino.h>
+#include <FS.h>
+
+/*
+ * Macro index module
+ * - Keeps `/.pwindex` on SD: one fixed-size record per `.txt` macro,
+ *   including ones in subdirectories, with its size, mtime, content
+ *   hash, detected format and whether a fresh compiled `.mbc` exists
+ * - Records are sorted by name (all-numeric names first, in numeric
+ *   order), so the file menu, LIST and format lookups read single
+ *   records by seek instead of walking the card with openNextFile()
+ * - A cursor walks the records from any position with an optional name
+ *   prefix ("work/" lists one folder), so listings page through any
+ *   number of files without holding them in RAM
+ * - Built once by a full scan (sorted runs, merged in a few sequential
+ *   passes), then updated one file at a time when a
+ *   macro is saved, recorded or optimized. Dropped before the card is
+ *   exported over USB mass storage (the host may change anything)
+ * - Writes go to a temp file that replaces the index, so a power cut
+ *   leaves either the old index or none (which triggers a rebuild)
+ */
+
+#define MACRO_INDEX_PATH "/.pwindex"
+#define MACRO_INDEX_NAME_MAX 80   // path without leading '/' and ".txt"
+#define MACRO_INDEX_CHUNK 32      // records sorted in RAM per run while rebuilding
+#define MACRO_INDEX_MERGE_WAYS 16 // runs merged at once per rebuild pass (<= CHUNK)
+#define MACRO_FORMAT_SAMPLE 512   // leading bytes classified by macroDetectFormat()
+
+enum MacroFileFormat : uint8_t {
+  MACRO_FORMAT_MACRO = 0,
+  MACRO_FORMAT_DUCKY,
+  MACRO_FORMAT_ADVANCED
+};
+
+#define MACRO_INDEX_CACHED 0x01   // flags: compiled cache matches the source
+
+struct MacroIndexEntry {
+  char name[MACRO_INDEX_NAME_MAX];
+  uint32_t size;
+  uint32_t mtime;
+  uint32_t hash;
+  uint8_t format;   // MacroFileFormat
+  uint8_t flags;
+  uint8_t reserved[2];
+};
+
+// Load the index, rebuilding it from a card scan if missing or corrupt
+bool macroIndexLoad(fs::FS& fs);
+bool macroIndexRebuild(fs::FS& fs);
+void macroIndexDrop(fs::FS& fs);
+uint32_t macroIndexCount();
+
+// Rescan one file (`name` as stored: "login" or "work/login", without
+// '/' prefix or ".txt"); removes the record if the file no longer exists
+bool macroIndexUpdate(fs::FS& fs, const String& name);
+bool macroIndexSetCached(fs::FS& fs, const String& name, bool cached);
+bool macroIndexFind(fs::FS& fs, const String& name, MacroIndexEntry& entry);
+
+// Sequential access: open once, then read records by sorted position
+bool macroIndexOpen(fs::FS& fs, File& index);
+bool macroIndexReadAt(File& index, uint32_t pos, MacroIndexEntry& entry);
+uint32_t macroIndexLowerBound(File& index, const String& name);  // first record >= name
+
+// Paged listing: records from sorted position `from` whose names start
+// with `prefix`. After each macroIndexNext(), `last` is the record's
+// position and `pos` the position to resume from (a later page's `from`)
+struct MacroIndexCursor {
+  File index;
+  String prefix;
+  uint32_t pos;
+  uint32_t last;
+};
+
+bool macroIndexBegin(fs::FS& fs, MacroIndexCursor& cur, uint32_t from, const String& prefix = "");
+bool macroIndexNext(MacroIndexCursor& cur, MacroIndexEntry& entry);
+void macroIndexEnd(MacroIndexCursor& cur);
+
+// Create the directories above `path` ("/work/vpn/login.txt")
+bool macroMakeParentDirs(fs::FS& fs, const String& path);
+
+// Format of a file from its first MACRO_FORMAT_SAMPLE bytes: an explicit
+// "#!macro" / "#!ducky" / "#!script" first line wins, else the detectors
+MacroFileFormat macroDetectFormat(const char* sample, size_t len);
+const char* macroFormatName(uint8_t format);
+
+#endif
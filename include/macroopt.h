@@ -0,0 +1,98 @@
+#ifndef MACROOPT_H
+#define MACROOPT_H
+
+#include "macrotok.h"
+
+/*
+ * Macro optimizer module
+ * - Rewrites `{{TOKEN}}` macro text into a smaller file that plays the
+ *   same: consecutive delays merge (zero delays vanish), adjacent
+ *   relative mouse moves fold into one, and single-character text and
+ *   `{{KEY:c}}` presses join into text runs.
+ * - Optional slack (ms): pauses up to that long between joinable items
+ *   are moved after the joined run instead of splitting it. Total
+ *   duration is kept; 0 keeps every event at its original time.
+ * - Estimates play time before and after with the VM's timing rules
+ *   (absolute delay schedule restarted after typing, key holds and
+ *   scrolls; key hold; per-character gap).
+ * - Only needs the tokenizer, so it builds on a host too
+ *   (tools/macroopt); `OPTIMIZE:file` runs it on the device.
+ */
+
+#define MACRO_OPT_TEXT_MAX 255  // longest text run kept before flushing
+
+// Destination for optimized macro text
+class MacroTextSink {
+public:
+  virtual ~MacroTextSink() {}
+  virtual void write(const char* s, size_t len) = 0;
+};
+
+struct MacroOptStats {
+  uint32_t eventsIn;    // tokens and text runs read
+  uint32_t eventsOut;   // tokens and text runs written
+  uint32_t bytesOut;
+  uint32_t playMsIn;    // estimated play time
+  uint32_t playMsOut;
+};
+
+// Play-time model of MacroVM for a file played from SD
+class MacroPlayClock {
+public:
+  explicit MacroPlayClock(uint16_t keyHoldMs);
+  void token(const char* body);  // DELAY, KEY, SPEED, TURBO, MOUSE:SCROLL
+  void text(size_t chars);
+  uint32_t totalMs() const;
+
+private:
+  uint16_t holdMs;
+  uint8_t speedMs;
+  bool turbo;
+  uint64_t now;       // work clock
+  uint64_t schedule;  // DELAY schedule base (see MacroVM)
+};
+
+class MacroOptimizer : public MacroTokenizer {
+public:
+  MacroOptimizer(MacroTextSink& out, uint16_t slackMs = 0, uint16_t keyHoldMs = 50);
+  const MacroOptStats& stats() const { return st; }
+
+protected:
+  void onText(const char* s, size_t len) override;
+  void onToken(char* body, size_t len) override;
+  void onHeader(const char* s, size_t len) override;
+  void onFinish() override;
+
+private:
+  enum Group : uint8_t { GROUP_NONE, GROUP_TEXT, GROUP_REL };
+
+  void join(Group kind);     // extend the open group or start a new one
+  void flush();              // open group, then the pending pause
+  void flushGroup();
+  void flushDelay();
+  void appendText(const char* s, size_t len);
+  void emitToken(const char* body);
+  void emitText(const char* s, size_t len);
+  void put(const char* s, size_t len);
+
+  MacroTextSink& out;
+  uint16_t slack;
+  MacroPlayClock clockIn;
+  MacroPlayClock clockOut;
+  MacroOptStats st;
+  Group group;
+  uint32_t delayMs;     // pause read since the last item
+  uint32_t deferredMs;  // pauses moved behind the open group
+  long relX, relY;
+  char text[MACRO_OPT_TEXT_MAX];
+  size_t textLen;
+};
+
+#ifdef ARDUINO
+// Optimize `srcPath` in place (original kept as `.bak`); false on I/O
+// error. `bytesIn` receives the original size.
+bool macroOptimizeFile(fs::FS& fs, const String& srcPath, uint16_t slackMs,
+                       MacroOptStats& stats, uint32_t& bytesIn);
+#endif
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef MACROTOK_H
+#define MACROTOK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <FS.h>
+#endif
+
+/*
+ * Macro tokenizer module
+ * - `MacroTokenizer` is the only `{{...}}` parser in the firmware; live
+ *   BLE text, SD files, the compiler and the optimizer all go through it.
+ * - Newlines outside tokens are skipped, so files can put one token per
+ *   line without typing Enter.
+ * - Files may start with a format header line ("#!macro", "#!ducky",
+ *   "#!script"); file feeds report it through onHeader() instead of
+ *   typing it.
+ * - Free of HID and SD dependencies (String/File overloads only exist in
+ *   Arduino builds), so it also compiles on a host.
+ */
+
+#define MACRO_TOKEN_MAX 256       // longest {{...}} body kept by the tokenizer
+#define MACRO_FEED_CHUNK 256      // SD read size used by feedFile()
+#define MACRO_DELAY_MAX_MS 5000   // longest single {{DELAY:n}}
+
+// Streaming `{{TOKEN}}` scanner shared by every macro text path (BLE
+// lines and SD files). Works on fixed buffers only: feed a String, raw
+// bytes or a whole file in 256-byte chunks, then finish(). Subclasses
+// receive literal text runs and trimmed, NUL-terminated token bodies.
+class MacroTokenizer {
+public:
+  MacroTokenizer();
+  virtual ~MacroTokenizer() {}
+  void feed(const char* data, size_t len);
+#ifdef ARDUINO
+  void feed(const String& text) { feed(text.c_str(), text.length()); }
+  void feedFile(File& f);  // accepts a header
+#endif
+  // Treat a leading "#!..." line of the next feed() as a header
+  void acceptHeader() { headerPending = true; }
+  void finish();
+
+protected:
+  virtual void onText(const char* s, size_t len) = 0;
+  virtual void onToken(char* body, size_t len) = 0;  // body may be modified
+  virtual void onHeader(const char* s, size_t len) {}  // includes the newline
+  virtual void onFinish() {}
+
+private:
+  bool headerPending;
+  bool inToken;
+  bool sawFirstBrace;
+  char token[MACRO_TOKEN_MAX + 2];
+  size_t tokenLen;
+};
+
+// Length of a leading "#!..." header line including its newline, 0 if
+// `data` doesn't start with one
+size_t macroHeaderLength(const char* data, size_t len);
+// Trim whitespace in place; returns the new start and updates len
+char* macroTrimSpan(char* s, size_t& len);
+// Split the recorder's mouse form "dx_dy_ACTION" (e.g. "5_-3_MOVE_REL");
+// `action` points into `cmd`
+bool macroParseRecordedMouse(const char* cmd, long& dx, long& dy, const char*& action);
+
+#endif
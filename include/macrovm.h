@@ -0,0 +1,220 @@
+#ifndef MACROVM_H
+#define MACROVM_H
+
+#include <Arduino.h>
+#include <FS.h>
+#include <esp_timer.h>
+#include "macrotok.h"
+
+/*
+ * Macro VM module
+ * - Compiles PWDongle `{{TOKEN}}` macro text into a compact opcode stream
+ *   so playback never re-parses text or allocates between HID reports.
+ * - Compiled files are cached on SD next to their source
+ *   (`/name.txt` -> `/name.mbc`) and rebuilt when the source size, mtime
+ *   or content hash changes.
+ * - `MacroVM` executes opcodes either from a cache file or pushed
+ *   straight from the compiler (uncached, in-memory playback).
+ * - File playback is non-blocking: `loop()` calls macroPlaybackStep(),
+ *   which never sleeps, so BLE commands keep flowing during a macro.
+ * - Parsing goes through `MacroTokenizer` (macrotok.h), shared with the
+ *   optimizer.
+ * - DELAY ops advance an absolute esp_timer schedule, so each event is due
+ *   at its cumulative offset and HID/parse time never adds up as drift.
+ *   Typing, key holds and scrolls restart the schedule when they finish,
+ *   so a DELAY written after them still waits its full length.
+ *   File playback records how late each deadline was hit (MacroTiming).
+ * - File playback can run at a speed factor: adjacent DELAYs merge into
+ *   one gap, which is scaled; the next event is then held back to at
+ *   least a minimum gap after the previous one (not applied at 1x).
+ */
+
+// Opcodes: one byte followed by little-endian operands
+enum MacroOp : uint8_t {
+  MOP_END = 0x00,
+  MOP_DELAY,          // u16 ms
+  MOP_SPEED,          // u8 ms between typed characters
+  MOP_KEY,            // u8 n, n keycodes (pressed in order, released in reverse)
+  MOP_TEXT,           // u8 n, n bytes typed via Keyboard.write()
+  MOP_MOUSE_RESET,    // -
+  MOP_MOUSE_MOVE,     // i16 x, i16 y (absolute)
+  MOP_MOUSE_REL,      // i16 dx, i16 dy
+  MOP_MOUSE_DOWN,     // u8 buttons
+  MOP_MOUSE_UP,       // u8 buttons
+  MOP_MOUSE_CLICK,    // u8 buttons
+  MOP_MOUSE_SCROLL,   // i16 ticks (vertical wheel)
+  MOP_MOUSE_HSCROLL,  // i16 ticks (AC Pan)
+  MOP_PAD_PRESS,      // u8 button
+  MOP_PAD_RELEASE,    // u8 button
+  MOP_PAD_HAT,        // u8 hat
+  MOP_PAD_LS,         // i8 x, i8 y
+  MOP_PAD_RS,         // i8 z, i8 rz
+  MOP_PAD_LT,         // i8 value
+  MOP_PAD_RT,         // i8 value
+  MOP_TURBO,          // u8 0/1: batched report typing for TEXT
+  MOP_KEY_DOWN,       // u8 keycode, held until MOP_KEY_UP (Live Control)
+  MOP_KEY_UP,         // u8 keycode
+  MOP_COUNT
+};
+
+#define MACRO_CACHE_EXT ".mbc"
+#define MACRO_MAX_KEYS 8          // modifiers + final key in one KEY op
+#define MACRO_VM_WINDOW 512       // SD read window (>= 2 x largest encoded op)
+#define MACRO_OP_MAX 257          // largest encoded op (TEXT with 255 bytes)
+#define MACRO_STEP_BUDGET_MS 5    // max time one step() spends running ops
+#define MACRO_FILE_KEY_HOLD_MS 50 // key hold for SD file playback
+#define MACRO_TIMING_BUCKETS 124  // 4 histogram buckets per power of two (us)
+#define MACRO_TEMPO_MIN 10        // speed factor range in percent (0.1x..20x)
+#define MACRO_TEMPO_MAX 2000
+
+// Destination for compiled code. `write()` always receives whole ops.
+class MacroSink {
+public:
+  virtual ~MacroSink() {}
+  virtual void write(const uint8_t* data, size_t len) = 0;
+};
+
+// Compiles tokenizer output into opcodes for a sink
+class MacroCompiler : public MacroTokenizer {
+public:
+  explicit MacroCompiler(MacroSink& out);
+
+protected:
+  void onText(const char* s, size_t len) override;
+  void onToken(char* body, size_t len) override;
+  void onFinish() override { flushText(); }
+
+private:
+  void flushText();
+  void emitKey(char* name);
+  void emit(const uint8_t* op, size_t len) { out.write(op, len); }
+
+  MacroSink& out;
+  uint8_t text[2 + 255];  // pending MOP_TEXT op being filled
+};
+
+// Lateness of scheduled events against their deadlines, in microseconds.
+// A log-linear histogram keeps percentiles within ~25% in fixed memory.
+class MacroTiming {
+public:
+  MacroTiming() { reset(); }
+  void reset();
+  void add(uint32_t lateUs);
+  uint32_t count() const { return samples; }
+  uint32_t meanUs() const { return samples ? (uint32_t)(sumUs / samples) : 0; }
+  uint32_t maxUs() const { return maxLateUs; }
+  uint32_t percentileUs(uint8_t pct) const;  // upper bound of the bucket
+
+private:
+  uint32_t samples;
+  uint64_t sumUs;
+  uint32_t maxLateUs;
+  uint32_t hist[MACRO_TIMING_BUCKETS];
+};
+
+// Executes compiled macro code as a resumable state machine: timed ops
+// (delays, key holds, typing, scrolling) park the VM until a deadline
+// instead of sleeping. Also a sink, so the compiler can drive it directly
+// when there is no cache file to run from (pushed ops run to completion).
+class MacroVM : public MacroSink {
+public:
+  explicit MacroVM(uint16_t keyHoldMs);
+  void begin(File& code);   // non-blocking playback of a code file
+  bool step();              // run until the next wait; false when finished
+  void stop();              // abort, releasing what this VM holds; neutral pad
+  void reset();             // per-macro settings; restarts the schedule
+  // Live input: relative moves, wheel and pan ticks go to the mouse
+  // accumulator instead of straight to the host
+  void setCoalesceMouse(bool on) { coalesceMouse = on; }
+  void runFile(File& code); // blocking begin() + step() loop
+  void write(const uint8_t* data, size_t len) override;
+  uint32_t opsExecuted() const { return opCount; }
+  void setTiming(MacroTiming* stats) { timing = stats; }  // optional
+  // Delay scaling: gaps become delay * 100 / tempoPct; unless tempoPct is
+  // 100, an event is never due sooner than minGapMs after the previous one
+  void setTempo(uint16_t tempoPct, uint16_t minGapMs);
+  uint32_t recordedDelayMs() const { return delayTotalMs; }  // unscaled, this run
+
+private:
+  enum Pending : uint8_t {
+    PENDING_NONE,
+    PENDING_WAIT,    // relative pause inside an op (typing gap, scroll settle)
+    PENDING_DELAY,   // DELAY op: absolute deadline on the schedule
+    PENDING_KEYS,    // release `held` at the deadline
+    PENDING_TEXT,    // continue typing `text` from `textPos`
+    PENDING_SCROLL   // `scrollLeft` ticks to go, up to 127 per report
+  };
+
+  size_t exec(const uint8_t* op, size_t avail);
+  void resume();
+  void waitFor(uint32_t ms);
+  void scheduleGap(uint32_t ms);
+  bool due() const { return esp_timer_get_time() >= wakeAt; }
+  void waitDue();
+  void closeCode();
+  void keyDown(uint8_t k);
+  void keyUp(uint8_t k);
+
+  uint16_t holdMs;
+  uint8_t speedMs;
+  bool turbo;
+  bool coalesceMouse;
+  Pending pending;
+  int64_t wakeAt;    // esp_timer us
+  int64_t schedule;  // last DELAY deadline, or when the last timed op ended
+  MacroTiming* timing;
+  uint16_t tempoPct;
+  uint16_t minGapMs;
+  uint32_t gapMs;         // adjacent DELAYs not yet scheduled (file playback)
+  uint32_t delayTotalMs;
+  uint32_t opCount;
+  uint8_t held[MACRO_MAX_KEYS];
+  uint8_t heldCount;
+  uint8_t keysDown[MACRO_MAX_KEYS];  // MOP_KEY_DOWN not yet released
+  uint8_t keysDownCount;
+  uint8_t buttonsDown;               // mouse buttons from MOP_MOUSE_DOWN
+  bool padUsed;                      // gamepad touched since the last stop()
+  uint8_t text[255];
+  uint8_t textLen;
+  uint8_t textPos;
+  int16_t scrollLeft;
+  bool scrollHorizontal;
+  File code;
+  bool codeEof;
+  size_t winLen;
+  size_t winPos;
+  uint8_t window[MACRO_VM_WINDOW];
+};
+
+// Cache helpers (`srcPath` is the `.txt` path on `fs`)
+String macroCachePath(const String& srcPath);
+bool macroOpenCompiled(fs::FS& fs, const String& srcPath, File& code);
+bool macroOpenCompiled(fs::FS& fs, File& src, const String& srcPath, File& code);
+// Play a macro file through the cache; false if the source can't be opened
+bool macroPlayFile(fs::FS& fs, const String& srcPath, uint16_t keyHoldMs);
+// Same, reusing an already open source (left open for the caller)
+void macroPlayFile(fs::FS& fs, File& src, const String& srcPath, uint16_t keyHoldMs);
+void macroInvalidateCache(fs::FS& fs, const String& srcPath);
+bool macroCacheFresh(fs::FS& fs, const String& srcPath);  // .mbc matches the source
+// Same, for a source already read by the caller (no second pass over it)
+bool macroCacheFresh(fs::FS& fs, const String& srcPath, uint32_t srcSize, uint32_t srcMtime,
+                     uint32_t srcHash);
+
+// FNV-1a content hash shared by the cache header and the macro index
+#define MACRO_HASH_SEED 2166136261UL
+uint32_t macroHash(uint32_t h, const uint8_t* data, size_t len);
+
+// Background playback stepped from loop(); one macro at a time.
+// Start fails (false) if the file can't be opened or compiled to cache.
+bool macroPlaybackStart(fs::FS& fs, const String& srcPath,
+                        uint16_t tempoPct = 100, uint16_t minGapMs = 0);
+bool macroPlaybackStep();   // false once finished or idle
+void macroPlaybackStop();
+bool macroPlaybackActive();
+uint32_t macroPlaybackElapsedMs();  // running time, or the last run's length
+uint32_t macroPlaybackOps();
+uint32_t macroPlaybackRecordedMs();  // sum of unscaled DELAYs played so far
+// Deadline lateness of the current or last file playback
+const MacroTiming& macroPlaybackTiming();
+
+#endif
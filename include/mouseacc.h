@@ -0,0 +1,25 @@
+#ifndef MOUSEACC_H
+#define MOUSEACC_H
+
+#include <Arduino.h>
+
+/*
+ * Mouse accumulator module
+ * - Sums relative motion, wheel and horizontal pan (AC Pan) ticks from
+ *   live input so a burst of trackpad updates collapses into as few
+ *   reports as possible
+ * - mouseAccFlushOne() sends one report per call; USBHID returns once the
+ *   host has polled it, so calling it in a loop emits one report per
+ *   poll interval
+ * - A sum is only split when an axis exceeds the +/-127 report limit;
+ *   the remainder stays queued for the next report
+ * - Used from the HID task only (not thread-safe); reports take the HID
+ *   lock (hidlock.h)
+ */
+
+void mouseAccAdd(int dx, int dy, int wheel, int pan = 0);
+bool mouseAccPending();
+void mouseAccFlushOne();  // one report, if anything is pending
+void mouseAccFlushAll();  // drain completely (before clicks, keys, ...)
+
+#endif
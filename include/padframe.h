@@ -0,0 +1,42 @@
+#ifndef PADFRAME_H
+#define PADFRAME_H
+
+#include <Arduino.h>
+
+/*
+ * Gamepad frame module
+ * - Shadow copy of the whole gamepad report: face/shoulder/menu/stick
+ *   buttons, d-pad, both sticks and both triggers
+ * - Writes only touch the shadow; padFrameSend() turns it into a single
+ *   Gamepad.send(), and only if the report differs from the last one
+ * - Values use the GPC scale: buttons, d-pad and triggers 0..100, sticks
+ *   -100..100
+ * - Used from the script engine only (not thread-safe); the report itself
+ *   is sent under the HID lock (hidlock.h)
+ */
+
+enum PadInput : uint8_t {
+  PAD_A, PAD_B, PAD_X, PAD_Y,
+  PAD_LB, PAD_RB,
+  PAD_VIEW, PAD_MENU, PAD_HOME,
+  PAD_LS, PAD_RS,
+  PAD_UP, PAD_DOWN, PAD_LEFT, PAD_RIGHT,
+  PAD_LT, PAD_RT,
+  PAD_LX, PAD_LY, PAD_RX, PAD_RY,
+  PAD_INPUT_COUNT
+};
+
+#define PAD_INPUT_NONE 0xFF
+
+// GPC identifier (XB1_A, PS4_CROSS, XB1_LX, ...; case-insensitive),
+// PAD_INPUT_NONE if unknown
+uint8_t padInputByName(const char* name, size_t len);
+
+void padFrameBegin();   // neutral shadow; the next send always goes out
+void padFrameReset();   // set everything neutral (sent by the next padFrameSend)
+void padFrameSet(uint8_t input, int value);
+int padFrameGet(uint8_t input);
+bool padFrameDirty();   // written since the last padFrameSend()
+bool padFrameSend();    // true if a report was sent
+
+#endif
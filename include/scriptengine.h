@@ -2,7 +2,8 @@
 #define SCRIPTENGINE_H
 
 #include <Arduino.h>
-#include <map>
+#include <FS.h>
+#include <esp_timer.h>
 #include <vector>
 
 /*
@@ -10,66 +11,261 @@
  * - Advanced scripting with variables, loops, conditionals
  * - GPC (Game Profile Compiler) language support
  * - State machine for control flow
+ * - Every line is compiled once when the script is loaded: expressions
+ *   become RPN op lists with variables resolved to their storage, so
+ *   loops re-run statements without re-parsing or allocating
+ * - Identifiers are interned into a symbol table at load time; values
+ *   live in flat arrays indexed by symbol slot
+ * - Block openers and closers (IF/ELSE/ENDIF, LOOP/ENDLOOP, FOR/NEXT) are
+ *   matched once at load time; skipping a block or looping back is a
+ *   single jump
+ * - The script text is held in one arena buffer; lines are trimmed and
+ *   classified in place, and text operands point into it
+ * - GPC combos (`combo name { ... }`) run as resumable threads, each with
+ *   its own program counter and wait() deadline, interleaved by a
+ *   cooperative scheduler on a fixed tick while the main script waits
+ * - set_val() writes a shadow gamepad frame (see padframe.h) that the
+ *   scheduler sends at most once per tick; a GPC `main { ... }` block runs
+ *   once per tick after the init code, until the BOOT button is pressed
+ * - Optional profiling (scriptSetProfiling) times every statement: hits and
+ *   microseconds per line and per statement kind, for a report after the run
  */
 
+#define SCRIPT_EVAL_STACK 16     // deepest operand stack a compiled expression may use
+#define SCRIPT_MAX_LINES 65535   // lines past this are ignored (16-bit jump targets)
+#define SCRIPT_TICK_MS_DEFAULT 1  // scheduler tick (see scriptSetTickMs)
+#define SCRIPT_COMBO_BUDGET 64   // statements a combo may run per tick without waiting
+#define SCRIPT_PROFILE_TOP 10    // lines kept by a profiled run, slowest first
+#define SCRIPT_HEAP_RESERVE 8192 // heap left after the per-line tables (expression code, symbols)
+#define SCRIPT_PROFILE_TEXT 24   // source characters kept per profiled line
+
+// RPN opcodes of a compiled expression
+enum ScriptOpCode : uint8_t {
+    SOP_CONST,   // push value
+    SOP_VAR,     // push values[value]
+    SOP_NEG,
+    SOP_NOT,
+    SOP_ADD,
+    SOP_SUB,
+    SOP_MUL,
+    SOP_DIV,     // x / 0 == 0
+    SOP_MOD,     // x % 0 == 0
+    SOP_EQ,
+    SOP_NE,
+    SOP_LT,
+    SOP_GT,
+    SOP_LE,
+    SOP_GE,
+    SOP_AND,
+    SOP_OR
+};
+
+struct ScriptOp {
+    ScriptOpCode code;
+    int value;     // SOP_CONST: the constant, SOP_VAR: variable slot
+};
+
+// A compiled expression: `count` ops starting at ScriptContext::code[start]
+struct ScriptExpr {
+    uint16_t start;
+    uint16_t count;
+};
+
+enum ScriptStmtKind : uint8_t {
+    STMT_NOP,         // blank line or comment
+    STMT_ASSIGN,      // var = a
+    STMT_ASSIGN_STR,  // strings[var] = text
+    STMT_IF,          // a is the condition; false jumps to ELSE/ENDIF
+    STMT_ELSE,        // reached from the IF branch: jumps to ENDIF
+    STMT_ENDIF,
+    STMT_LOOP,        // var = a (remaining count); 0 jumps to ENDLOOP
+    STMT_ENDLOOP,     // jumps back to LOOP while --var > 0
+    STMT_FOR,         // var = a, limit = b; var > limit jumps to NEXT
+    STMT_NEXT,        // ++var <= limit jumps back to FOR
+    STMT_WAIT,        // wait(a); parks a combo instead of blocking
+    STMT_SET_VAL,     // set_val(button, a)
+    STMT_COMBO,       // combo definition: the main script jumps past it
+    STMT_MAIN,        // `main {`: jumped past, run by the frame loop
+    STMT_BLOCK_END,   // `}` closing a combo or main: ends the combo's run
+    STMT_COMBO_RUN,   // var = combo index; starts it unless running
+    STMT_COMBO_STOP,
+    STMT_TEXT         // text goes to the macro processor
+};
+
+#define SCRIPT_STMT_KINDS (STMT_TEXT + 1)
+
+// One compiled script line
+struct ScriptStmt {
+    ScriptStmtKind kind;
+    uint8_t button;   // STMT_SET_VAL: PadInput, PAD_INPUT_NONE if unmapped
+    uint16_t var;     // target slot (see kinds above)
+    uint16_t limit;   // STMT_FOR/NEXT slot holding the end value
+    uint16_t jump;    // block statements: matching line (see linkScriptBlocks)
+    ScriptExpr a;
+    ScriptExpr b;
+    uint32_t text;     // STMT_TEXT/ASSIGN_STR: NUL-terminated text at arena[text]
+    uint32_t textLen;
+};
+
+// Expression counters of the last executeAdvancedScript()
+struct ScriptStats {
+    uint32_t statements;  // statements executed
+    uint32_t evals;       // expression evaluations
+    uint64_t evalCycles;  // CPU cycles spent in them
+    uint32_t runMs;
+    uint32_t ticks;          // scheduler ticks (frames)
+    uint64_t tickUs;         // time spent in them (main block, combos, report)
+    uint32_t tickMaxUs;
+    uint32_t reports;        // gamepad reports sent
+    uint16_t comboPeak;      // most combos running at once
+    uint32_t evalsPerSec() const;
+};
+
+// Hits and time of a line or statement kind in a profiled run. Times are
+// inclusive: a wait() counts the combos stepped while it waits.
+struct ScriptProfileEntry {
+    uint32_t hits;
+    uint64_t us;
+};
+
+struct ScriptProfileLine {
+    uint16_t line;                          // 1-based script line
+    ScriptProfileEntry total;
+    char text[SCRIPT_PROFILE_TEXT + 1];     // start of the source line
+};
+
+// Result of the last profiled run
+struct ScriptProfile {
+    bool valid;                             // the last run was profiled
+    uint16_t linesHit;                      // lines executed at least once
+    uint16_t lineCount;                     // entries in lines[]
+    ScriptProfileLine lines[SCRIPT_PROFILE_TOP];
+    ScriptProfileEntry kinds[SCRIPT_STMT_KINDS];
+};
+
+// A GPC combo: a block of statements run as its own thread
+struct ScriptCombo {
+    uint16_t name;     // symbol slot of the combo name
+    uint16_t start;    // STMT_COMBO line
+    uint16_t pc;       // next statement while running
+    bool running;
+    int64_t wakeAt;    // esp_timer deadline of its current wait()
+};
+
 // Script execution context
 class ScriptContext {
 public:
-    std::map<String, int> variables;        // Variable storage (name -> value)
-    std::map<String, String> stringVars;    // String variables
-    std::vector<int> loopStack;             // Loop iteration counters
-    std::vector<size_t> loopStartPositions; // Line numbers for loop starts
-    std::vector<String> lines;              // All script lines
+    std::vector<String> symbols;            // Interned identifiers (slot -> name)
+    std::vector<int> values;                // Integer variables by slot
+    std::vector<const char*> strings;       // String variables by slot (into the arena)
+    std::vector<ScriptStmt> program;        // Compiled lines
+    std::vector<ScriptOp> code;             // RPN ops of every expression
+    std::vector<ScriptCombo> combos;        // Combo definitions and their run state
+    ScriptCombo* activeCombo;               // Combo being stepped, nullptr for the main script
+    uint16_t combosRunning;
+    int mainLine;                           // STMT_MAIN line, -1 without a main block
+    int64_t tickUs;                         // Scheduler tick length
+    int64_t tickAt;                         // Next scheduler tick (esp_timer)
+    std::vector<char> arena;                // Script text, NUL-terminated; never resized while running
     size_t currentLine;                     // Current execution line
-    bool skipMode;                          // Skipping to endif/endloop
-    int skipDepth;                          // Nesting depth when skipping
-    
-    ScriptContext() : currentLine(0), skipMode(false), skipDepth(0) {}
-    
+    ScriptStats stats;
+    bool profiling;
+    std::vector<uint32_t> lineStart;        // Profiling: arena offset of each line
+    std::vector<ScriptProfileEntry> lineProfile;
+    ScriptProfileEntry kindProfile[SCRIPT_STMT_KINDS];
+
+    ScriptContext() : activeCombo(nullptr), combosRunning(0), mainLine(-1),
+                      tickUs(SCRIPT_TICK_MS_DEFAULT * 1000), tickAt(0), currentLine(0),
+                      profiling(false) {}
+
     void reset() {
-        variables.clear();
-        stringVars.clear();
-        loopStack.clear();
-        loopStartPositions.clear();
-        lines.clear();
+        symbols.clear();
+        values.clear();
+        strings.clear();
+        program.clear();
+        code.clear();
+        combos.clear();
+        activeCombo = nullptr;
+        combosRunning = 0;
+        mainLine = -1;
+        tickUs = SCRIPT_TICK_MS_DEFAULT * 1000;
+        tickAt = 0;
+        arena.clear();
         currentLine = 0;
-        skipMode = false;
-        skipDepth = 0;
+        memset(&stats, 0, sizeof(stats));
+        profiling = false;
+        lineStart.clear();
+        lineProfile.clear();
+        memset(kindProfile, 0, sizeof(kindProfile));
     }
-    
-    int getVar(const String& name, int defaultVal = 0) {
-        auto it = variables.find(name);
-        return (it != variables.end()) ? it->second : defaultVal;
-    }
-    
-    void setVar(const String& name, int value) {
-        variables[name] = value;
-    }
-    
-    String getStringVar(const String& name, const String& defaultVal = "") {
-        auto it = stringVars.find(name);
-        return (it != stringVars.end()) ? it->second : defaultVal;
+
+    // Slot of an identifier, adding it on first use (load time only;
+    // variables start as 0 and "")
+    uint16_t intern(const char* name, size_t len) {
+        for (size_t i = 0; i < symbols.size(); i++) {
+            if (symbols[i].length() == len && memcmp(symbols[i].c_str(), name, len) == 0) return i;
+        }
+        symbols.push_back(String());
+        symbols.back().concat(name, len);
+        values.push_back(0);
+        strings.push_back("");
+        return symbols.size() - 1;
     }
-    
-    void setStringVar(const String& name, const String& value) {
-        stringVars[name] = value;
+
+    // Slot with no name, for interpreter state such as LOOP counters
+    uint16_t hiddenSlot() {
+        symbols.push_back(String());
+        values.push_back(0);
+        strings.push_back("");
+        return symbols.size() - 1;
     }
+
+    const char* text(const ScriptStmt& stmt) const { return arena.data() + stmt.text; }
+
+    int getVar(uint16_t slot) const { return values[slot]; }
+    void setVar(uint16_t slot, int value) { values[slot] = value; }
+
+    const char* getStringVar(uint16_t slot) const { return strings[slot]; }
+    void setStringVar(uint16_t slot, const char* value) { strings[slot] = value; }
 };
 
 // Execute advanced script with variables, loops, conditionals
 void executeAdvancedScript(const String& script);
+// Run a script straight from an open file (from its current position);
+// false without running if the file, or the table of its compiled
+// lines, doesn't fit in the largest free heap block
+bool executeAdvancedScriptFile(File& f);
+// Counters of the last run (see ScriptStats)
+const ScriptStats& scriptLastRunStats();
+// Scheduler tick of the following runs: how often combos step, the main
+// block runs and a changed gamepad frame is sent
+void scriptSetTickMs(uint8_t ms);
+uint8_t scriptTickMs();
+// Profile the following runs (slower: every statement is timed); turning
+// it on clears the last profile
+void scriptSetProfiling(bool on);
+const ScriptProfile& scriptLastProfile();
+const char* scriptStmtKindName(uint8_t kind);
 
-// Execute single line with context
-bool executeScriptLine(ScriptContext& ctx, const String& line);
-
-// Parse and evaluate expressions (arithmetic, comparisons)
-int evaluateExpression(ScriptContext& ctx, const String& expr);
-bool evaluateCondition(ScriptContext& ctx, const String& condition);
+// Compile one line of ctx.arena into ctx.program[index]; the line may be
+// modified (operands are NUL-terminated in place)
+void compileScriptLine(ScriptContext& ctx, size_t index, char* line, size_t len);
+// Match block statements and store their jump targets; closers without
+// an opener become no-ops, openers left open jump to the end. Text lines
+// inside main/combo become no-ops too. Also builds the combo table,
+// finds the main block and resolves combo_run/combo_stop names.
+void linkScriptBlocks(ScriptContext& ctx);
+// Execute the compiled statement at ctx.currentLine
+void executeScriptStatement(ScriptContext& ctx);
 
-// GPC command execution
-void executeGPCCommand(ScriptContext& ctx, const String& command);
+// Compile an arithmetic/comparison/logic expression into ctx.code.
+// Text that doesn't parse compiles to its leading number (or 0).
+ScriptExpr compileExpression(ScriptContext& ctx, const char* text, size_t len);
+// Evaluate a compiled expression; conditions are true when non-zero
+int evaluateExpression(ScriptContext& ctx, const ScriptExpr& expr);
 
 // Check if script uses advanced features
 bool isAdvancedScript(const String& content);
+bool isAdvancedScript(const char* content, size_t len);
 
 #endif
@@ -0,0 +1,96 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <Arduino.h>
+#include <atomic>
+
+/*
+ * SPSC ring module
+ * - Lock-free single-producer/single-consumer byte ring carrying
+ *   length-prefixed frames (BLE lines, compiled macro ops)
+ * - The producer only advances `head`, the consumer only advances `tail`;
+ *   release/acquire ordering makes frames visible across cores without
+ *   a mutex
+ * - A frame that doesn't fit is rejected whole; callers count it with
+ *   noteDrop() so depth, high-water mark and drops can be reported
+ */
+
+struct RingStats {
+  uint32_t depth;      // bytes queued now
+  uint32_t highWater;  // most bytes ever queued
+  uint32_t dropped;    // frames rejected
+  uint32_t capacity;
+};
+
+template <size_t N>
+class SpscRing {
+  static_assert(N >= 16 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+  SpscRing() : head(0), tail(0), dropped(0), highWater(0) {}
+
+  // Producer side
+  bool push(const uint8_t* data, uint16_t len) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    uint32_t used = h - tail.load(std::memory_order_acquire);
+    if (used + 2 + len > N) return false;
+    uint8_t hdr[2] = {(uint8_t)(len & 0xFF), (uint8_t)(len >> 8)};
+    copyIn(h, hdr, 2);
+    copyIn(h + 2, data, len);
+    head.store(h + 2 + len, std::memory_order_release);
+    if (used + 2 + len > highWater.load(std::memory_order_relaxed)) {
+      highWater.store(used + 2 + len, std::memory_order_relaxed);
+    }
+    return true;
+  }
+  void noteDrop() { dropped.fetch_add(1, std::memory_order_relaxed); }
+
+  // Consumer side: copies the next frame into `out` (truncated to `max`)
+  // and returns its full length, or -1 if the ring is empty
+  int pop(uint8_t* out, size_t max) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (head.load(std::memory_order_acquire) == t) return -1;
+    uint8_t hdr[2];
+    copyOut(t, hdr, 2);
+    uint16_t len = hdr[0] | (hdr[1] << 8);
+    copyOut(t + 2, out, len < max ? len : max);
+    tail.store(t + 2 + len, std::memory_order_release);
+    return len;
+  }
+  bool empty() const {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_relaxed);
+  }
+  // Discard everything queued (consumer side)
+  void clear() { tail.store(head.load(std::memory_order_acquire), std::memory_order_release); }
+
+  RingStats stats() const {
+    RingStats s;
+    s.depth = head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    s.highWater = highWater.load(std::memory_order_relaxed);
+    s.dropped = dropped.load(std::memory_order_relaxed);
+    s.capacity = N;
+    return s;
+  }
+
+private:
+  void copyIn(uint32_t pos, const uint8_t* src, size_t len) {
+    size_t at = pos & (N - 1);
+    size_t first = (len < N - at) ? len : N - at;
+    memcpy(buf + at, src, first);
+    memcpy(buf, src + first, len - first);
+  }
+  void copyOut(uint32_t pos, uint8_t* dst, size_t len) {
+    size_t at = pos & (N - 1);
+    size_t first = (len < N - at) ? len : N - at;
+    memcpy(dst, buf + at, first);
+    memcpy(dst + first, buf, len - first);
+  }
+
+  uint8_t buf[N];
+  std::atomic<uint32_t> head;  // written by the producer only
+  std::atomic<uint32_t> tail;  // written by the consumer only
+  std::atomic<uint32_t> dropped;
+  std::atomic<uint32_t> highWater;
+};
+
+#endif
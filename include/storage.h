@@ -6,8 +6,9 @@
 /*
  * Storage module
  * - Wraps NVS (Preferences) operations used to persist device names
- *   and passwords. Uses namespace `devstore` for device pairs and
- *   `CDC` for the boot-to-CDC flag.
+ *   and passwords. Uses namespace `devstore` for device pairs,
+ *   `CDC` for the boot-to-CDC flag, `MOUSE` for pointer settings and
+ *   `PLAYBACK` for macro playback tuning.
  * - `MAX_DEVICES` limits how many pairs are stored in NVS and loaded
  *   into RAM at runtime.
  */
@@ -33,4 +34,16 @@ bool setBootToMSC(bool value);
 bool getBootToMSC();
 bool initializeMSCFlag();
 
+// Absolute mouse settings (namespace `MOUSE`)
+bool setAbsMouseEnabled(bool value);
+bool getAbsMouseEnabled();
+bool setScreenSize(uint16_t width, uint16_t height);
+void getScreenSize(uint16_t& width, uint16_t& height);
+
+// Macro playback settings (namespace `PLAYBACK`)
+bool setPlaybackMinGap(uint16_t ms);
+uint16_t getPlaybackMinGap();
+bool setScriptTickMs(uint8_t ms);
+uint8_t getScriptTickMs();
+
 #endif
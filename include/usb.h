@@ -30,10 +30,26 @@ void startUSBMode(int mode);
 void sendPassword(String password);
 bool typeTextFileFromSD(const String& baseName);
 void processMacroText(const String& text);
+void processMacroText(const char* text, size_t len);
 void processTextFileAuto(const String& baseName); // Auto-detect format (DuckyScript or Macro)
+// Polled by a running GPC main block (which keeps loop() from running):
+// takes pending BLE lines, true once one is STOP
+bool scriptStopRequested();
 
-// SD file listing
-void listSDTextFiles(String fileList[15], int& count);
+// Background macro playback (BLE PLAY:); call servicePlayback() from loop()
+enum PlaybackStart {
+  PLAYBACK_STARTED,
+  PLAYBACK_NOT_MACRO,    // script, DuckyScript or missing: run it synchronously
+  PLAYBACK_NO_SD,
+  PLAYBACK_CACHE_FAILED  // macro file, but its .mbc couldn't be written
+};
+PlaybackStart startMacroPlayback(const String& baseName, uint16_t tempoPct = 100);
+void servicePlayback();
+
+// SD file listing (macro index order); readSDTextFiles() fills up to
+// `maxNames` names starting at sorted position `first`
+int countSDTextFiles();
+int readSDTextFiles(int first, String names[], int maxNames);
 
 // CDC serial operations
 bool isSerialDataAvailable();
@@ -0,0 +1,89 @@
+#include "absmouse.h"
+
+// External reference (defined in main.cpp)
+extern USBHIDAbsMouse AbsMouse;
+
+static const uint8_t absMouseReportDescriptor[] = {
+  0x05, 0x01,                     // Usage Page (Generic Desktop)
+  0x09, 0x02,                     // Usage (Mouse)
+  0xA1, 0x01,                     // Collection (Application)
+  0x85, HID_REPORT_ID_ABS_MOUSE,  //   Report ID
+  0x09, 0x01,                     //   Usage (Pointer)
+  0xA1, 0x00,                     //   Collection (Physical)
+  0x05, 0x09,                     //     Usage Page (Button)
+  0x19, 0x01,                     //     Usage Minimum (1)
+  0x29, 0x03,                     //     Usage Maximum (3)
+  0x15, 0x00,                     //     Logical Minimum (0)
+  0x25, 0x01,                     //     Logical Maximum (1)
+  0x95, 0x03,                     //     Report Count (3)
+  0x75, 0x01,                     //     Report Size (1)
+  0x81, 0x02,                     //     Input (Data, Var, Abs)
+  0x95, 0x01,                     //     Report Count (1)
+  0x75, 0x05,                     //     Report Size (5)
+  0x81, 0x03,                     //     Input (Const) - padding
+  0x05, 0x01,                     //     Usage Page (Generic Desktop)
+  0x09, 0x30,                     //     Usage (X)
+  0x09, 0x31,                     //     Usage (Y)
+  0x16, 0x00, 0x00,               //     Logical Minimum (0)
+  0x26, 0xFF, 0x7F,               //     Logical Maximum (32767)
+  0x75, 0x10,                     //     Report Size (16)
+  0x95, 0x02,                     //     Report Count (2)
+  0x81, 0x02,                     //     Input (Data, Var, Abs)
+  0xC0,                           //   End Collection
+  0xC0                            // End Collection
+};
+
+// Buttons stay on the relative mouse; this report only positions
+typedef struct __attribute__((packed)) {
+  uint8_t buttons;
+  uint16_t x;
+  uint16_t y;
+} AbsMouseReport;
+
+USBHIDAbsMouse::USBHIDAbsMouse() : hid() {
+  static bool initialized = false;
+  if (!initialized) {
+    initialized = true;
+    hid.addDevice(this, sizeof(absMouseReportDescriptor));
+  }
+}
+
+uint16_t USBHIDAbsMouse::_onGetDescriptor(uint8_t* buffer) {
+  memcpy(buffer, absMouseReportDescriptor, sizeof(absMouseReportDescriptor));
+  return sizeof(absMouseReportDescriptor);
+}
+
+void USBHIDAbsMouse::begin() {
+  hid.begin();
+}
+
+bool USBHIDAbsMouse::moveTo(uint16_t x, uint16_t y) {
+  AbsMouseReport report = {0, x, y};
+  return hid.SendReport(HID_REPORT_ID_ABS_MOUSE, &report, sizeof(report));
+}
+
+static bool absEnabled = false;
+static uint16_t absScreenWidth = 1920;
+static uint16_t absScreenHeight = 1080;
+
+void absMouseConfigure(bool enabled, uint16_t screenWidth, uint16_t screenHeight) {
+  absEnabled = enabled;
+  if (screenWidth > 1) absScreenWidth = screenWidth;
+  if (screenHeight > 1) absScreenHeight = screenHeight;
+}
+
+bool absMouseEnabled() {
+  return absEnabled;
+}
+
+// Map a pixel to the logical range; last pixel lands on ABS_MOUSE_MAX
+static uint16_t scaleToLogical(int pixel, uint16_t size) {
+  if (pixel <= 0) return 0;
+  if (pixel >= size - 1) return ABS_MOUSE_MAX;
+  return (uint16_t)(((uint32_t)pixel * ABS_MOUSE_MAX) / (size - 1));
+}
+
+bool absMouseMoveTo(int x, int y) {
+  if (!absEnabled) return false;
+  return AbsMouse.moveTo(scaleToLogical(x, absScreenWidth), scaleToLogical(y, absScreenHeight));
+}
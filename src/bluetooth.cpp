@@ -7,6 +7,14 @@
 #include <SD.h>
 #include <SD_MMC.h>
 #include "display.h"
+#include "macrovm.h"
+#include "macroindex.h"
+#include "keytable.h"
+#include "hidtask.h"
+#include "spscring.h"
+#include "livectl.h"
+#include "hidtyper.h"
+#include "hidlock.h"
 
 // Nordic UART Service (NUS) UUIDs - widely supported by BLE terminal apps
 #define SERVICE_UUID           "6E400001-B5A3-F393-E0A9-E50E24DCCA9E"
@@ -24,8 +32,16 @@ static BLEServer *pServer = nullptr;
 static BLECharacteristic *pTxCharacteristic = nullptr;
 static BLECharacteristic *pRxCharacteristic = nullptr;
 static bool deviceConnected = false;
-static String rxBuffer = "";
-static const size_t MAX_RXBUFFER_SIZE = 4096;  // Prevent unbounded buffer growth
+// BLE -> loop() handoff: the RX callback (BLE host task, core 0) splits
+// writes into lines and pushes them as frames; loop() pops them
+#define BLE_RX_QUEUE_SIZE 4096
+#define BLE_LINE_MAX 1024
+static SpscRing<BLE_RX_QUEUE_SIZE> rxRing;
+static char rxLine[BLE_LINE_MAX];   // line being assembled (callback only)
+static size_t rxLineLen = 0;
+static bool rxLineOverflow = false;
+static uint8_t rxFrame[LIVE_FRAME_SIZE];  // binary frame being assembled
+static size_t rxFrameLen = 0;            // may continue in the next write
 int currentBLEMode = 0;  // 0 = off, 1 = active
 int dualModeActive = 0;  // 0 = BLE commands only, 1 = BLE + USB HID dual mode
 
@@ -36,6 +52,11 @@ class ServerCallbacks: public BLEServerCallbacks {
   
   void onDisconnect(BLEServer* pServer) {
     deviceConnected = false;
+    rxFrameLen = 0;  // a half frame must not prefix the next connection's data
+    // Keys and buttons held by Live Control frames are released by loop()
+    // after the frames already queued
+    static const uint8_t release[LIVE_FRAME_SIZE] = {LIVE_FRAME_MARK, LIVE_FRAME_RELEASE, 0, 0, 0, 0};
+    if (!rxRing.push(release, sizeof(release))) rxRing.noteDrop();
     // Restart advertising so phone can reconnect
     BLEDevice::startAdvertising();
   }
@@ -44,19 +65,29 @@ class ServerCallbacks: public BLEServerCallbacks {
 class RxCallbacks: public BLECharacteristicCallbacks {
   void onWrite(BLECharacteristic *pCharacteristic) {
     std::string rxValue = pCharacteristic->getValue();
-    if (rxValue.length() > 0) {
-      // Guard against buffer overflow
-      if (rxBuffer.length() + rxValue.length() > MAX_RXBUFFER_SIZE) {
-        int lastNewline = rxBuffer.lastIndexOf('\n');
-        if (lastNewline >= 0) {
-          rxBuffer = rxBuffer.substring(lastNewline + 1);
-        } else {
-          rxBuffer = "";  // Clear if no newline
+    for (size_t i = 0; i < rxValue.length(); i++) {
+      char c = rxValue[i];
+      // Binary Live Control frame: fixed size, queued as-is (its bytes
+      // may include '\n'); it may be split across writes (MTU boundary)
+      if (rxFrameLen > 0 || (rxLineLen == 0 && (uint8_t)c == LIVE_FRAME_MARK)) {
+        rxFrame[rxFrameLen++] = (uint8_t)c;
+        if (rxFrameLen == LIVE_FRAME_SIZE) {
+          if (!rxRing.push(rxFrame, LIVE_FRAME_SIZE)) rxRing.noteDrop();
+          rxFrameLen = 0;
         }
+        continue;
       }
-      for (size_t i = 0; i < rxValue.length(); i++) {
-        rxBuffer += (char)rxValue[i];
+      if (c != '\n') {
+        if (rxLineLen < BLE_LINE_MAX) rxLine[rxLineLen++] = c;
+        else rxLineOverflow = true;
+        continue;
       }
+      // Complete line: queue it whole, or count it as dropped
+      if (rxLineOverflow || !rxRing.push((const uint8_t*)rxLine, rxLineLen)) {
+        rxRing.noteDrop();
+      }
+      rxLineLen = 0;
+      rxLineOverflow = false;
     }
   }
 };
@@ -71,21 +102,22 @@ static void typeViaHID(const String& text) {
   for (int i = 0; i < text.length(); i++) {
     char c = text[i];
     if (c == '\n') {
-      Keyboard.press(KEY_RETURN);
+      hidKeyPress(KEY_RETURN);
       delay(50);
-      Keyboard.release(KEY_RETURN);
+      hidKeyRelease(KEY_RETURN);
     } else if (c == '\t') {
-      Keyboard.press(KEY_TAB);
+      hidKeyPress(KEY_TAB);
       delay(50);
-      Keyboard.release(KEY_TAB);
+      hidKeyRelease(KEY_TAB);
     } else {
+      HidLockGuard lock;
       Keyboard.print(String(c));
     }
     delay(10);  // Small delay between characters
   }
 }
 
-// Helper to send special keys via USB HID
+// Helper to send special keys via USB HID ("enter", "f5", "ctrl+alt+delete")
 static void sendKeyViaHID(const String& keyName) {
   String key = keyName;
   key.toLowerCase();
@@ -93,97 +125,13 @@ static void sendKeyViaHID(const String& keyName) {
   Serial.print("sendKeyViaHID called with: ");
   Serial.println(key);
   
-  // Single keys
-  if (key == "enter" || key == "return") {
-    Keyboard.press(KEY_RETURN);
-    delay(50);
-    Keyboard.release(KEY_RETURN);
-  }
-  else if (key == "backspace") {
-    Keyboard.press(KEY_BACKSPACE);
-    delay(50);
-    Keyboard.release(KEY_BACKSPACE);
-  }
-  else if (key == "delete") {
-    Keyboard.press(KEY_DELETE);
-    delay(50);
-    Keyboard.release(KEY_DELETE);
-  }
-  else if (key == "tab") {
-    Keyboard.press(KEY_TAB);
-    delay(50);
-    Keyboard.release(KEY_TAB);
-  }
-  else if (key == "escape") {
-    Keyboard.press(KEY_ESC);
-    delay(50);
-    Keyboard.release(KEY_ESC);
-  }
-  else if (key == "up") {
-    Keyboard.press(KEY_UP_ARROW);
-    delay(50);
-    Keyboard.release(KEY_UP_ARROW);
-  }
-  else if (key == "down") {
-    Keyboard.press(KEY_DOWN_ARROW);
-    delay(50);
-    Keyboard.release(KEY_DOWN_ARROW);
-  }
-  else if (key == "left") {
-    Keyboard.press(KEY_LEFT_ARROW);
-    delay(50);
-    Keyboard.release(KEY_LEFT_ARROW);
-  }
-  else if (key == "right") {
-    Keyboard.press(KEY_RIGHT_ARROW);
-    delay(50);
-    Keyboard.release(KEY_RIGHT_ARROW);
-  }
-  else if (key == "home") {
-    Keyboard.press(KEY_HOME);
-    delay(50);
-    Keyboard.release(KEY_HOME);
-  }
-  else if (key == "end") {
-    Keyboard.press(KEY_END);
-    delay(50);
-    Keyboard.release(KEY_END);
-  }
-  else if (key == "pageup") {
-    Keyboard.press(KEY_PAGE_UP);
-    delay(50);
-    Keyboard.release(KEY_PAGE_UP);
-  }
-  else if (key == "pagedown") {
-    Keyboard.press(KEY_PAGE_DOWN);
-    delay(50);
-    Keyboard.release(KEY_PAGE_DOWN);
-  }
-  // Modifier combinations
-  else if (key.startsWith("ctrl+")) {
-    String char_key = key.substring(5);
-    Keyboard.press(KEY_LEFT_CTRL);
-    Keyboard.press(char_key[0]);
-    delay(50);
-    Keyboard.release(char_key[0]);
-    Keyboard.release(KEY_LEFT_CTRL);
-  }
-  else if (key.startsWith("alt+")) {
-    String char_key = key.substring(4);
-    Keyboard.press(KEY_LEFT_ALT);
-    Keyboard.press(char_key[0]);
-    delay(50);
-    Keyboard.release(char_key[0]);
-    Keyboard.release(KEY_LEFT_ALT);
-  }
-  else if (key.startsWith("shift+")) {
-    String char_key = key.substring(6);
-    Keyboard.press(KEY_LEFT_SHIFT);
-    Keyboard.press(char_key[0]);
-    delay(50);
-    Keyboard.release(char_key[0]);
-    Keyboard.release(KEY_LEFT_SHIFT);
-  }
+  uint8_t codes[KEY_COMBO_MAX];
+  uint8_t n = keyParseCombo(key.c_str(), key.length(), "+", codes, KEY_COMBO_MAX);
+  if (n == 0) return;
+  
+  for (uint8_t i = 0; i < n; i++) hidKeyPress(codes[i]);
+  delay(50);
+  for (uint8_t i = n; i-- > 0; ) hidKeyRelease(codes[i]);
 }
 
 void startBLEMode() {
@@ -227,6 +175,7 @@ void startBLEMode() {
   
   currentBLEMode = 1;
   dualModeActive = 1;  // Enable dual-mode: BLE + USB HID
+  hidTaskStart();      // Live input is emitted from the HID task
   
   Serial.println("BLE Started - Advertising as: PWDongle");
   Serial.println("Dual-mode active: BLE commands + USB HID keyboard relay");
@@ -239,22 +188,30 @@ void stopBLEMode() {
   BLEDevice::deinit(true);
   currentBLEMode = 0;
   deviceConnected = false;
-  rxBuffer = "";
+  rxRing.clear();
+  rxLineLen = 0;
+  rxLineOverflow = false;
+  rxFrameLen = 0;
 }
 
 bool isBLEDataAvailable() {
   if (currentBLEMode == 0) return false;
-  return rxBuffer.indexOf('\n') >= 0;
+  return !rxRing.empty();
 }
 
 String readBLEData() {
-  int newlineIdx = rxBuffer.indexOf('\n');
-  if (newlineIdx >= 0) {
-    String line = rxBuffer.substring(0, newlineIdx);
-    rxBuffer = rxBuffer.substring(newlineIdx + 1);
-    return line;
-  }
-  return "";
+  static char line[BLE_LINE_MAX + 1];
+  int len = rxRing.pop((uint8_t*)line, BLE_LINE_MAX);
+  if (len < 0) return "";
+  line[len] = '\0';
+  // Length-based: binary frames may contain NUL bytes
+  String s;
+  s.concat(line, len);
+  return s;
+}
+
+RingStats bleRxQueueStats() {
+  return rxRing.stats();
 }
 
 void sendBLEResponse(const String& msg) {
@@ -335,6 +292,9 @@ void startMacroRecording(const String& filename) {
   }
   
   recordingFilename = filename;
+  if (recordingFilename.startsWith("/")) {
+    recordingFilename = recordingFilename.substring(1);
+  }
   
   // Ensure filename has .txt extension
   if (!recordingFilename.endsWith(".txt")) {
@@ -350,12 +310,17 @@ void startMacroRecording(const String& filename) {
     return;
   }
   
-  // Open file for writing
+  // Open file for writing (any compiled cache of an older take is stale)
   String filepath = "/" + recordingFilename;
   
+  // "RECORD:work/login" records into a folder
   if (sdUseMMC) {
+    macroMakeParentDirs(SD_MMC, filepath);
+    macroInvalidateCache(SD_MMC, filepath);
     recordingFile = SD_MMC.open(filepath.c_str(), FILE_WRITE);
   } else {
+    macroMakeParentDirs(SD, filepath);
+    macroInvalidateCache(SD, filepath);
     recordingFile = SD.open(filepath.c_str(), FILE_WRITE);
   }
   
@@ -386,6 +351,14 @@ void stopMacroRecording() {
     recordingFile.close();
   }
   
+  // Add the take to the macro index (name without '/' and ".txt")
+  String indexName = recordingFilename.substring(0, recordingFilename.length() - 4);
+  if (sdUseMMC) {
+    macroIndexUpdate(SD_MMC, indexName);
+  } else {
+    macroIndexUpdate(SD, indexName);
+  }
+  
   isRecording = false;
   unsigned long duration = (millis() - recordingStartTime) / 1000;
   
@@ -1,12 +1,11 @@
 #include <Arduino.h>
 #include <TFT_eSPI.h>
 #include "display.h"
+#include "usb.h"
 
 // From main.cpp
 extern bool awaitingFileNumber;
 extern int bootMenuSelection;
-extern String fileList[15];
-extern int fileCount;
 extern int bootMenuSelection;
 
 // Declarations are provided by include/display.h
@@ -70,11 +69,9 @@ void showDigitScreen() {
     tft.println("File mode: enter number");
     tft.println("Example: 0001 -> 0001.txt");
     
-    // Show available SD card text files (up to 15)
-    extern void listSDTextFiles(String fileList[15], int& count);
-    String sdFiles[15];
-    int fileCount = 0;
-    listSDTextFiles(sdFiles, fileCount);
+    // Show the first SD card text files (up to 14, two columns)
+    String sdFiles[14];
+    int fileCount = readSDTextFiles(0, sdFiles, 14);
     
     if (fileCount > 0) {
       tft.setTextColor(TFT_GREEN, TFT_BLACK);
@@ -303,7 +300,9 @@ void drawBootMenu(int selectedIndex) {
   tft.println("Long: select");
 }
 
-void drawFileMenu(int selectedIndex, String fileList[], int fileCount) {
+// Only the visible window of names is read from the macro index, so the
+// menu costs the same with 10 files or 10,000
+void drawFileMenu(int selectedIndex, int fileCount) {
   tft.setRotation(0); // Portrait
   tft.fillScreen(TFT_BLACK);
   
@@ -327,17 +326,18 @@ void drawFileMenu(int selectedIndex, String fileList[], int fileCount) {
   
   int startY = 50;
   int lineHeight = 20;
-  int maxVisible = 9; // Maximum files visible at once
+  const int maxVisible = 9; // Maximum files visible at once
   
   // Calculate scroll window
   int scrollStart = 0;
   if (fileCount > maxVisible) {
     scrollStart = max(0, min(selectedIndex - maxVisible/2, fileCount - maxVisible));
   }
+  String window[maxVisible];
+  int visible = readSDTextFiles(scrollStart, window, maxVisible);
   
-  for (int i = 0; i < min(fileCount, maxVisible); i++) {
+  for (int i = 0; i < visible; i++) {
     int fileIdx = scrollStart + i;
-    if (fileIdx >= fileCount) break;
     
     int y = startY + (i * lineHeight);
     
@@ -353,10 +353,10 @@ void drawFileMenu(int selectedIndex, String fileList[], int fileCount) {
       tft.print("  ");
     }
     
-    // Truncate long filenames if needed
-    String displayName = fileList[fileIdx];
+    // Truncate long names, keeping the end ("~vpn/login" for "work/vpn/login")
+    String displayName = window[i];
     if (displayName.length() > 12) {
-      displayName = displayName.substring(0, 12);
+      displayName = "~" + displayName.substring(displayName.length() - 11);
     }
     tft.print(displayName);
     tft.println(".txt");
@@ -1,240 +1,235 @@
 #include "duckyscript.h"
+#include "keytable.h"
+#include "hidtyper.h"
+#include "hidlock.h"
 #include <Arduino.h>
 #include <USBHIDKeyboard.h>
-#include <vector>
 
 // External keyboard reference from main.cpp
 extern USBHIDKeyboard Keyboard;
 
-// DuckyScript key mappings
-static const struct {
-  const char* name;
-  uint8_t keycode;
-} duckyKeyMap[] = {
-  {"ENTER", KEY_RETURN},
-  {"ESCAPE", KEY_ESC},
-  {"ESC", KEY_ESC},
-  {"BACKSPACE", KEY_BACKSPACE},
-  {"TAB", KEY_TAB},
-  {"SPACE", ' '},
-  {"DELETE", KEY_DELETE},
-  {"DEL", KEY_DELETE},
-  {"HOME", KEY_HOME},
-  {"INSERT", KEY_INSERT},
-  {"END", KEY_END},
-  {"PAGEUP", KEY_PAGE_UP},
-  {"PAGEDOWN", KEY_PAGE_DOWN},
-  {"UPARROW", KEY_UP_ARROW},
-  {"DOWNARROW", KEY_DOWN_ARROW},
-  {"LEFTARROW", KEY_LEFT_ARROW},
-  {"RIGHTARROW", KEY_RIGHT_ARROW},
-  {"UP", KEY_UP_ARROW},
-  {"DOWN", KEY_DOWN_ARROW},
-  {"LEFT", KEY_LEFT_ARROW},
-  {"RIGHT", KEY_RIGHT_ARROW},
-  {"F1", KEY_F1},
-  {"F2", KEY_F2},
-  {"F3", KEY_F3},
-  {"F4", KEY_F4},
-  {"F5", KEY_F5},
-  {"F6", KEY_F6},
-  {"F7", KEY_F7},
-  {"F8", KEY_F8},
-  {"F9", KEY_F9},
-  {"F10", KEY_F10},
-  {"F11", KEY_F11},
-  {"F12", KEY_F12},
-  {"CAPSLOCK", KEY_CAPS_LOCK},
-  {"GUI", KEY_LEFT_GUI},
-  {"WINDOWS", KEY_LEFT_GUI},
-  {nullptr, 0}
-};
-
-// Modifier key mappings
-static const struct {
-  const char* name;
-  uint8_t keycode;
-} duckyModifierMap[] = {
-  {"CTRL", KEY_LEFT_CTRL},
-  {"CONTROL", KEY_LEFT_CTRL},
-  {"SHIFT", KEY_LEFT_SHIFT},
-  {"ALT", KEY_LEFT_ALT},
-  {"GUI", KEY_LEFT_GUI},
-  {"WINDOWS", KEY_LEFT_GUI},
-  {"COMMAND", KEY_LEFT_GUI},
-  {nullptr, 0}
-};
-
-// Helper to find key code by name
-static uint8_t findKeyCode(const String& keyName) {
-  String upper = keyName;
-  upper.toUpperCase();
-  
-  for (int i = 0; duckyKeyMap[i].name != nullptr; i++) {
-    if (upper.equals(duckyKeyMap[i].name)) {
-      return duckyKeyMap[i].keycode;
-    }
-  }
-  
-  // Single character
-  if (keyName.length() == 1) {
-    return (uint8_t)keyName.charAt(0);
-  }
-  
-  return 0;
+static bool isBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
 }
 
-// Helper to find modifier code
-static uint8_t findModifierCode(const String& modName) {
-  String upper = modName;
-  upper.toUpperCase();
-  
-  for (int i = 0; duckyModifierMap[i].name != nullptr; i++) {
-    if (upper.equals(duckyModifierMap[i].name)) {
-      return duckyModifierMap[i].keycode;
-    }
+static bool hasPrefix(const char* s, size_t len, const char* prefix) {
+  size_t n = strlen(prefix);
+  return len >= n && memcmp(s, prefix, n) == 0;
+}
+
+// Locked per character so live input isn't held up by a long STRING
+static void typeText(const char* s, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    HidLockGuard lock;
+    Keyboard.write((uint8_t)s[i]);
   }
-  return 0;
+}
+
+static void trimSpan(const char*& s, size_t& len) {
+  while (len > 0 && isBlank(s[0])) { s++; len--; }
+  while (len > 0 && isBlank(s[len - 1])) len--;
 }
 
 // Parse and execute a single DuckyScript line
 void processDuckyScriptLine(const String& line) {
-  String trimmed = line;
-  trimmed.trim();
-  
+  DuckyScriptStream stream;
+  stream.feed(line.c_str(), line.length());
+  stream.finish();
+}
+
+// ------------------------------------------------------------------
+// Streaming executor
+// ------------------------------------------------------------------
+
+DuckyScriptStream::DuckyScriptStream()
+  : len(0), overflow(OVERFLOW_NONE), defaultDelayMs(DUCKY_DEFAULT_DELAY_MS),
+    due(esp_timer_get_time()) {
+  last.kind = DUCKY_NONE;
+}
+
+// Sleep until the scheduled deadline; DELAYs and default delays only
+// move the deadline, so back-to-back pauses cost one wait
+void DuckyScriptStream::waitDue() {
+  int64_t us = due - esp_timer_get_time();
+  if (us >= 1000) delay(us / 1000);
+  else if (us > 0) delayMicroseconds(us);
+}
+
+// Next deadline `ms` after the later of now and the current deadline
+void DuckyScriptStream::schedule(uint32_t ms) {
+  int64_t now = esp_timer_get_time();
+  if (due < now) due = now;
+  due += (int64_t)ms * 1000;
+}
+
+// Parse one trimmed line into `cmd`; false for comments, blank and
+// unknown lines
+bool DuckyScriptStream::parse(const char* s, size_t n, DuckyCommand& cmd) {
   // Skip empty lines and comments
-  if (trimmed.length() == 0 || trimmed.startsWith("REM ")) {
-    return;
-  }
-  
-  // DELAY command
-  if (trimmed.startsWith("DELAY ")) {
-    int delayMs = trimmed.substring(6).toInt();
-    delay(delayMs);
-    return;
-  }
-  
-  // DEFAULT_DELAY command (set default delay between commands)
-  if (trimmed.startsWith("DEFAULT_DELAY ") || trimmed.startsWith("DEFAULTDELAY ")) {
-    // Store this for future use - for now just skip
-    return;
-  }
+  if (n == 0 || hasPrefix(s, n, "REM ")) return false;
   
-  // STRING command - type literal text
-  if (trimmed.startsWith("STRING ")) {
-    String text = trimmed.substring(7);
-    Keyboard.print(text);
-    delay(10);
-    return;
+  if (hasPrefix(s, n, "DELAY ")) {
+    cmd.kind = DUCKY_DELAY;
+    cmd.ms = (uint32_t)atol(s + 6);
+    return true;
   }
   
   // STRINGLN command - type literal text with enter
-  if (trimmed.startsWith("STRINGLN ")) {
-    String text = trimmed.substring(9);
-    Keyboard.println(text);
-    delay(10);
-    return;
+  bool ln = hasPrefix(s, n, "STRINGLN ");
+  if (ln || hasPrefix(s, n, "STRING ")) {
+    size_t skip = ln ? 9 : 7;
+    cmd.kind = ln ? DUCKY_STRINGLN : DUCKY_STRING;
+    cmd.textLen = n - skip;
+    memcpy(cmd.text, s + skip, cmd.textLen);
+    return true;
+  }
+  
+  // Key combination or single key: "GUI r", "CTRL ALT DELETE", "ENTER"
+  cmd.keyCount = keyParseCombo(s, n, " ", cmd.keys, KEY_COMBO_MAX);
+  if (cmd.keyCount == 0) return false;
+  cmd.kind = DUCKY_KEYS;
+  return true;
+}
+
+void DuckyScriptStream::run(const DuckyCommand& cmd) {
+  if (cmd.kind == DUCKY_DELAY) {
+    schedule(cmd.ms);
+  } else {
+    waitDue();
+    if (cmd.kind == DUCKY_KEYS) {
+      for (uint8_t i = 0; i < cmd.keyCount; i++) {
+        hidKeyPress(cmd.keys[i]);
+      }
+      delay(50);
+      for (uint8_t i = cmd.keyCount; i-- > 0; ) {
+        hidKeyRelease(cmd.keys[i]);
+      }
+    } else {
+      typeText(cmd.text, cmd.textLen);
+      if (cmd.kind == DUCKY_STRINGLN) typeText("\r\n", 2);
+    }
   }
+  schedule(defaultDelayMs);
+}
+
+// Execute one line; REPEAT replays the cached previous command
+void DuckyScriptStream::runLine(const char* s, size_t n) {
+  trimSpan(s, n);
   
-  // REPEAT command
-  if (trimmed.startsWith("REPEAT ")) {
-    // Would need to track previous command - simplified: just delay
-    int count = trimmed.substring(7).toInt();
-    delay(count * 10);
+  // DEFAULT_DELAY command (default delay between commands)
+  if (hasPrefix(s, n, "DEFAULT_DELAY ") || hasPrefix(s, n, "DEFAULTDELAY ")) {
+    defaultDelayMs = (uint32_t)atol(s + (s[7] == '_' ? 14 : 13));
     return;
   }
   
-  // Key combination or single key
-  std::vector<uint8_t> modifiers;
-  std::vector<String> parts;
-  
-  // Split by space for compound commands
-  int start = 0;
-  while (true) {
-    int sp = trimmed.indexOf(' ', start);
-    if (sp < 0) {
-      parts.push_back(trimmed.substring(start));
-      break;
-    }
-    parts.push_back(trimmed.substring(start, sp));
-    start = sp + 1;
-  }
-  
-  if (parts.size() == 0) return;
-  
-  // Check for single key press
-  if (parts.size() == 1) {
-    String keyName = parts[0];
-    uint8_t keycode = findKeyCode(keyName);
-    
-    if (keycode != 0) {
-      Keyboard.press(keycode);
-      delay(50);
-      Keyboard.release(keycode);
-      delay(10);
-    }
+  if (hasPrefix(s, n, "REPEAT ")) {
+    if (last.kind == DUCKY_NONE) return;
+    for (long i = atol(s + 7); i > 0; i--) run(last);
     return;
   }
   
-  // Multi-part: modifiers + key
-  // All but last are modifiers
-  for (size_t i = 0; i < parts.size() - 1; i++) {
-    uint8_t mod = findModifierCode(parts[i]);
-    if (mod != 0) {
-      modifiers.push_back(mod);
+  // Parsed aside: a line that doesn't parse leaves REPEAT's command alone
+  DuckyCommand cmd;
+  if (!parse(s, n, cmd)) return;
+  last = cmd;
+  run(last);
+}
+
+void DuckyScriptStream::feed(const char* data, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    char c = data[i];
+    if (c == '\n') {
+      endLine();
+      continue;
     }
+    if (overflow == OVERFLOW_SKIP) continue;
+    line[len++] = c;
+    if (len == DUCKY_LINE_MAX) spill();
   }
-  
-  // Last part is the key
-  String keyName = parts[parts.size() - 1];
-  uint8_t keycode = findKeyCode(keyName);
-  
-  // Press modifiers
-  for (auto mod : modifiers) {
-    Keyboard.press(mod);
-  }
-  
-  // Press main key
-  if (keycode != 0) {
-    Keyboard.press(keycode);
-    delay(50);
-    Keyboard.release(keycode);
-  }
-  
-  // Release modifiers
-  for (auto mod : modifiers) {
-    Keyboard.release(mod);
+}
+
+void DuckyScriptStream::finish() {
+  if (len > 0 || overflow != OVERFLOW_NONE) endLine();
+  waitDue();
+}
+
+// Buffer full mid-line: a STRING/STRINGLN keeps typing its text in
+// pieces, anything else is too long to be a command and is dropped.
+// Neither can be replayed by REPEAT.
+void DuckyScriptStream::spill() {
+  if (overflow == OVERFLOW_NONE) {
+    const char* s = line;
+    size_t rest = len;
+    while (rest > 0 && isBlank(s[0])) { s++; rest--; }
+    last.kind = DUCKY_NONE;
+    if (hasPrefix(s, rest, "STRINGLN ")) {
+      overflow = OVERFLOW_STRINGLN;
+      waitDue();
+      typeText(s + 9, rest - 9);
+    } else if (hasPrefix(s, rest, "STRING ")) {
+      overflow = OVERFLOW_STRING;
+      waitDue();
+      typeText(s + 7, rest - 7);
+    } else {
+      overflow = OVERFLOW_SKIP;
+    }
+  } else {
+    typeText(line, len);
   }
-  
-  delay(10);
+  len = 0;
+}
+
+void DuckyScriptStream::endLine() {
+  if (overflow == OVERFLOW_NONE) {
+    line[len] = '\0';  // len < DUCKY_LINE_MAX here; lets atol() stop
+    runLine(line, len);
+  } else if (overflow != OVERFLOW_SKIP) {
+    // Tail of a long STRING: trailing whitespace is trimmed like a short line
+    while (len > 0 && isBlank(line[len - 1])) len--;
+    typeText(line, len);
+    if (overflow == OVERFLOW_STRINGLN) typeText("\r\n", 2);
+    schedule(defaultDelayMs);
+  }
+  len = 0;
+  overflow = OVERFLOW_NONE;
 }
 
 // Process entire DuckyScript (multi-line)
 void processDuckyScript(const String& script) {
-  int start = 0;
-  while (start < script.length()) {
-    int end = script.indexOf('\n', start);
-    if (end < 0) end = script.length();
-    
-    String line = script.substring(start, end);
-    line.trim();
-    
-    if (line.length() > 0) {
-      processDuckyScriptLine(line);
-    }
-    
-    start = end + 1;
+  DuckyScriptStream stream;
+  stream.feed(script.c_str(), script.length());
+  stream.finish();
+}
+
+void processDuckyScriptFile(File& f) {
+  DuckyScriptStream stream;
+  char buf[DUCKY_READ_CHUNK];
+  while (true) {
+    int n = f.read((uint8_t*)buf, sizeof(buf));
+    if (n <= 0) break;
+    stream.feed(buf, n);
   }
+  stream.finish();
+}
+
+static bool contains(const char* s, size_t len, const char* word) {
+  size_t n = strlen(word);
+  for (size_t i = 0; i + n <= len; ++i) {
+    if (s[i] == word[0] && memcmp(s + i, word, n) == 0) return true;
+  }
+  return false;
 }
 
 // Detect if content looks like DuckyScript
-bool isDuckyScriptFile(const String& content) {
+bool isDuckyScriptFile(const char* content, size_t len) {
   // Check for common DuckyScript commands
-  return content.indexOf("REM ") >= 0 ||
-         content.indexOf("DELAY ") >= 0 ||
-         content.indexOf("STRING ") >= 0 ||
-         content.indexOf("GUI ") >= 0 ||
-         content.indexOf("CTRL ") >= 0 ||
-         content.indexOf("ALT ") >= 0 ||
-         content.indexOf("ENTER") >= 0;
+  static const char* const words[] = {"REM ", "DELAY ", "STRING ", "GUI ", "CTRL ", "ALT ", "ENTER"};
+  for (const char* w : words) {
+    if (contains(content, len, w)) return true;
+  }
+  return false;
+}
+
+bool isDuckyScriptFile(const String& content) {
+  return isDuckyScriptFile(content.c_str(), content.length());
 }
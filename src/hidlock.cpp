@@ -0,0 +1,17 @@
+#include "hidlock.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+static SemaphoreHandle_t hidMutex = nullptr;
+
+void hidLockBegin() {
+  if (!hidMutex) hidMutex = xSemaphoreCreateRecursiveMutex();
+}
+
+void hidLock() {
+  if (hidMutex) xSemaphoreTakeRecursive(hidMutex, portMAX_DELAY);
+}
+
+void hidUnlock() {
+  if (hidMutex) xSemaphoreGiveRecursive(hidMutex);
+}
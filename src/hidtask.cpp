@@ -0,0 +1,98 @@
+#include "hidtask.h"
+#include "macrovm.h"
+#include "usb.h"
+#include "mouseacc.h"
+#include "hidlock.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static SpscRing<HID_QUEUE_SIZE> hidRing;
+static TaskHandle_t hidTask = nullptr;
+
+// Pushes each compiled op into the ring, backing off briefly while the
+// HID task catches up
+class HidQueueSink : public MacroSink {
+public:
+  HidQueueSink() : ok(true) {}
+  void write(const uint8_t* data, size_t len) override {
+    uint32_t start = millis();
+    while (!hidRing.push(data, len)) {
+      if (millis() - start >= HID_QUEUE_WAIT_MS) {
+        hidRing.noteDrop();
+        ok = false;
+        return;
+      }
+      xTaskNotifyGive(hidTask);
+      vTaskDelay(1);
+    }
+    xTaskNotifyGive(hidTask);
+  }
+  bool ok;
+};
+
+static void hidTaskMain(void* arg) {
+  // Live Control uses a short key hold (10ms vs 50ms for SD files)
+  static MacroVM vm(10);
+  static uint8_t op[MACRO_OP_MAX];
+  vm.setCoalesceMouse(true);
+  for (;;) {
+    // Drain everything queued so a trackpad burst sums into one report
+    int len;
+    while ((len = hidRing.pop(op, sizeof(op))) >= 0) {
+      // An empty frame starts a new line: SPEED/TURBO don't carry over
+      if (len == 0) vm.reset();
+      else vm.write(op, len);
+    }
+    // One mouse report per pass; it returns once the host has polled,
+    // so motion arriving meanwhile is folded into the next report
+    if (mouseAccPending()) {
+      mouseAccFlushOne();
+      continue;
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+}
+
+void hidTaskStart() {
+  if (hidTask) return;
+  hidLockBegin();
+  xTaskCreatePinnedToCore(hidTaskMain, "hid", HID_TASK_STACK, nullptr,
+                          HID_TASK_PRIORITY, &hidTask, HID_TASK_CORE);
+}
+
+bool hidQueueMacroText(const String& text) {
+  if (!hidTask) {
+    processMacroText(text);
+    return true;
+  }
+  if (currentUSBMode != MODE_HID) {
+    startUSBMode(MODE_HID);
+  }
+
+  HidQueueSink sink;
+  uint8_t lineStart = 0;
+  sink.write(&lineStart, 0);  // empty frame: new line
+  MacroCompiler compiler(sink);
+  compiler.feed(text);
+  compiler.finish();
+  return sink.ok;
+}
+
+bool hidQueueOps(const uint8_t* ops, size_t len) {
+  if (!hidTask) {
+    static MacroVM direct(10);
+    direct.write(ops, len);
+    return true;
+  }
+  if (currentUSBMode != MODE_HID) {
+    startUSBMode(MODE_HID);
+  }
+
+  HidQueueSink sink;
+  sink.write(ops, len);
+  return sink.ok;
+}
+
+RingStats hidQueueStats() {
+  return hidRing.stats();
+}
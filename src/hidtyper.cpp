@@ -0,0 +1,193 @@
+#include "hidtyper.h"
+#include "hidlock.h"
+#include <USBHIDKeyboard.h>
+
+// External keyboard reference from main.cpp
+extern USBHIDKeyboard Keyboard;
+
+#define HID_SHIFT 0x80                 // table flag: needs Left Shift
+#define HID_MOD_LEFT_SHIFT 0x02        // report modifier bit for Left Shift
+#define HID_REPORT_KEYS 6
+
+// ASCII -> HID usage (US layout); HID_SHIFT marks shifted characters
+static const uint8_t hidAsciiMap[128] = {
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // NUL..BEL
+  0x2a,                                            // BS  Backspace
+  0x2b,                                            // TAB Tab
+  0x28,                                            // LF  Enter
+  0x00, 0x00, 0x00, 0x00, 0x00,                    // VT FF CR SO SI
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  // DLE..ETB
+  0x00, 0x00, 0x00,                                // CAN EM SUB
+  0x29,                                            // ESC Escape
+  0x00, 0x00, 0x00, 0x00,                          // FS GS RS US
+
+  0x2c,             // ' '
+  0x1e | HID_SHIFT, // !
+  0x34 | HID_SHIFT, // "
+  0x20 | HID_SHIFT, // #
+  0x21 | HID_SHIFT, // $
+  0x22 | HID_SHIFT, // %
+  0x24 | HID_SHIFT, // &
+  0x34,             // '
+  0x26 | HID_SHIFT, // (
+  0x27 | HID_SHIFT, // )
+  0x25 | HID_SHIFT, // *
+  0x2e | HID_SHIFT, // +
+  0x36,             // ,
+  0x2d,             // -
+  0x37,             // .
+  0x38,             // /
+  0x27,             // 0
+  0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26,  // 1..9
+  0x33 | HID_SHIFT, // :
+  0x33,             // ;
+  0x36 | HID_SHIFT, // <
+  0x2e,             // =
+  0x37 | HID_SHIFT, // >
+  0x38 | HID_SHIFT, // ?
+  0x1f | HID_SHIFT, // @
+
+  // A..Z
+  0x04 | HID_SHIFT, 0x05 | HID_SHIFT, 0x06 | HID_SHIFT, 0x07 | HID_SHIFT,
+  0x08 | HID_SHIFT, 0x09 | HID_SHIFT, 0x0a | HID_SHIFT, 0x0b | HID_SHIFT,
+  0x0c | HID_SHIFT, 0x0d | HID_SHIFT, 0x0e | HID_SHIFT, 0x0f | HID_SHIFT,
+  0x10 | HID_SHIFT, 0x11 | HID_SHIFT, 0x12 | HID_SHIFT, 0x13 | HID_SHIFT,
+  0x14 | HID_SHIFT, 0x15 | HID_SHIFT, 0x16 | HID_SHIFT, 0x17 | HID_SHIFT,
+  0x18 | HID_SHIFT, 0x19 | HID_SHIFT, 0x1a | HID_SHIFT, 0x1b | HID_SHIFT,
+  0x1c | HID_SHIFT, 0x1d | HID_SHIFT,
+
+  0x2f,             // [
+  0x31,             // backslash
+  0x30,             // ]
+  0x23 | HID_SHIFT, // ^
+  0x2d | HID_SHIFT, // _
+  0x35,             // `
+
+  // a..z
+  0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10,
+  0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+
+  0x2f | HID_SHIFT, // {
+  0x31 | HID_SHIFT, // |
+  0x30 | HID_SHIFT, // }
+  0x35 | HID_SHIFT, // ~
+  0x00              // DEL
+};
+
+bool hidAsciiToKey(uint8_t c, uint8_t& usage, uint8_t& modifiers) {
+  if (c >= 128) return false;
+  uint8_t entry = hidAsciiMap[c];
+  usage = entry & ~HID_SHIFT;
+  modifiers = (entry & HID_SHIFT) ? HID_MOD_LEFT_SHIFT : 0;
+  return usage != 0;
+}
+
+// Keys held through hidKeyPress(), mirroring Keyboard's own report
+static KeyReport held;
+
+// Arduino keycode (as taken by Keyboard.press) -> usage + modifier bits
+static bool keyToReport(uint8_t k, uint8_t& usage, uint8_t& modifiers) {
+  if (k >= 136) {
+    usage = k - 136;
+    modifiers = 0;
+    if (usage >= 0xE0 && usage < 0xE8) {
+      modifiers = 1 << (usage - 0xE0);
+      usage = 0;
+    }
+    return true;
+  }
+  if (k >= 128) {
+    usage = 0;
+    modifiers = 1 << (k - 128);
+    return true;
+  }
+  return hidAsciiToKey(k, usage, modifiers);
+}
+
+static uint8_t heldKeyCount() {
+  uint8_t n = 0;
+  for (uint8_t k = 0; k < HID_REPORT_KEYS; ++k) {
+    if (held.keys[k]) held.keys[n++] = held.keys[k];
+  }
+  for (uint8_t k = n; k < HID_REPORT_KEYS; ++k) held.keys[k] = 0;
+  return n;
+}
+
+void hidKeyPress(uint8_t k) {
+  HidLockGuard lock;
+  uint8_t usage, mods;
+  if (keyToReport(k, usage, mods)) {
+    held.modifiers |= mods;
+    uint8_t n = heldKeyCount();
+    bool present = usage == 0;
+    for (uint8_t i = 0; i < n && !present; ++i) present = held.keys[i] == usage;
+    if (!present && n < HID_REPORT_KEYS) held.keys[n] = usage;
+  }
+  Keyboard.press(k);
+}
+
+void hidKeyRelease(uint8_t k) {
+  HidLockGuard lock;
+  uint8_t usage, mods;
+  if (keyToReport(k, usage, mods)) {
+    held.modifiers &= ~mods;
+    for (uint8_t i = 0; i < HID_REPORT_KEYS && usage; ++i) {
+      if (held.keys[i] == usage) held.keys[i] = 0;
+    }
+  }
+  Keyboard.release(k);
+}
+
+void hidKeyReleaseAll() {
+  HidLockGuard lock;
+  memset(&held, 0, sizeof(held));
+  Keyboard.releaseAll();
+}
+
+size_t hidTypeStep(const uint8_t* s, size_t len, bool turbo) {
+  HidLockGuard lock;
+  // Typed keys go on top of whatever is held, so holds survive typing
+  uint8_t base = heldKeyCount();
+  KeyReport report = held;
+  uint8_t count = base;
+  uint8_t typedMods = 0;
+  size_t i = 0;
+
+  for (; i < len; ++i) {
+    uint8_t usage, mods;
+    if (!hidAsciiToKey(s[i], usage, mods)) continue;
+
+    // A key conflicts with the pending report if the modifier state
+    // differs or the same usage is already down (needs a release first)
+    bool conflict = count == HID_REPORT_KEYS || (count > base && mods != typedMods);
+    for (uint8_t k = base; k < count && !conflict; ++k) {
+      conflict = report.keys[k] == usage;
+    }
+    if (conflict) break;
+
+    typedMods = mods;
+    report.keys[count++] = usage;
+    if (!turbo) {
+      ++i;
+      break;
+    }
+  }
+
+  if (count > base) {
+    report.modifiers = held.modifiers | typedMods;
+    Keyboard.sendReport(&report);
+    Keyboard.sendReport(&held);
+  } else if (i == 0 && len > 0) {
+    i = 1;  // all six slots held: drop the character rather than stall
+  }
+  return i;
+}
+
+void hidTypeBytes(const uint8_t* s, size_t len, bool turbo, uint8_t gapMs) {
+  while (len > 0) {
+    size_t n = hidTypeStep(s, len, turbo);
+    s += n;
+    len -= n;
+    if (!turbo && gapMs > 0) delay(gapMs);
+  }
+}
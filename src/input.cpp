@@ -190,9 +190,7 @@ void handleFileMenuButton(int& selection, bool& confirmed, int maxItems) {
         if (maxItems > 0) {
           selection = (selection + 1) % maxItems;
           // Need to redraw menu with new selection
-          extern String fileList[15];
-          extern int fileCount;
-          drawFileMenu(selection, fileList, fileCount);
+          drawFileMenu(selection, maxItems);
         }
       }
 
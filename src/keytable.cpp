@@ -0,0 +1,259 @@
+#include "keytable.h"
+#include <USBHIDKeyboard.h>
+
+// Locking and system keys are missing from some core versions; these are
+// the same HID usage + 136 encoding USBHIDKeyboard uses for the others.
+#ifndef KEY_CAPS_LOCK
+#define KEY_CAPS_LOCK 0xC1
+#endif
+#ifndef KEY_PRINT_SCREEN
+#define KEY_PRINT_SCREEN 0xCE
+#endif
+#ifndef KEY_SCROLL_LOCK
+#define KEY_SCROLL_LOCK 0xCF
+#endif
+#ifndef KEY_PAUSE
+#define KEY_PAUSE 0xD0
+#endif
+#ifndef KEY_NUM_LOCK
+#define KEY_NUM_LOCK 0xDB
+#endif
+#ifndef KEY_MENU
+#define KEY_MENU 0xED
+#endif
+
+// Keypad operators under the names the table uses (the ESP32 core calls
+// them KEY_KP_PLUS, KEY_KP_MINUS, KEY_KP_ASTERISK, KEY_KP_SLASH, KEY_KP_DOT)
+#ifdef KEY_KP_0
+#if !defined(KEY_KP_ADD) && defined(KEY_KP_PLUS)
+#define KEY_KP_ADD KEY_KP_PLUS
+#endif
+#if !defined(KEY_KP_SUBTRACT) && defined(KEY_KP_MINUS)
+#define KEY_KP_SUBTRACT KEY_KP_MINUS
+#endif
+#if !defined(KEY_KP_MULTIPLY) && defined(KEY_KP_ASTERISK)
+#define KEY_KP_MULTIPLY KEY_KP_ASTERISK
+#endif
+#if !defined(KEY_KP_DIVIDE) && defined(KEY_KP_SLASH)
+#define KEY_KP_DIVIDE KEY_KP_SLASH
+#endif
+#if !defined(KEY_KP_DECIMAL) && defined(KEY_KP_DOT)
+#define KEY_KP_DECIMAL KEY_KP_DOT
+#endif
+#endif
+
+struct KeyEntry {
+  const char* name;  // lowercase
+  uint8_t code;
+};
+
+// Must stay sorted by name (byte order); the static_assert below checks it.
+// Keypad and media keys only exist when the core defines their codes.
+static constexpr KeyEntry keyTable[] = {
+  {"alt", KEY_LEFT_ALT},
+  {"app", KEY_MENU},
+  {"backspace", KEY_BACKSPACE},
+  {"break", KEY_PAUSE},
+  {"caps", KEY_CAPS_LOCK},
+  {"capslock", KEY_CAPS_LOCK},
+  {"command", KEY_LEFT_GUI},
+  {"control", KEY_LEFT_CTRL},
+  {"ctrl", KEY_LEFT_CTRL},
+  {"del", KEY_DELETE},
+  {"delete", KEY_DELETE},
+  {"down", KEY_DOWN_ARROW},
+  {"downarrow", KEY_DOWN_ARROW},
+  {"end", KEY_END},
+  {"enter", KEY_RETURN},
+  {"esc", KEY_ESC},
+  {"escape", KEY_ESC},
+  {"f1", KEY_F1},
+  {"f10", KEY_F10},
+  {"f11", KEY_F11},
+  {"f12", KEY_F12},
+  {"f2", KEY_F2},
+  {"f3", KEY_F3},
+  {"f4", KEY_F4},
+  {"f5", KEY_F5},
+  {"f6", KEY_F6},
+  {"f7", KEY_F7},
+  {"f8", KEY_F8},
+  {"f9", KEY_F9},
+  {"gui", KEY_LEFT_GUI},
+  {"home", KEY_HOME},
+  {"ins", KEY_INSERT},
+  {"insert", KEY_INSERT},
+#ifdef KEY_KP_0
+  {"kp0", KEY_KP_0},
+  {"kp1", KEY_KP_1},
+  {"kp2", KEY_KP_2},
+  {"kp3", KEY_KP_3},
+  {"kp4", KEY_KP_4},
+  {"kp5", KEY_KP_5},
+  {"kp6", KEY_KP_6},
+  {"kp7", KEY_KP_7},
+  {"kp8", KEY_KP_8},
+  {"kp9", KEY_KP_9},
+  {"kp_add", KEY_KP_ADD},
+  {"kp_decimal", KEY_KP_DECIMAL},
+  {"kp_divide", KEY_KP_DIVIDE},
+  {"kp_dot", KEY_KP_DECIMAL},
+  {"kp_enter", KEY_KP_ENTER},
+  {"kp_multiply", KEY_KP_MULTIPLY},
+  {"kp_subtract", KEY_KP_SUBTRACT},
+#endif
+  {"left", KEY_LEFT_ARROW},
+  {"leftarrow", KEY_LEFT_ARROW},
+  {"menu", KEY_MENU},
+#ifdef KEY_MEDIA_VOLUME_MUTE
+  {"mute", KEY_MEDIA_VOLUME_MUTE},
+#endif
+#ifdef KEY_MEDIA_NEXT_TRACK
+  {"next", KEY_MEDIA_NEXT_TRACK},
+  {"nexttrack", KEY_MEDIA_NEXT_TRACK},
+#endif
+  {"num", KEY_NUM_LOCK},
+  {"numlock", KEY_NUM_LOCK},
+#ifdef KEY_KP_0
+  {"numpad0", KEY_KP_0},
+  {"numpad1", KEY_KP_1},
+  {"numpad2", KEY_KP_2},
+  {"numpad3", KEY_KP_3},
+  {"numpad4", KEY_KP_4},
+  {"numpad5", KEY_KP_5},
+  {"numpad6", KEY_KP_6},
+  {"numpad7", KEY_KP_7},
+  {"numpad8", KEY_KP_8},
+  {"numpad9", KEY_KP_9},
+  {"numpad_add", KEY_KP_ADD},
+  {"numpad_decimal", KEY_KP_DECIMAL},
+  {"numpad_divide", KEY_KP_DIVIDE},
+  {"numpad_enter", KEY_KP_ENTER},
+  {"numpad_multiply", KEY_KP_MULTIPLY},
+  {"numpad_subtract", KEY_KP_SUBTRACT},
+#endif
+  {"pagedown", KEY_PAGE_DOWN},
+  {"pageup", KEY_PAGE_UP},
+  {"pause", KEY_PAUSE},
+#ifdef KEY_MEDIA_PLAY_PAUSE
+  {"play", KEY_MEDIA_PLAY_PAUSE},
+  {"playpause", KEY_MEDIA_PLAY_PAUSE},
+#endif
+#ifdef KEY_MEDIA_PREV_TRACK
+  {"prev", KEY_MEDIA_PREV_TRACK},
+  {"prevtrack", KEY_MEDIA_PREV_TRACK},
+#endif
+  {"print", KEY_PRINT_SCREEN},
+  {"printscreen", KEY_PRINT_SCREEN},
+  {"ralt", KEY_RIGHT_ALT},
+  {"raltgr", KEY_RIGHT_ALT},
+  {"rcontrol", KEY_RIGHT_CTRL},
+  {"rctrl", KEY_RIGHT_CTRL},
+  {"return", KEY_RETURN},
+  {"rgui", KEY_RIGHT_GUI},
+  {"right", KEY_RIGHT_ARROW},
+  {"rightarrow", KEY_RIGHT_ARROW},
+  {"rshift", KEY_RIGHT_SHIFT},
+  {"rwin", KEY_RIGHT_GUI},
+  {"rwindows", KEY_RIGHT_GUI},
+  {"scroll", KEY_SCROLL_LOCK},
+  {"scrolllock", KEY_SCROLL_LOCK},
+  {"shift", KEY_LEFT_SHIFT},
+  {"space", ' '},
+#ifdef KEY_MEDIA_STOP
+  {"stop", KEY_MEDIA_STOP},
+#endif
+  {"tab", KEY_TAB},
+  {"up", KEY_UP_ARROW},
+  {"uparrow", KEY_UP_ARROW},
+#ifdef KEY_MEDIA_VOLUME_DOWN
+  {"voldown", KEY_MEDIA_VOLUME_DOWN},
+  {"volumedown", KEY_MEDIA_VOLUME_DOWN},
+#endif
+#ifdef KEY_MEDIA_VOLUME_MUTE
+  {"volumemute", KEY_MEDIA_VOLUME_MUTE},
+#endif
+#ifdef KEY_MEDIA_VOLUME_UP
+  {"volumeup", KEY_MEDIA_VOLUME_UP},
+  {"volup", KEY_MEDIA_VOLUME_UP},
+#endif
+  {"win", KEY_LEFT_GUI},
+  {"windows", KEY_LEFT_GUI},
+};
+
+static constexpr size_t KEY_TABLE_SIZE = sizeof(keyTable) / sizeof(keyTable[0]);
+
+static constexpr bool keyNameLess(const char* a, const char* b) {
+  return *a == *b ? (*a != '\0' && keyNameLess(a + 1, b + 1))
+                  : (uint8_t)*a < (uint8_t)*b;
+}
+
+static constexpr bool keyTableSorted(size_t i) {
+  return i >= KEY_TABLE_SIZE ||
+         (keyNameLess(keyTable[i - 1].name, keyTable[i].name) && keyTableSorted(i + 1));
+}
+
+static_assert(keyTableSorted(1), "keyTable must be sorted by name");
+
+static char lowerAscii(char c) {
+  return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+// Case-insensitive compare of name[0..len) against a lowercase table entry
+static int compareName(const char* name, size_t len, const char* entry) {
+  for (size_t i = 0; i < len; ++i) {
+    char c = lowerAscii(name[i]);
+    if (entry[i] == '\0') return 1;
+    if (c != entry[i]) return (uint8_t)c < (uint8_t)entry[i] ? -1 : 1;
+  }
+  return entry[len] == '\0' ? 0 : -1;
+}
+
+static const KeyEntry* findKey(const char* name, size_t len) {
+  size_t lo = 0, hi = KEY_TABLE_SIZE;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    int cmp = compareName(name, len, keyTable[mid].name);
+    if (cmp == 0) return &keyTable[mid];
+    if (cmp < 0) hi = mid;
+    else lo = mid + 1;
+  }
+  return nullptr;
+}
+
+static bool isModifierCode(uint8_t code) {
+  return code >= KEY_LEFT_CTRL && code <= KEY_RIGHT_GUI;
+}
+
+uint8_t keyCodeFromName(const char* name, size_t len) {
+  if (len == 1) return (uint8_t)name[0];
+  const KeyEntry* e = findKey(name, len);
+  return e ? e->code : 0;
+}
+
+uint8_t keyModifierFromName(const char* name, size_t len) {
+  const KeyEntry* e = findKey(name, len);
+  return (e && isModifierCode(e->code)) ? e->code : 0;
+}
+
+uint8_t keyParseCombo(const char* spec, size_t len, const char* seps,
+                      uint8_t* codes, uint8_t maxCodes) {
+  if (maxCodes == 0) return 0;
+  uint8_t n = 0;
+  size_t start = 0;
+  for (size_t i = 0; i <= len; ++i) {
+    // A lone separator character ("+") is a key, not an empty combo
+    bool atSep = i < len && len > 1 && strchr(seps, spec[i]) != nullptr;
+    if (!atSep && i < len) continue;
+
+    if (i == len) {
+      uint8_t code = keyCodeFromName(spec + start, i - start);
+      if (code != 0 && n < maxCodes) codes[n++] = code;
+    } else {
+      uint8_t mod = keyModifierFromName(spec + start, i - start);
+      if (mod != 0 && n < maxCodes - 1) codes[n++] = mod;
+    }
+    start = i + 1;
+  }
+  return n;
+}
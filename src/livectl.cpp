@@ -0,0 +1,229 @@
+#include "livectl.h"
+#include "hidtask.h"
+#include "keytable.h"
+#include "macrovm.h"
+#include <USBHIDKeyboard.h>
+#include <USBHIDMouse.h>
+
+// Mouse buttons held by binary M frames, keys held by K:..:D frames
+static uint8_t liveButtons = 0;
+static uint8_t liveKeys[MACRO_MAX_KEYS];
+static uint8_t liveKeyCount = 0;
+
+// Android KeyEvent codes that aren't a letter, digit or F key
+static const uint8_t androidKeys[][2] = {
+  {17, '*'}, {18, '#'},
+  {19, KEY_UP_ARROW}, {20, KEY_DOWN_ARROW}, {21, KEY_LEFT_ARROW}, {22, KEY_RIGHT_ARROW},
+  {55, ','}, {56, '.'},
+  {57, KEY_LEFT_ALT}, {58, KEY_RIGHT_ALT}, {59, KEY_LEFT_SHIFT}, {60, KEY_RIGHT_SHIFT},
+  {61, KEY_TAB}, {62, ' '}, {66, KEY_RETURN}, {67, KEY_BACKSPACE},
+  {68, '`'}, {69, '-'}, {70, '='}, {71, '['}, {72, ']'}, {73, '\\'},
+  {74, ';'}, {75, '\''}, {76, '/'}, {77, '@'}, {81, '+'}, {82, KEY_MENU},
+  {92, KEY_PAGE_UP}, {93, KEY_PAGE_DOWN},
+  {111, KEY_ESC}, {112, KEY_DELETE}, {113, KEY_LEFT_CTRL}, {114, KEY_RIGHT_CTRL},
+  {115, KEY_CAPS_LOCK}, {116, KEY_SCROLL_LOCK}, {117, KEY_LEFT_GUI}, {118, KEY_RIGHT_GUI},
+  {120, KEY_PRINT_SCREEN}, {121, KEY_PAUSE}, {122, KEY_HOME}, {123, KEY_END}, {124, KEY_INSERT},
+  {143, KEY_NUM_LOCK},
+  {154, '/'}, {155, '*'}, {156, '-'}, {157, '+'}, {158, '.'}, {160, KEY_RETURN},
+  {161, '='}, {162, '('}, {163, ')'},
+};
+
+// Android KeyEvent keycode -> USBHIDKeyboard code, 0 if unmapped
+static uint8_t keyFromAndroid(long code) {
+  if (code >= 29 && code <= 54) return 'a' + (code - 29);      // KEYCODE_A..Z
+  if (code >= 7 && code <= 16) return '0' + (code - 7);        // KEYCODE_0..9
+  if (code >= 144 && code <= 153) return '0' + (code - 144);   // NUMPAD_0..9
+  if (code >= 131 && code <= 142) return KEY_F1 + (code - 131);  // F1..F12
+  for (const auto& k : androidKeys) {
+    if (k[0] == code) return k[1];
+  }
+  return 0;
+}
+
+static void putI16(uint8_t* p, int v) {
+  p[0] = v & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+}
+
+static bool isDigits(const char* s, size_t len) {
+  if (len == 0) return false;
+  for (size_t i = 0; i < len; i++) {
+    if (s[i] < '0' || s[i] > '9') return false;
+  }
+  return true;
+}
+
+// Signed decimal filling all of s[0..len)
+static bool parseInt(const char* s, size_t len, long& out) {
+  bool neg = false;
+  if (len > 0 && (s[0] == '-' || s[0] == '+')) {
+    neg = s[0] == '-';
+    s++;
+    len--;
+  }
+  if (!isDigits(s, len) || len > 6) return false;
+  long v = 0;
+  for (size_t i = 0; i < len; i++) v = v * 10 + (s[i] - '0');
+  out = neg ? -v : v;
+  return true;
+}
+
+// Held keys are tracked so a disconnect can release them
+static bool queueKey(uint8_t code, bool down) {
+  if (code == 0) return false;
+  uint8_t op[2] = {(uint8_t)(down ? MOP_KEY_DOWN : MOP_KEY_UP), code};
+  if (!hidQueueOps(op, sizeof(op))) return true;
+  uint8_t i = 0;
+  while (i < liveKeyCount && liveKeys[i] != code) i++;
+  if (down && i == liveKeyCount && liveKeyCount < MACRO_MAX_KEYS) {
+    liveKeys[liveKeyCount++] = code;
+  } else if (!down && i < liveKeyCount) {
+    liveKeys[i] = liveKeys[--liveKeyCount];
+  }
+  return true;
+}
+
+// Motion and wheel, then a click of `click`
+static void queueMove(int dx, int dy, int wheel, uint8_t click) {
+  uint8_t ops[10];
+  size_t n = 0;
+  if (dx != 0 || dy != 0) {
+    ops[n] = MOP_MOUSE_REL;
+    putI16(ops + n + 1, dx);
+    putI16(ops + n + 3, dy);
+    n += 5;
+  }
+  if (wheel != 0) {
+    ops[n] = MOP_MOUSE_SCROLL;
+    putI16(ops + n + 1, wheel);
+    n += 3;
+  }
+  if (click) {
+    ops[n++] = MOP_MOUSE_CLICK;
+    ops[n++] = click;
+  }
+  // A click also ends a hold of that button
+  if (n > 0 && hidQueueOps(ops, n)) liveButtons &= ~click;
+}
+
+// Motion and wheel first, then the button changes against what is held
+static void queueMouse(int dx, int dy, uint8_t buttons, int wheel) {
+  uint8_t ops[14];
+  size_t n = 0;
+  if (dx != 0 || dy != 0) {
+    ops[n] = MOP_MOUSE_REL;
+    putI16(ops + n + 1, dx);
+    putI16(ops + n + 3, dy);
+    n += 5;
+  }
+  if (wheel != 0) {
+    ops[n] = MOP_MOUSE_SCROLL;
+    putI16(ops + n + 1, wheel);
+    n += 3;
+  }
+  uint8_t released = liveButtons & ~buttons;
+  uint8_t pressed = buttons & ~liveButtons;
+  if (released) {
+    ops[n++] = MOP_MOUSE_UP;
+    ops[n++] = released;
+  }
+  if (pressed) {
+    ops[n++] = MOP_MOUSE_DOWN;
+    ops[n++] = pressed;
+  }
+  // Dropped (queue full, counted in its stats): the held state is unchanged
+  if (n > 0 && !hidQueueOps(ops, n)) return;
+  liveButtons = buttons;
+}
+
+// code:D / code:U; a number is an Android keycode
+static bool keyFrame(const char* s, size_t len) {
+  if (len < 3 || s[len - 2] != ':') return false;
+  char action = s[len - 1];
+  if (action != 'D' && action != 'U') return false;
+  size_t codeLen = len - 2;
+  uint8_t code;
+  if (isDigits(s, codeLen)) {
+    code = codeLen <= 3 ? keyFromAndroid(atol(s)) : 0;
+  } else {
+    code = keyCodeFromName(s, codeLen);
+  }
+  return queueKey(code, action == 'D');
+}
+
+// dx:dy[:L|R|M|W:ticks]
+static bool mouseFrame(const char* s, size_t len) {
+  const char* c1 = (const char*)memchr(s, ':', len);
+  if (!c1) return false;
+  const char* rest = c1 + 1;
+  size_t restLen = len - (rest - s);
+  const char* c2 = (const char*)memchr(rest, ':', restLen);
+  size_t dyLen = c2 ? (size_t)(c2 - rest) : restLen;
+
+  long dx, dy;
+  if (!parseInt(s, c1 - s, dx) || !parseInt(rest, dyLen, dy)) return false;
+  if (dx < -32767 || dx > 32767 || dy < -32767 || dy > 32767) return false;
+
+  uint8_t click = 0;
+  long wheel = 0;
+  if (c2) {
+    const char* a = c2 + 1;
+    size_t aLen = s + len - a;
+    if (aLen == 1 && *a == 'L') click = MOUSE_LEFT;
+    else if (aLen == 1 && *a == 'R') click = MOUSE_RIGHT;
+    else if (aLen == 1 && *a == 'M') click = 0;  // plain move
+    else if (aLen >= 3 && a[0] == 'W' && a[1] == ':') {
+      // W:+ / W:- is one tick, W:+3 / W:-2 several
+      if (aLen == 3 && (a[2] == '+' || a[2] == '-')) wheel = a[2] == '+' ? 1 : -1;
+      else if (!parseInt(a + 2, aLen - 2, wheel) || wheel < -127 || wheel > 127) return false;
+    } else {
+      return false;
+    }
+  }
+  queueMove((int)dx, (int)dy, (int)wheel, click);
+  return true;
+}
+
+// Release everything earlier frames left held
+static bool releaseHeld() {
+  uint8_t ops[2 + 2 * MACRO_MAX_KEYS];
+  size_t n = 0;
+  if (liveButtons) {
+    ops[n++] = MOP_MOUSE_UP;
+    ops[n++] = liveButtons;
+  }
+  for (uint8_t i = 0; i < liveKeyCount; i++) {
+    ops[n++] = MOP_KEY_UP;
+    ops[n++] = liveKeys[i];
+  }
+  if (n > 0) hidQueueOps(ops, n);
+  liveButtons = 0;
+  liveKeyCount = 0;
+  return true;
+}
+
+static bool binaryFrame(const uint8_t* f) {
+  if (f[1] == 'K') return queueKey(keyFromAndroid(f[2]), f[3] != 0);
+  if (f[1] == LIVE_FRAME_RELEASE) return releaseHeld();
+  if (f[1] == 'M') {
+    uint8_t buttons = 0;
+    if (f[4] & 0x01) buttons |= MOUSE_LEFT;
+    if (f[4] & 0x02) buttons |= MOUSE_RIGHT;
+    if (f[4] & 0x04) buttons |= MOUSE_MIDDLE;
+    queueMouse((int8_t)f[2], (int8_t)f[3], buttons, (int8_t)f[5]);
+    return true;
+  }
+  return false;
+}
+
+bool liveControlFrame(const char* line, size_t len) {
+  if (len == LIVE_FRAME_SIZE && (uint8_t)line[0] == LIVE_FRAME_MARK) {
+    return binaryFrame((const uint8_t*)line);
+  }
+  // Text frames: uppercase prefix only, so typed text rarely matches
+  while (len > 0 && (line[len - 1] == '\r' || line[len - 1] == ' ')) len--;
+  if (len < 3 || line[1] != ':') return false;
+  if (line[0] == 'K') return keyFrame(line + 2, len - 2);
+  if (line[0] == 'M') return mouseFrame(line + 2, len - 2);
+  return false;
+}
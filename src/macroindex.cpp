@@ -0,0 +1,482 @@
+#include "macroindex.h"
+#include "macrovm.h"
+#include "duckyscript.h"
+#include "scriptengine.h"
+#include <vector>
+
+// Index file header; records follow back to back
+struct MacroIndexHeader {
+  char magic[4];
+  uint8_t version;
+  uint8_t reserved[3];
+  uint32_t count;
+};
+
+static const char MACRO_INDEX_MAGIC[4] = {'P', 'W', 'I', 'X'};
+static const uint8_t MACRO_INDEX_VERSION = 3;
+static const char* MACRO_INDEX_TMP = "/.pwindex.tmp";
+static const char* MACRO_INDEX_RUNS = "/.pwindex.run";  // rebuild: sorted runs
+
+static bool indexLoaded = false;
+static uint32_t indexCount = 0;
+
+// ------------------------------------------------------------------
+// Helpers
+// ------------------------------------------------------------------
+
+static bool allDigits(const char* s) {
+  if (*s == '\0') return false;
+  for (; *s; ++s) {
+    if (*s < '0' || *s > '9') return false;
+  }
+  return true;
+}
+
+// All-numeric names come first, by value ("2" before "10"); everything
+// else follows in byte order, so a folder's files are contiguous
+static int compareNames(const char* a, const char* b) {
+  bool da = allDigits(a);
+  bool db = allDigits(b);
+  if (da != db) return da ? -1 : 1;
+  if (da) {
+    long x = atol(a);
+    long y = atol(b);
+    if (x != y) return x < y ? -1 : 1;
+  }
+  return strcmp(a, b);
+}
+
+static int compareEntries(const void* a, const void* b) {
+  return compareNames(((const MacroIndexEntry*)a)->name, ((const MacroIndexEntry*)b)->name);
+}
+
+static String pathOf(const char* name) {
+  return "/" + String(name) + ".txt";
+}
+
+// Fill a record from the file itself: one read pass hashes the content,
+// the first block doubles as the format sample
+static bool scanFile(fs::FS& fs, const char* name, MacroIndexEntry& e) {
+  if (strlen(name) >= MACRO_INDEX_NAME_MAX) return false;
+  String path = pathOf(name);
+  File f = fs.open(path, FILE_READ);
+  if (!f) return false;
+  if (f.isDirectory()) {
+    f.close();
+    return false;
+  }
+
+  memset(&e, 0, sizeof(e));
+  strncpy(e.name, name, MACRO_INDEX_NAME_MAX - 1);
+  e.size = (uint32_t)f.size();
+  e.mtime = (uint32_t)f.getLastWrite();
+
+  uint8_t buf[MACRO_FORMAT_SAMPLE];
+  uint32_t h = MACRO_HASH_SEED;
+  bool first = true;
+  e.format = MACRO_FORMAT_MACRO;
+  while (true) {
+    int n = f.read(buf, sizeof(buf));
+    if (n <= 0) break;
+    if (first) e.format = macroDetectFormat((const char*)buf, n);
+    first = false;
+    h = macroHash(h, buf, n);
+  }
+  f.close();
+
+  e.hash = h;
+  e.flags = macroCacheFresh(fs, path, e.size, e.mtime, h) ? MACRO_INDEX_CACHED : 0;
+  return true;
+}
+
+static bool readHeader(File& f, MacroIndexHeader& hdr) {
+  if (!f.seek(0)) return false;
+  if (f.read((uint8_t*)&hdr, sizeof(hdr)) != sizeof(hdr)) return false;
+  if (memcmp(hdr.magic, MACRO_INDEX_MAGIC, 4) != 0 || hdr.version != MACRO_INDEX_VERSION) return false;
+  return f.size() == sizeof(hdr) + (size_t)hdr.count * sizeof(MacroIndexEntry);
+}
+
+static bool writeHeader(File& f, uint32_t count) {
+  MacroIndexHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, MACRO_INDEX_MAGIC, 4);
+  hdr.version = MACRO_INDEX_VERSION;
+  hdr.count = count;
+  return f.seek(0) && f.write((const uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr);
+}
+
+// Swap the finished temp file in as the index
+static bool commitIndex(fs::FS& fs, uint32_t count) {
+  if (fs.exists(MACRO_INDEX_PATH)) fs.remove(MACRO_INDEX_PATH);
+  if (!fs.rename(MACRO_INDEX_TMP, MACRO_INDEX_PATH)) {
+    fs.remove(MACRO_INDEX_TMP);
+    indexLoaded = false;
+    return false;
+  }
+  indexCount = count;
+  indexLoaded = true;
+  return true;
+}
+
+static bool writeEntry(File& f, const MacroIndexEntry& e) {
+  return f.write((const uint8_t*)&e, sizeof(e)) == sizeof(e);
+}
+
+// Stream the index into a temp file, merging in `add` (sorted, `n`
+// records, replacing same-named ones) and dropping `removeName`
+static bool mergeIndex(fs::FS& fs, const MacroIndexEntry* add, uint32_t n, const char* removeName) {
+  File out = fs.open(MACRO_INDEX_TMP, FILE_WRITE);
+  if (!out) return false;
+  bool ok = writeHeader(out, 0);
+  uint32_t written = 0;
+  uint32_t j = 0;
+
+  File in;
+  if (macroIndexOpen(fs, in)) {
+    MacroIndexEntry rec;
+    uint32_t count = indexCount;
+    for (uint32_t i = 0; ok && i < count; ++i) {
+      if (!macroIndexReadAt(in, i, rec)) {
+        ok = false;
+        break;
+      }
+      while (ok && j < n && compareNames(add[j].name, rec.name) < 0) {
+        ok = writeEntry(out, add[j++]);
+        written++;
+      }
+      if (j < n && compareNames(add[j].name, rec.name) == 0) continue;  // replaced below
+      if (removeName && strcmp(rec.name, removeName) == 0) continue;
+      ok = ok && writeEntry(out, rec);
+      written++;
+    }
+    in.close();
+  }
+  while (ok && j < n) {
+    ok = writeEntry(out, add[j++]);
+    written++;
+  }
+  ok = ok && writeHeader(out, written);
+  out.close();
+  if (!ok) {
+    fs.remove(MACRO_INDEX_TMP);
+    return false;
+  }
+  return commitIndex(fs, written);
+}
+
+// Record `pos` of a file in the index layout (header + records)
+static bool readRecord(File& f, uint32_t pos, MacroIndexEntry& e) {
+  return f.seek(sizeof(MacroIndexHeader) + pos * sizeof(MacroIndexEntry)) &&
+         f.read((uint8_t*)&e, sizeof(e)) == sizeof(e);
+}
+
+// One rebuild merge pass: `src` holds `total` records as sorted runs of
+// `runLen`; every MACRO_INDEX_MERGE_WAYS neighbouring runs are merged
+// into one run of `dst`. `heads` has room for MACRO_INDEX_MERGE_WAYS.
+static bool mergeRuns(fs::FS& fs, const char* src, const char* dst, uint32_t total,
+                      uint32_t runLen, MacroIndexEntry* heads) {
+  File in = fs.open(src, FILE_READ);
+  if (!in) return false;
+  File out = fs.open(dst, FILE_WRITE);
+  bool ok = out && writeHeader(out, total);
+  uint32_t next[MACRO_INDEX_MERGE_WAYS];
+  uint32_t end[MACRO_INDEX_MERGE_WAYS];
+
+  for (uint32_t group = 0; ok && group < total; ) {
+    uint8_t ways = 0;
+    for (; ways < MACRO_INDEX_MERGE_WAYS && group < total; ++ways) {
+      next[ways] = group;
+      end[ways] = total - group > runLen ? group + runLen : total;
+      group = end[ways];
+      ok = ok && readRecord(in, next[ways], heads[ways]);
+    }
+    while (ok) {
+      int best = -1;
+      for (uint8_t w = 0; w < ways; ++w) {
+        if (next[w] < end[w] && (best < 0 || compareEntries(&heads[w], &heads[best]) < 0)) best = w;
+      }
+      if (best < 0) break;
+      ok = writeEntry(out, heads[best]);
+      if (++next[best] < end[best]) ok = ok && readRecord(in, next[best], heads[best]);
+    }
+  }
+  in.close();
+  if (out) out.close();
+  return ok;
+}
+
+// ------------------------------------------------------------------
+// Public API
+// ------------------------------------------------------------------
+
+bool macroIndexOpen(fs::FS& fs, File& index) {
+  index = fs.open(MACRO_INDEX_PATH, FILE_READ);
+  if (!index) return false;
+  MacroIndexHeader hdr;
+  if (!readHeader(index, hdr)) {
+    index.close();
+    return false;
+  }
+  indexCount = hdr.count;
+  return true;
+}
+
+bool macroIndexReadAt(File& index, uint32_t pos, MacroIndexEntry& entry) {
+  if (pos >= indexCount) return false;
+  if (!index.seek(sizeof(MacroIndexHeader) + pos * sizeof(MacroIndexEntry))) return false;
+  if (index.read((uint8_t*)&entry, sizeof(entry)) != sizeof(entry)) return false;
+  entry.name[MACRO_INDEX_NAME_MAX - 1] = '\0';
+  return true;
+}
+
+bool macroIndexLoad(fs::FS& fs) {
+  if (indexLoaded) return true;
+  File index;
+  if (macroIndexOpen(fs, index)) {
+    index.close();
+    indexLoaded = true;
+    return true;
+  }
+  return macroIndexRebuild(fs);
+}
+
+// Walk every directory (one handle open at a time), writing scanned
+// records as sorted RAM-sized runs, then merge the runs in passes of
+// MACRO_INDEX_MERGE_WAYS: each pass reads and writes every record once
+bool macroIndexRebuild(fs::FS& fs) {
+  macroIndexDrop(fs);
+  MacroIndexEntry* chunk = (MacroIndexEntry*)malloc(MACRO_INDEX_CHUNK * sizeof(MacroIndexEntry));
+  if (!chunk) return false;
+  File runs = fs.open(MACRO_INDEX_RUNS, FILE_WRITE);
+  bool ok = runs && writeHeader(runs, 0);
+  uint32_t used = 0;
+  uint32_t total = 0;
+
+  std::vector<String> dirs;
+  dirs.push_back("/");
+  while (ok && !dirs.empty()) {
+    String dirPath = dirs.back();
+    dirs.pop_back();
+    File dir = fs.open(dirPath);
+    if (!dir || !dir.isDirectory()) continue;
+
+    File file;
+    while (ok && (file = dir.openNextFile())) {
+      String path = String(file.path());
+      bool isDir = file.isDirectory();
+      file.close();
+      String leaf = path.substring(path.lastIndexOf('/') + 1);
+      if (leaf.startsWith(".") || leaf == "System Volume Information") continue;
+      if (isDir) {
+        dirs.push_back(path);
+        continue;
+      }
+      if (!path.endsWith(".txt")) continue;
+
+      String name = path.substring(1, path.length() - 4);
+      if (scanFile(fs, name.c_str(), chunk[used])) used++;
+      if (used == MACRO_INDEX_CHUNK) {
+        qsort(chunk, used, sizeof(MacroIndexEntry), compareEntries);
+        for (uint32_t i = 0; ok && i < used; ++i) ok = writeEntry(runs, chunk[i]);
+        total += used;
+        used = 0;
+      }
+    }
+    dir.close();
+  }
+  if (ok && used > 0) {
+    qsort(chunk, used, sizeof(MacroIndexEntry), compareEntries);
+    for (uint32_t i = 0; ok && i < used; ++i) ok = writeEntry(runs, chunk[i]);
+    total += used;
+  }
+  ok = ok && writeHeader(runs, total);
+  if (runs) runs.close();
+
+  // Merge passes alternate between the two temp files
+  const char* src = MACRO_INDEX_RUNS;
+  const char* dst = MACRO_INDEX_TMP;
+  for (uint32_t runLen = MACRO_INDEX_CHUNK; ok && runLen < total; runLen *= MACRO_INDEX_MERGE_WAYS) {
+    ok = mergeRuns(fs, src, dst, total, runLen, chunk);
+    const char* t = src;
+    src = dst;
+    dst = t;
+  }
+  free(chunk);
+  if (ok && src != MACRO_INDEX_TMP) {
+    if (fs.exists(MACRO_INDEX_TMP)) fs.remove(MACRO_INDEX_TMP);
+    ok = fs.rename(src, MACRO_INDEX_TMP);
+  }
+  if (fs.exists(MACRO_INDEX_RUNS)) fs.remove(MACRO_INDEX_RUNS);
+  ok = ok && commitIndex(fs, total);
+  if (!ok) {
+    if (fs.exists(MACRO_INDEX_TMP)) fs.remove(MACRO_INDEX_TMP);
+    macroIndexDrop(fs);
+  }
+  return ok;
+}
+
+void macroIndexDrop(fs::FS& fs) {
+  if (fs.exists(MACRO_INDEX_PATH)) fs.remove(MACRO_INDEX_PATH);
+  indexLoaded = false;
+  indexCount = 0;
+}
+
+uint32_t macroIndexCount() {
+  return indexLoaded ? indexCount : 0;
+}
+
+// Binary search by seek; returns the record's position or -1
+static int32_t findPos(File& index, const char* name, MacroIndexEntry& entry) {
+  int32_t lo = 0, hi = (int32_t)indexCount - 1;
+  while (lo <= hi) {
+    int32_t mid = lo + (hi - lo) / 2;
+    if (!macroIndexReadAt(index, mid, entry)) return -1;
+    int cmp = compareNames(entry.name, name);
+    if (cmp == 0) return mid;
+    if (cmp < 0) lo = mid + 1;
+    else hi = mid - 1;
+  }
+  return -1;
+}
+
+// A name already in the index keeps its sorted position, so a rescan
+// overwrites its record in place; only inserts and removals rewrite the
+// index
+bool macroIndexUpdate(fs::FS& fs, const String& name) {
+  if (!macroIndexLoad(fs)) return false;
+  MacroIndexEntry entry;
+  bool exists = scanFile(fs, name.c_str(), entry);
+
+  File index = fs.open(MACRO_INDEX_PATH, "r+");
+  if (!index) return false;
+  MacroIndexEntry old;
+  int32_t pos = findPos(index, name.c_str(), old);
+  bool written = exists && pos >= 0 &&
+                 index.seek(sizeof(MacroIndexHeader) + pos * sizeof(MacroIndexEntry)) &&
+                 writeEntry(index, entry);
+  index.close();
+
+  if (written) return true;
+  if (exists) return mergeIndex(fs, &entry, 1, nullptr);
+  return pos < 0 || mergeIndex(fs, nullptr, 0, name.c_str());
+}
+
+uint32_t macroIndexLowerBound(File& index, const String& name) {
+  uint32_t lo = 0, hi = indexCount;
+  MacroIndexEntry entry;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (!macroIndexReadAt(index, mid, entry)) return indexCount;
+    if (compareNames(entry.name, name.c_str()) < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
+
+bool macroIndexFind(fs::FS& fs, const String& name, MacroIndexEntry& entry) {
+  if (!macroIndexLoad(fs)) return false;
+  File index;
+  if (!macroIndexOpen(fs, index)) return false;
+  bool found = findPos(index, name.c_str(), entry) >= 0;
+  index.close();
+  return found;
+}
+
+// Flip the cache flag in place; the record's position doesn't change
+bool macroIndexSetCached(fs::FS& fs, const String& name, bool cached) {
+  if (!macroIndexLoad(fs)) return false;
+  File index = fs.open(MACRO_INDEX_PATH, "r+");
+  if (!index) return false;
+  MacroIndexEntry entry;
+  int32_t pos = findPos(index, name.c_str(), entry);
+  bool ok = pos >= 0;
+  if (ok && ((entry.flags & MACRO_INDEX_CACHED) != 0) != cached) {
+    entry.flags = cached ? (entry.flags | MACRO_INDEX_CACHED) : (entry.flags & ~MACRO_INDEX_CACHED);
+    ok = index.seek(sizeof(MacroIndexHeader) + pos * sizeof(MacroIndexEntry)) &&
+         index.write((const uint8_t*)&entry, sizeof(entry)) == sizeof(entry);
+  }
+  index.close();
+  return ok;
+}
+
+bool macroIndexBegin(fs::FS& fs, MacroIndexCursor& cur, uint32_t from, const String& prefix) {
+  cur.prefix = prefix;
+  cur.pos = from;
+  cur.last = from;
+  if (!macroIndexLoad(fs) || !macroIndexOpen(fs, cur.index)) return false;
+  // Non-numeric names are in byte order: skip straight to the prefix
+  if (prefix.length() > 0 && !allDigits(prefix.c_str())) {
+    uint32_t first = macroIndexLowerBound(cur.index, prefix);
+    if (first > cur.pos) cur.pos = first;
+  }
+  return true;
+}
+
+bool macroIndexNext(MacroIndexCursor& cur, MacroIndexEntry& entry) {
+  const char* prefix = cur.prefix.c_str();
+  size_t len = cur.prefix.length();
+  while (cur.pos < indexCount) {
+    if (!macroIndexReadAt(cur.index, cur.pos, entry)) break;
+    cur.last = cur.pos++;
+    if (strncmp(entry.name, prefix, len) == 0) return true;
+    // Past the prefix's range among the byte-ordered names: done
+    if (len > 0 && !allDigits(entry.name) && strcmp(entry.name, prefix) > 0) {
+      cur.pos = indexCount;
+      break;
+    }
+  }
+  return false;
+}
+
+void macroIndexEnd(MacroIndexCursor& cur) {
+  if (cur.index) cur.index.close();
+}
+
+bool macroMakeParentDirs(fs::FS& fs, const String& path) {
+  int slash = path.indexOf('/', 1);
+  while (slash > 0) {
+    String dir = path.substring(0, slash);
+    if (!fs.exists(dir) && !fs.mkdir(dir)) return false;
+    slash = path.indexOf('/', slash + 1);
+  }
+  return true;
+}
+
+// "#!ducky" style header: the named format, or false if absent/unknown
+static bool headerFormat(const char* sample, size_t len, MacroFileFormat& format) {
+  size_t n = macroHeaderLength(sample, len);
+  if (n == 0) return false;
+  const char* name = sample + 2;
+  size_t nameLen = n - 2;
+  while (nameLen > 0 && (name[0] == ' ' || name[0] == '\t')) { name++; nameLen--; }
+  while (nameLen > 0 && (name[nameLen - 1] == '\n' || name[nameLen - 1] == '\r' ||
+                         name[nameLen - 1] == ' ' || name[nameLen - 1] == '\t')) nameLen--;
+  static const struct { const char* name; MacroFileFormat format; } names[] = {
+    {"macro", MACRO_FORMAT_MACRO}, {"ducky", MACRO_FORMAT_DUCKY},
+    {"duckyscript", MACRO_FORMAT_DUCKY}, {"script", MACRO_FORMAT_ADVANCED},
+    {"advanced", MACRO_FORMAT_ADVANCED},
+  };
+  for (const auto& h : names) {
+    if (strlen(h.name) == nameLen && strncasecmp(name, h.name, nameLen) == 0) {
+      format = h.format;
+      return true;
+    }
+  }
+  return false;
+}
+
+MacroFileFormat macroDetectFormat(const char* sample, size_t len) {
+  MacroFileFormat format;
+  if (headerFormat(sample, len, format)) return format;
+  if (isAdvancedScript(sample, len)) return MACRO_FORMAT_ADVANCED;
+  if (isDuckyScriptFile(sample, len)) return MACRO_FORMAT_DUCKY;
+  return MACRO_FORMAT_MACRO;
+}
+
+const char* macroFormatName(uint8_t format) {
+  switch (format) {
+    case MACRO_FORMAT_DUCKY: return "ducky";
+    case MACRO_FORMAT_ADVANCED: return "script";
+    default: return "macro";
+  }
+}
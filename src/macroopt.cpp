@@ -0,0 +1,294 @@
+#include "macroopt.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#ifdef ARDUINO
+#include "macrovm.h"
+#endif
+
+static bool hasPrefix(const char* s, const char* prefix) {
+  return strncmp(s, prefix, strlen(prefix)) == 0;
+}
+
+static long clampLong(long v, long lo, long hi) {
+  return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// Relative move in any accepted spelling: "MOUSE:MOVE_REL:dx,dy",
+// "MOUSE:MOVE dx dy" or the recorder's "MOUSE:dx_dy_MOVE_REL"
+static bool parseRelMove(const char* body, long& dx, long& dy) {
+  if (!hasPrefix(body, "MOUSE:")) return false;
+  const char* cmd = body + 6;
+  while (*cmd == ' ' || *cmd == '\t') cmd++;
+  const char* action = nullptr;
+  if (macroParseRecordedMouse(cmd, dx, dy, action)) return strcasecmp(action, "MOVE_REL") == 0;
+  if (hasPrefix(cmd, "MOVE_REL:")) cmd += 9;
+  else if (hasPrefix(cmd, "MOVE ")) cmd += 5;
+  else return false;
+  const char* sep = strchr(cmd, ',');
+  if (!sep) sep = strchr(cmd, ' ');
+  if (!sep || sep == cmd) return false;
+  dx = atol(cmd);
+  dy = atol(sep + 1);
+  return true;
+}
+
+// `{{KEY:c}}` for a letter or digit types the same character as text
+static bool keyAsChar(const char* body, char& c) {
+  if (!hasPrefix(body, "KEY:")) return false;
+  const char* name = body + 4;
+  while (*name == ' ' || *name == '\t') name++;
+  if (name[0] == '\0' || name[1] != '\0') return false;
+  c = name[0];
+  if (c >= 'A' && c <= 'Z') c = c - 'A' + 'a';  // KEY names are lowercased
+  return (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9');
+}
+
+// ------------------------------------------------------------------
+// Play-time estimate
+// ------------------------------------------------------------------
+
+MacroPlayClock::MacroPlayClock(uint16_t keyHoldMs)
+  : holdMs(keyHoldMs), speedMs(3), turbo(false), now(0), schedule(0) {}
+
+void MacroPlayClock::token(const char* body) {
+  if (hasPrefix(body, "DELAY:")) {
+    schedule += clampLong(atol(body + 6), 0, MACRO_DELAY_MAX_MS);
+    if (now < schedule) now = schedule;
+  } else if (hasPrefix(body, "KEY:")) {
+    now += holdMs;
+    schedule = now;
+  } else if (hasPrefix(body, "SPEED:")) {
+    speedMs = (uint8_t)clampLong(atol(body + 6), 0, 200);
+  } else if (hasPrefix(body, "TURBO:")) {
+    const char* mode = body + 6;
+    while (*mode == ' ') mode++;
+    turbo = strncasecmp(mode, "ON", 2) == 0 || mode[0] == '1';
+  } else if (hasPrefix(body, "MOUSE:SCROLL") || hasPrefix(body, "MOUSE:HSCROLL")) {
+    now += 10;  // settle time after the wheel report
+    schedule = now;
+  }
+}
+
+void MacroPlayClock::text(size_t chars) {
+  if (chars == 0) return;
+  if (!turbo) now += (uint64_t)chars * speedMs;
+  schedule = now;
+}
+
+uint32_t MacroPlayClock::totalMs() const {
+  return now > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (uint32_t)now;
+}
+
+// ------------------------------------------------------------------
+// Optimizer
+// ------------------------------------------------------------------
+
+MacroOptimizer::MacroOptimizer(MacroTextSink& sink, uint16_t slackMs, uint16_t keyHoldMs)
+  : out(sink), slack(slackMs), clockIn(keyHoldMs), clockOut(keyHoldMs),
+    group(GROUP_NONE), delayMs(0), deferredMs(0), relX(0), relY(0), textLen(0) {
+  memset(&st, 0, sizeof(st));
+}
+
+// Continue the open group across a short enough pause, else start a new one
+void MacroOptimizer::join(Group kind) {
+  if (group == kind && delayMs <= slack) {
+    deferredMs += delayMs;
+    delayMs = 0;
+    return;
+  }
+  flush();
+  group = kind;
+}
+
+void MacroOptimizer::onText(const char* s, size_t len) {
+  st.eventsIn++;
+  clockIn.text(len);
+  join(GROUP_TEXT);
+  appendText(s, len);
+}
+
+void MacroOptimizer::onToken(char* body, size_t len) {
+  st.eventsIn++;
+  clockIn.token(body);
+
+  long dx = 0, dy = 0;
+  char c = 0;
+  if (hasPrefix(body, "DELAY:")) {
+    delayMs += clampLong(atol(body + 6), 0, MACRO_DELAY_MAX_MS);
+  } else if (hasPrefix(body, "TEXT:")) {
+    join(GROUP_TEXT);
+    appendText(body + 5, len - 5);
+  } else if (keyAsChar(body, c)) {
+    join(GROUP_TEXT);
+    appendText(&c, 1);
+  } else if (parseRelMove(body, dx, dy)) {
+    // Keep the folded move within the i16 range of MOUSE_REL
+    if (group == GROUP_REL && (labs(relX + dx) > 32767 || labs(relY + dy) > 32767)) flush();
+    join(GROUP_REL);
+    relX += dx;
+    relY += dy;
+  } else {
+    flush();
+    emitToken(body);
+  }
+}
+
+// A format header stays the first line of the output
+void MacroOptimizer::onHeader(const char* s, size_t len) {
+  put(s, len);
+}
+
+void MacroOptimizer::onFinish() {
+  flush();
+  st.playMsIn = clockIn.totalMs();
+  st.playMsOut = clockOut.totalMs();
+}
+
+void MacroOptimizer::flush() {
+  flushGroup();
+  flushDelay();
+}
+
+void MacroOptimizer::flushGroup() {
+  if (group == GROUP_TEXT && textLen > 0) {
+    emitText(text, textLen);
+  } else if (group == GROUP_REL && (relX != 0 || relY != 0)) {
+    char body[40];
+    snprintf(body, sizeof(body), "MOUSE:MOVE_REL:%ld,%ld", relX, relY);
+    emitToken(body);
+  }
+  group = GROUP_NONE;
+  textLen = 0;
+  relX = 0;
+  relY = 0;
+}
+
+void MacroOptimizer::flushDelay() {
+  uint32_t total = deferredMs + delayMs;
+  deferredMs = 0;
+  delayMs = 0;
+  while (total > 0) {
+    uint32_t chunk = total > MACRO_DELAY_MAX_MS ? MACRO_DELAY_MAX_MS : total;
+    char body[24];
+    snprintf(body, sizeof(body), "DELAY:%lu", (unsigned long)chunk);
+    emitToken(body);
+    total -= chunk;
+  }
+}
+
+void MacroOptimizer::appendText(const char* s, size_t len) {
+  while (len > 0) {
+    if (textLen == sizeof(text)) {
+      emitText(text, textLen);
+      textLen = 0;
+    }
+    size_t n = sizeof(text) - textLen;
+    if (n > len) n = len;
+    memcpy(text + textLen, s, n);
+    textLen += n;
+    s += n;
+    len -= n;
+  }
+}
+
+void MacroOptimizer::emitToken(const char* body) {
+  st.eventsOut++;
+  clockOut.token(body);
+  put("{{", 2);
+  put(body, strlen(body));
+  put("}}\n", 3);
+}
+
+// Plain text compiles to the same TEXT op as `{{TEXT:...}}` and is
+// shorter; only a literal '{' needs the token form
+void MacroOptimizer::emitText(const char* s, size_t len) {
+  st.eventsOut++;
+  clockOut.text(len);
+  size_t start = 0;
+  for (size_t i = 0; i < len; ++i) {
+    if (s[i] != '{') continue;
+    put(s + start, i - start);
+    put("{{TEXT:{}}", 10);
+    start = i + 1;
+  }
+  put(s + start, len - start);
+  put("\n", 1);
+}
+
+void MacroOptimizer::put(const char* s, size_t len) {
+  if (len == 0) return;
+  st.bytesOut += len;
+  out.write(s, len);
+}
+
+// ------------------------------------------------------------------
+// SD files
+// ------------------------------------------------------------------
+
+#ifdef ARDUINO
+// Buffers optimizer output so SD sees sector-sized writes
+class FileTextSink : public MacroTextSink {
+public:
+  explicit FileTextSink(File& file) : f(file), used(0), ok(true) {}
+  void write(const char* s, size_t len) override {
+    while (len > 0) {
+      if (used == sizeof(buf)) flush();
+      size_t n = sizeof(buf) - used;
+      if (n > len) n = len;
+      memcpy(buf + used, s, n);
+      used += n;
+      s += n;
+      len -= n;
+    }
+  }
+  bool flush() {
+    if (used > 0) ok = ok && f.write(buf, used) == used;
+    used = 0;
+    return ok;
+  }
+
+private:
+  File& f;
+  uint8_t buf[512];
+  size_t used;
+  bool ok;
+};
+
+bool macroOptimizeFile(fs::FS& fs, const String& srcPath, uint16_t slackMs,
+                       MacroOptStats& stats, uint32_t& bytesIn) {
+  File src = fs.open(srcPath, FILE_READ);
+  if (!src) return false;
+  bytesIn = (uint32_t)src.size();
+
+  String base = srcPath.endsWith(".txt") ? srcPath.substring(0, srcPath.length() - 4) : srcPath;
+  String tmpPath = base + ".tmp";
+  String bakPath = base + ".bak";
+  File out = fs.open(tmpPath, FILE_WRITE);
+  if (!out) {
+    src.close();
+    return false;
+  }
+
+  FileTextSink sink(out);
+  MacroOptimizer optimizer(sink, slackMs, MACRO_FILE_KEY_HOLD_MS);
+  optimizer.feedFile(src);
+  optimizer.finish();
+  bool ok = sink.flush();
+  src.close();
+  out.close();
+  stats = optimizer.stats();
+
+  // Keep the original as .bak; the .mbc cache is rebuilt on next play
+  if (ok && fs.exists(bakPath)) fs.remove(bakPath);
+  ok = ok && fs.rename(srcPath, bakPath);
+  if (ok && !fs.rename(tmpPath, srcPath)) {
+    fs.rename(bakPath, srcPath);
+    ok = false;
+  }
+  if (!ok) fs.remove(tmpPath);
+  macroInvalidateCache(fs, srcPath);
+  return ok;
+}
+#endif
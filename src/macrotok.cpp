@@ -0,0 +1,117 @@
+#include "macrotok.h"
+#include <stdlib.h>
+#include <string.h>
+
+static bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v';
+}
+
+char* macroTrimSpan(char* s, size_t& len) {
+  while (len > 0 && isSpace(s[0])) { s++; len--; }
+  while (len > 0 && isSpace(s[len - 1])) len--;
+  s[len] = '\0';
+  return s;
+}
+
+size_t macroHeaderLength(const char* data, size_t len) {
+  if (len < 2 || data[0] != '#' || data[1] != '!') return 0;
+  const char* nl = (const char*)memchr(data, '\n', len);
+  return nl ? (size_t)(nl - data) + 1 : len;
+}
+
+bool macroParseRecordedMouse(const char* cmd, long& dx, long& dy, const char*& action) {
+  char* end;
+  dx = strtol(cmd, &end, 10);
+  if (end == cmd || *end != '_') return false;
+  const char* second = end + 1;
+  dy = strtol(second, &end, 10);
+  if (end == second || *end != '_') return false;
+  action = end + 1;
+  return *action != '\0';
+}
+
+// ------------------------------------------------------------------
+// Tokenizer
+// ------------------------------------------------------------------
+
+MacroTokenizer::MacroTokenizer()
+  : headerPending(false), inToken(false), sawFirstBrace(false), tokenLen(0) {}
+
+void MacroTokenizer::feed(const char* data, size_t len) {
+  if (headerPending && len > 0) {
+    headerPending = false;
+    size_t skip = macroHeaderLength(data, len);
+    if (skip > 0) onHeader(data, skip);
+    data += skip;
+    len -= skip;
+  }
+  size_t runStart = 0;  // start of the pending plain-text run in `data`
+
+  for (size_t i = 0; i < len; ++i) {
+    char c = data[i];
+
+    if (inToken) {
+      token[tokenLen++] = c;
+      runStart = i + 1;
+      if (tokenLen >= 2 && token[tokenLen - 2] == '}' && token[tokenLen - 1] == '}') {
+        inToken = false;
+        size_t bodyLen = tokenLen - 2;
+        char* body = macroTrimSpan(token, bodyLen);
+        onToken(body, bodyLen);
+        tokenLen = 0;
+      } else if (tokenLen >= MACRO_TOKEN_MAX) {
+        // Runaway token (missing "}}"): type what we have as plain text
+        inToken = false;
+        onText("{{", 2);
+        onText(token, tokenLen);
+        tokenLen = 0;
+      }
+      continue;
+    }
+
+    if (!sawFirstBrace) {
+      // Plain text is handed over in runs rather than per character
+      if (c != '{' && c != '\n' && c != '\r') continue;
+      if (i > runStart) onText(data + runStart, i - runStart);
+      runStart = i + 1;
+      // Newlines are skipped to avoid typing Enter between tokens
+      if (c == '{') sawFirstBrace = true;
+    } else {
+      sawFirstBrace = false;
+      runStart = i + 1;
+      if (c == '{') {
+        inToken = true;
+        tokenLen = 0;
+      } else {
+        onText("{", 1);
+        onText(data + i, 1);
+      }
+    }
+  }
+
+  if (!inToken && !sawFirstBrace && len > runStart) {
+    onText(data + runStart, len - runStart);
+  }
+}
+
+#ifdef ARDUINO
+void MacroTokenizer::feedFile(File& f) {
+  char buf[MACRO_FEED_CHUNK];
+  acceptHeader();
+  while (true) {
+    int n = f.read((uint8_t*)buf, sizeof(buf));
+    if (n <= 0) break;
+    feed(buf, n);
+  }
+}
+#endif
+
+void MacroTokenizer::finish() {
+  // Unterminated token or lone brace at EOF is typed literally
+  if (sawFirstBrace) onText("{", 1);
+  if (inToken) onText(token, tokenLen);
+  inToken = false;
+  sawFirstBrace = false;
+  tokenLen = 0;
+  onFinish();
+}
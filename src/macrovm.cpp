@@ -0,0 +1,989 @@
+#include "macrovm.h"
+#include "keytable.h"
+#include "hidtyper.h"
+#include "mouseacc.h"
+#include "absmouse.h"
+#include "hidlock.h"
+#include <Arduino.h>
+#include <USBHIDKeyboard.h>
+#include <USBHIDMouse.h>
+#include <USBHIDGamepad.h>
+
+// External references (defined in main.cpp)
+extern USBHIDKeyboard Keyboard;
+extern USBHIDMouse Mouse;
+extern USBHIDGamepad Gamepad;
+
+// Mouse position tracking for emulated absolute positioning
+static int mouseX = 0;
+static int mouseY = 0;
+
+// ------------------------------------------------------------------
+// Text helpers
+// ------------------------------------------------------------------
+
+static void lowerInPlace(char* s) {
+  for (; *s; ++s) {
+    if (*s >= 'A' && *s <= 'Z') *s = *s - 'A' + 'a';
+  }
+}
+
+static bool hasPrefix(const char* s, const char* prefix) {
+  return strncmp(s, prefix, strlen(prefix)) == 0;
+}
+
+static long clampLong(long v, long lo, long hi) {
+  return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static void putI16(uint8_t* p, long v) {
+  int16_t x = (int16_t)clampLong(v, -32768, 32767);
+  p[0] = (uint8_t)(x & 0xFF);
+  p[1] = (uint8_t)((x >> 8) & 0xFF);
+}
+
+static int16_t getI16(const uint8_t* p) {
+  return (int16_t)(p[0] | (p[1] << 8));
+}
+
+// Split "a<sep>b" on the first separator from `seps` present in `s`
+static bool parsePair(const char* s, const char* seps, long& a, long& b) {
+  const char* sep = nullptr;
+  for (; *seps && !sep; ++seps) sep = strchr(s, *seps);
+  if (!sep || sep == s) return false;
+  a = atol(s);
+  b = atol(sep + 1);
+  return true;
+}
+
+static uint8_t mouseButtonCode(char* name) {
+  size_t len = strlen(name);
+  name = macroTrimSpan(name, len);
+  lowerInPlace(name);
+  if (strcmp(name, "left") == 0) return MOUSE_LEFT;
+  if (strcmp(name, "right") == 0) return MOUSE_RIGHT;
+  if (strcmp(name, "middle") == 0) return MOUSE_MIDDLE;
+  return 0;
+}
+
+static int gamepadButtonCode(char* name) {
+  size_t len = strlen(name);
+  name = macroTrimSpan(name, len);
+  lowerInPlace(name);
+  static const struct { const char* a; const char* b; int button; } buttons[] = {
+    {"a", "south", BUTTON_A}, {"b", "east", BUTTON_B},
+    {"x", "north", BUTTON_X}, {"y", "west", BUTTON_Y},
+    {"tl", "lb", BUTTON_TL}, {"tr", "rb", BUTTON_TR},
+    {"tl2", "lt", BUTTON_TL2}, {"tr2", "rt", BUTTON_TR2},
+    {"select", "back", BUTTON_SELECT}, {"start", "start", BUTTON_START},
+    {"mode", "home", BUTTON_MODE},
+    {"thumbl", "ls", BUTTON_THUMBL}, {"thumbr", "rs", BUTTON_THUMBR},
+  };
+  for (const auto& b : buttons) {
+    if (strcmp(name, b.a) == 0 || strcmp(name, b.b) == 0) return b.button;
+  }
+  return -1;
+}
+
+static uint8_t gamepadHatCode(char* name) {
+  size_t len = strlen(name);
+  name = macroTrimSpan(name, len);
+  lowerInPlace(name);
+  static const struct { const char* a; const char* b; uint8_t hat; } hats[] = {
+    {"center", "neutral", HAT_CENTER}, {"up", "up", HAT_UP},
+    {"up_right", "upright", HAT_UP_RIGHT}, {"right", "right", HAT_RIGHT},
+    {"down_right", "downright", HAT_DOWN_RIGHT}, {"down", "down", HAT_DOWN},
+    {"down_left", "downleft", HAT_DOWN_LEFT}, {"left", "left", HAT_LEFT},
+    {"up_left", "upleft", HAT_UP_LEFT},
+  };
+  for (const auto& h : hats) {
+    if (strcmp(name, h.a) == 0 || strcmp(name, h.b) == 0) return h.hat;
+  }
+  return HAT_CENTER;
+}
+
+// ------------------------------------------------------------------
+// Compiler
+// ------------------------------------------------------------------
+
+MacroCompiler::MacroCompiler(MacroSink& sink) : out(sink) {
+  text[0] = MOP_TEXT;
+  text[1] = 0;
+}
+
+void MacroCompiler::flushText() {
+  if (text[1] == 0) return;
+  emit(text, 2 + text[1]);
+  text[1] = 0;
+}
+
+void MacroCompiler::onText(const char* s, size_t len) {
+  while (len > 0) {
+    size_t n = 255 - text[1];
+    if (n > len) n = len;
+    memcpy(text + 2 + text[1], s, n);
+    text[1] += n;
+    s += n;
+    len -= n;
+    if (text[1] == 255) flushText();
+  }
+}
+
+void MacroCompiler::emitKey(char* name) {
+  lowerInPlace(name);  // single characters are typed lowercase
+
+  uint8_t op[2 + MACRO_MAX_KEYS];
+  op[0] = MOP_KEY;
+  op[1] = keyParseCombo(name, strlen(name), "+", op + 2, MACRO_MAX_KEYS);
+  if (op[1] == 0) return;
+  emit(op, 2 + op[1]);
+}
+
+void MacroCompiler::onToken(char* body, size_t len) {
+  uint8_t op[8];
+
+  if (hasPrefix(body, "DELAY:")) {
+    flushText();
+    long ms = clampLong(atol(body + 6), 0, MACRO_DELAY_MAX_MS);
+    op[0] = MOP_DELAY;
+    op[1] = (uint8_t)(ms & 0xFF);
+    op[2] = (uint8_t)(ms >> 8);
+    emit(op, 3);
+  } else if (hasPrefix(body, "SPEED:")) {
+    flushText();
+    op[0] = MOP_SPEED;
+    op[1] = (uint8_t)clampLong(atol(body + 6), 0, 200);
+    emit(op, 2);
+  } else if (hasPrefix(body, "TURBO:")) {
+    flushText();
+    size_t modeLen = len - 6;
+    char* mode = macroTrimSpan(body + 6, modeLen);
+    op[0] = MOP_TURBO;
+    op[1] = (strcasecmp(mode, "ON") == 0 || strcmp(mode, "1") == 0) ? 1 : 0;
+    emit(op, 2);
+  } else if (hasPrefix(body, "KEY:")) {
+    flushText();
+    size_t keyLen = len - 4;
+    emitKey(macroTrimSpan(body + 4, keyLen));
+  } else if (hasPrefix(body, "TEXT:")) {
+    onText(body + 5, len - 5);
+  } else if (hasPrefix(body, "MOUSE:")) {
+    flushText();
+    size_t cmdLen = len - 6;
+    char* cmd = macroTrimSpan(body + 6, cmdLen);
+    long a = 0, b = 0;
+    const char* action = nullptr;
+    if (strcasecmp(cmd, "RESET") == 0) {
+      op[0] = MOP_MOUSE_RESET;
+      emit(op, 1);
+    } else if (macroParseRecordedMouse(cmd, a, b, action)) {
+      // Recorder form: "dx_dy_MOVE_REL", "0_0_LCLICK", "0_0_RCLICK"
+      if (strcasecmp(action, "MOVE_REL") == 0) {
+        op[0] = MOP_MOUSE_REL;
+        putI16(op + 1, a);
+        putI16(op + 3, b);
+        emit(op, 5);
+      } else if (strcasecmp(action, "LCLICK") == 0 || strcasecmp(action, "RCLICK") == 0) {
+        op[0] = MOP_MOUSE_CLICK;
+        op[1] = (action[0] == 'R' || action[0] == 'r') ? MOUSE_RIGHT : MOUSE_LEFT;
+        emit(op, 2);
+      }
+    } else if (hasPrefix(cmd, "MOVE:")) {
+      if (parsePair(cmd + 5, ",", a, b)) {
+        op[0] = MOP_MOUSE_MOVE;
+        putI16(op + 1, a);
+        putI16(op + 3, b);
+        emit(op, 5);
+      }
+    } else if (hasPrefix(cmd, "MOVE_REL:") || hasPrefix(cmd, "MOVE ")) {
+      if (parsePair(cmd + (cmd[4] == '_' ? 9 : 5), ", ", a, b)) {
+        op[0] = MOP_MOUSE_REL;
+        putI16(op + 1, a);
+        putI16(op + 3, b);
+        emit(op, 5);
+      }
+    } else if (hasPrefix(cmd, "DOWN:") || hasPrefix(cmd, "UP:") ||
+               hasPrefix(cmd, "CLICK:") || hasPrefix(cmd, "CLICK ")) {
+      uint8_t opcode = cmd[0] == 'D' ? MOP_MOUSE_DOWN : (cmd[0] == 'U' ? MOP_MOUSE_UP : MOP_MOUSE_CLICK);
+      uint8_t btn = mouseButtonCode(cmd + (cmd[0] == 'D' ? 5 : (cmd[0] == 'U' ? 3 : 6)));
+      if (btn != 0) {
+        op[0] = opcode;
+        op[1] = btn;
+        emit(op, 2);
+      }
+    } else if (hasPrefix(cmd, "SCROLL:") || hasPrefix(cmd, "SCROLL ")) {
+      long n = atol(cmd + 7);
+      if (n != 0) {
+        op[0] = MOP_MOUSE_SCROLL;
+        putI16(op + 1, n);
+        emit(op, 3);
+      }
+    } else if (hasPrefix(cmd, "HSCROLL:") || hasPrefix(cmd, "HSCROLL ")) {
+      long n = atol(cmd + 8);
+      if (n != 0) {
+        op[0] = MOP_MOUSE_HSCROLL;
+        putI16(op + 1, n);
+        emit(op, 3);
+      }
+    }
+  } else if (hasPrefix(body, "GAMEPAD:")) {
+    flushText();
+    size_t cmdLen = len - 8;
+    char* cmd = macroTrimSpan(body + 8, cmdLen);
+    long a = 0, b = 0;
+    if (hasPrefix(cmd, "PRESS ") || hasPrefix(cmd, "RELEASE ")) {
+      bool press = cmd[0] == 'P';
+      int btn = gamepadButtonCode(cmd + (press ? 6 : 8));
+      if (btn >= 0) {
+        op[0] = press ? MOP_PAD_PRESS : MOP_PAD_RELEASE;
+        op[1] = (uint8_t)btn;
+        emit(op, 2);
+      }
+    } else if (hasPrefix(cmd, "DPAD ")) {
+      op[0] = MOP_PAD_HAT;
+      op[1] = gamepadHatCode(cmd + 5);
+      emit(op, 2);
+    } else if (hasPrefix(cmd, "LS ") || hasPrefix(cmd, "RS ")) {
+      if (parsePair(cmd + 3, " ", a, b)) {
+        op[0] = cmd[0] == 'L' ? MOP_PAD_LS : MOP_PAD_RS;
+        op[1] = (uint8_t)(int8_t)clampLong(a, -127, 127);
+        op[2] = (uint8_t)(int8_t)clampLong(b, -127, 127);
+        emit(op, 3);
+      }
+    } else if (hasPrefix(cmd, "LT ") || hasPrefix(cmd, "RT ")) {
+      op[0] = cmd[0] == 'L' ? MOP_PAD_LT : MOP_PAD_RT;
+      op[1] = (uint8_t)(int8_t)clampLong(atol(cmd + 3), -127, 127);
+      emit(op, 2);
+    }
+  } else if (hasPrefix(body, "AUDIO:")) {
+    flushText();
+    size_t cmdLen = len - 6;
+    char* cmd = macroTrimSpan(body + 6, cmdLen);
+    lowerInPlace(cmd);
+    uint8_t code = 0;
+    long repeat = 1;
+    if (hasPrefix(cmd, "volup") || hasPrefix(cmd, "voldown")) {
+      const char* colon = strchr(cmd, ':');
+      if (colon) repeat = clampLong(atol(colon + 1), 1, 10);
+#if defined(KEY_MEDIA_VOLUME_UP) && defined(KEY_MEDIA_VOLUME_DOWN)
+      code = cmd[3] == 'u' ? KEY_MEDIA_VOLUME_UP : KEY_MEDIA_VOLUME_DOWN;
+#endif
+    }
+#ifdef KEY_MEDIA_VOLUME_MUTE
+    else if (strcmp(cmd, "mute") == 0) code = KEY_MEDIA_VOLUME_MUTE;
+#endif
+#ifdef KEY_MEDIA_PLAY_PAUSE
+    else if (strcmp(cmd, "play") == 0 || strcmp(cmd, "playpause") == 0) code = KEY_MEDIA_PLAY_PAUSE;
+#endif
+#ifdef KEY_MEDIA_STOP
+    else if (strcmp(cmd, "stop") == 0) code = KEY_MEDIA_STOP;
+#endif
+#ifdef KEY_MEDIA_NEXT_TRACK
+    else if (strcmp(cmd, "next") == 0 || strcmp(cmd, "nexttrack") == 0) code = KEY_MEDIA_NEXT_TRACK;
+#endif
+#ifdef KEY_MEDIA_PREV_TRACK
+    else if (strcmp(cmd, "prev") == 0 || strcmp(cmd, "prevtrack") == 0) code = KEY_MEDIA_PREV_TRACK;
+#endif
+    if (code != 0) {
+      op[0] = MOP_KEY;
+      op[1] = 1;
+      op[2] = code;
+      for (long i = 0; i < repeat; ++i) emit(op, 3);
+    }
+  } else {
+    // Unknown token: type it back verbatim
+    onText("{{", 2);
+    onText(body, len);
+    onText("}}", 2);
+  }
+}
+
+// ------------------------------------------------------------------
+// VM
+// ------------------------------------------------------------------
+
+// Encoded size of each fixed-length op (0 = variable: u8 count follows)
+static const uint8_t macroOpSize[MOP_COUNT] = {
+  1,  // END
+  3,  // DELAY
+  2,  // SPEED
+  0,  // KEY
+  0,  // TEXT
+  1,  // MOUSE_RESET
+  5,  // MOUSE_MOVE
+  5,  // MOUSE_REL
+  2,  // MOUSE_DOWN
+  2,  // MOUSE_UP
+  2,  // MOUSE_CLICK
+  3,  // MOUSE_SCROLL
+  3,  // MOUSE_HSCROLL
+  2,  // PAD_PRESS
+  2,  // PAD_RELEASE
+  2,  // PAD_HAT
+  3,  // PAD_LS
+  3,  // PAD_RS
+  2,  // PAD_LT
+  2,  // PAD_RT
+  2,  // TURBO
+  2,  // KEY_DOWN
+  2,  // KEY_UP
+};
+
+// Step the relative mouse by (dx, dy) in HID-sized chunks
+static void mouseMoveBy(int dx, int dy) {
+  while (dx != 0 || dy != 0) {
+    int stepX = (dx > 127) ? 127 : ((dx < -127) ? -127 : dx);
+    int stepY = (dy > 127) ? 127 : ((dy < -127) ? -127 : dy);
+    Mouse.move(stepX, stepY);
+    dx -= stepX;
+    dy -= stepY;
+    mouseX += stepX;
+    mouseY += stepY;
+  }
+}
+
+// ------------------------------------------------------------------
+// Timing statistics
+// ------------------------------------------------------------------
+
+// Values below 4 get their own bucket; above that each power of two is
+// split into 4 equal sub-buckets
+static uint8_t timingBucket(uint32_t us) {
+  if (us < 4) return us;
+  uint8_t msb = 31 - __builtin_clz(us);
+  return (msb - 1) * 4 + ((us >> (msb - 2)) & 3);
+}
+
+static uint32_t timingBucketTop(uint8_t b) {
+  if (b < 4) return b;
+  uint8_t shift = b / 4 - 1;
+  uint32_t low = (uint32_t)(4 + b % 4) << shift;
+  return low + ((1UL << shift) - 1);
+}
+
+void MacroTiming::reset() {
+  samples = 0;
+  sumUs = 0;
+  maxLateUs = 0;
+  memset(hist, 0, sizeof(hist));
+}
+
+void MacroTiming::add(uint32_t lateUs) {
+  samples++;
+  sumUs += lateUs;
+  if (lateUs > maxLateUs) maxLateUs = lateUs;
+  hist[timingBucket(lateUs)]++;
+}
+
+uint32_t MacroTiming::percentileUs(uint8_t pct) const {
+  if (samples == 0) return 0;
+  uint32_t rank = (uint32_t)(((uint64_t)samples * pct + 99) / 100);
+  uint32_t seen = 0;
+  for (uint8_t b = 0; b < MACRO_TIMING_BUCKETS; ++b) {
+    seen += hist[b];
+    if (seen >= rank) {
+      uint32_t top = timingBucketTop(b);
+      return top < maxLateUs ? top : maxLateUs;
+    }
+  }
+  return maxLateUs;
+}
+
+// ------------------------------------------------------------------
+// VM
+// ------------------------------------------------------------------
+
+MacroVM::MacroVM(uint16_t keyHoldMs)
+  : holdMs(keyHoldMs), speedMs(3), turbo(false), coalesceMouse(false),
+    pending(PENDING_NONE), wakeAt(0), schedule(esp_timer_get_time()), timing(nullptr),
+    tempoPct(100), minGapMs(0), gapMs(0), delayTotalMs(0),
+    opCount(0), heldCount(0), keysDownCount(0), buttonsDown(0), padUsed(false),
+    textLen(0), textPos(0), scrollLeft(0),
+    scrollHorizontal(false), codeEof(true), winLen(0), winPos(0) {}
+
+void MacroVM::reset() {
+  speedMs = 3;
+  turbo = false;
+  schedule = esp_timer_get_time();
+}
+
+void MacroVM::setTempo(uint16_t pct, uint16_t minGap) {
+  if (pct < MACRO_TEMPO_MIN) pct = MACRO_TEMPO_MIN;
+  if (pct > MACRO_TEMPO_MAX) pct = MACRO_TEMPO_MAX;
+  tempoPct = pct;
+  minGapMs = minGap;
+}
+
+// Advance the schedule by one (possibly merged) delay
+void MacroVM::scheduleGap(uint32_t ms) {
+  delayTotalMs += ms;
+  schedule += (int64_t)ms * 1000 * 100 / tempoPct;
+  // The floor is against real time: an overdue schedule would otherwise
+  // fire the next event right after the last one. Only scaled playback
+  // gets it; at 1x the recorded gaps stand as they are.
+  if (tempoPct != 100 && minGapMs > 0) {
+    int64_t earliest = esp_timer_get_time() + (int64_t)minGapMs * 1000;
+    if (schedule < earliest) schedule = earliest;
+  }
+  pending = PENDING_DELAY;
+  wakeAt = schedule;
+}
+
+void MacroVM::waitFor(uint32_t ms) {
+  pending = PENDING_WAIT;
+  wakeAt = esp_timer_get_time() + (int64_t)ms * 1000;
+}
+
+void MacroVM::waitDue() {
+  int64_t us = wakeAt - esp_timer_get_time();
+  if (us >= 1000) delay(us / 1000);
+  else if (us > 0) delayMicroseconds(us);
+}
+
+// Continue the pending timed op once its deadline has passed
+void MacroVM::resume() {
+  HidLockGuard lock;
+  Pending was = pending;
+  switch (pending) {
+    case PENDING_KEYS:
+      for (uint8_t i = heldCount; i-- > 0; ) hidKeyRelease(held[i]);
+      heldCount = 0;
+      pending = PENDING_NONE;
+      break;
+    case PENDING_TEXT: {
+      textPos += hidTypeStep(text + textPos, textLen - textPos, turbo);
+      uint8_t gap = turbo ? 0 : speedMs;
+      if (textPos < textLen) wakeAt = esp_timer_get_time() + gap * 1000;
+      else if (gap > 0) waitFor(gap);
+      else pending = PENDING_NONE;
+      break;
+    }
+    case PENDING_SCROLL: {
+      // One report carries up to 127 ticks; the host paces back-to-back reports
+      int step = scrollLeft > 127 ? 127 : (scrollLeft < -127 ? -127 : scrollLeft);
+      if (scrollHorizontal) Mouse.move(0, 0, 0, step);
+      else Mouse.move(0, 0, step);
+      scrollLeft -= step;
+      if (scrollLeft == 0) waitFor(10);
+      else wakeAt = esp_timer_get_time();
+      break;
+    }
+    case PENDING_DELAY: {
+      int64_t late = esp_timer_get_time() - wakeAt;
+      if (timing) timing->add(late > (int64_t)UINT32_MAX ? UINT32_MAX : (uint32_t)late);
+      pending = PENDING_NONE;
+      break;
+    }
+    default:
+      pending = PENDING_NONE;
+      break;
+  }
+  // Typing, key holds and scrolls last as long as the host takes to poll
+  // them, so the next DELAY counts from when they finished
+  if (pending == PENDING_NONE && was != PENDING_DELAY) schedule = esp_timer_get_time();
+}
+
+// Execute one op; returns its encoded size, or 0 if `avail` is too short.
+// Timed ops only start here and leave the rest to resume().
+size_t MacroVM::exec(const uint8_t* op, size_t avail) {
+  HidLockGuard lock;
+  uint8_t code = op[0];
+  if (code >= MOP_COUNT) return avail;  // corrupt: skip the rest of the window
+  size_t size = macroOpSize[code];
+  if (size == 0) {
+    if (avail < 2) return 0;
+    size = 2 + op[1];
+  }
+  if (avail < size) return 0;
+  opCount++;
+
+  if (coalesceMouse) {
+    if (code == MOP_MOUSE_REL) {
+      int dx = getI16(op + 1);
+      int dy = getI16(op + 3);
+      mouseAccAdd(dx, dy, 0);
+      mouseX += dx;
+      mouseY += dy;
+      return size;
+    }
+    if (code == MOP_MOUSE_SCROLL) {
+      mouseAccAdd(0, 0, getI16(op + 1));
+      return size;
+    }
+    if (code == MOP_MOUSE_HSCROLL) {
+      mouseAccAdd(0, 0, 0, getI16(op + 1));
+      return size;
+    }
+    // Anything else must see the motion queued before it
+    mouseAccFlushAll();
+  }
+
+  switch (code) {
+    case MOP_DELAY:
+      // Due at the cumulative offset, not `now + n`: time spent on earlier
+      // ops is absorbed here instead of accumulating as drift
+      scheduleGap(op[1] | (op[2] << 8));
+      break;
+    case MOP_SPEED: speedMs = op[1]; break;
+    case MOP_KEY:
+      heldCount = op[1] < MACRO_MAX_KEYS ? op[1] : MACRO_MAX_KEYS;
+      for (uint8_t i = 0; i < heldCount; ++i) {
+        held[i] = op[2 + i];
+        hidKeyPress(held[i]);
+      }
+      pending = PENDING_KEYS;
+      wakeAt = esp_timer_get_time() + (int64_t)holdMs * 1000;
+      break;
+    case MOP_TEXT:
+      memcpy(text, op + 2, op[1]);
+      textLen = op[1];
+      textPos = 0;
+      pending = PENDING_TEXT;
+      wakeAt = esp_timer_get_time();
+      break;
+    case MOP_MOUSE_RESET:
+      // One absolute report when enabled, else step back from the tracked position
+      if (!absMouseMoveTo(0, 0)) mouseMoveBy(-mouseX, -mouseY);
+      mouseX = 0;
+      mouseY = 0;
+      break;
+    case MOP_MOUSE_MOVE: {
+      int targetX = getI16(op + 1);
+      int targetY = getI16(op + 3);
+      if (!absMouseMoveTo(targetX, targetY)) mouseMoveBy(targetX - mouseX, targetY - mouseY);
+      mouseX = targetX;
+      mouseY = targetY;
+      break;
+    }
+    case MOP_MOUSE_REL: mouseMoveBy(getI16(op + 1), getI16(op + 3)); break;
+    case MOP_MOUSE_DOWN:
+      Mouse.press(op[1]);
+      buttonsDown |= op[1];
+      break;
+    case MOP_MOUSE_UP:
+      Mouse.release(op[1]);
+      buttonsDown &= ~op[1];
+      break;
+    case MOP_MOUSE_CLICK: Mouse.click(op[1]); break;
+    case MOP_MOUSE_SCROLL:
+    case MOP_MOUSE_HSCROLL:
+      scrollLeft = getI16(op + 1);
+      scrollHorizontal = code == MOP_MOUSE_HSCROLL;
+      if (scrollLeft != 0) {
+        pending = PENDING_SCROLL;
+        wakeAt = esp_timer_get_time();
+      }
+      break;
+    case MOP_PAD_PRESS: Gamepad.pressButton(op[1]); padUsed = true; break;
+    case MOP_PAD_RELEASE: Gamepad.releaseButton(op[1]); padUsed = true; break;
+    case MOP_PAD_HAT: Gamepad.hat(op[1]); padUsed = true; break;
+    case MOP_PAD_LS: Gamepad.leftStick((int8_t)op[1], (int8_t)op[2]); padUsed = true; break;
+    case MOP_PAD_RS: Gamepad.rightStick((int8_t)op[1], (int8_t)op[2]); padUsed = true; break;
+    case MOP_PAD_LT: Gamepad.leftTrigger((int8_t)op[1]); padUsed = true; break;
+    case MOP_PAD_RT: Gamepad.rightTrigger((int8_t)op[1]); padUsed = true; break;
+    case MOP_TURBO: turbo = op[1] != 0; break;
+    case MOP_KEY_DOWN:
+      hidKeyPress(op[1]);
+      keyDown(op[1]);
+      break;
+    case MOP_KEY_UP:
+      hidKeyRelease(op[1]);
+      keyUp(op[1]);
+      break;
+    default: break;
+  }
+  return size;
+}
+
+void MacroVM::write(const uint8_t* data, size_t len) {
+  size_t pos = 0;
+  while (pos < len) {
+    size_t n = exec(data + pos, len - pos);
+    if (n == 0) break;
+    pos += n;
+    while (pending != PENDING_NONE) {
+      waitDue();
+      resume();
+    }
+  }
+}
+
+void MacroVM::begin(File& f) {
+  closeCode();
+  code = f;
+  codeEof = false;
+  winLen = 0;
+  winPos = 0;
+  opCount = 0;
+  gapMs = 0;
+  delayTotalMs = 0;
+  schedule = esp_timer_get_time();
+  if (timing) timing->reset();
+}
+
+void MacroVM::closeCode() {
+  if (code) code.close();
+  code = File();
+  codeEof = true;
+}
+
+bool MacroVM::step() {
+  uint32_t start = millis();
+  while (true) {
+    if (pending != PENDING_NONE) {
+      if (!due()) return true;
+      resume();
+      continue;
+    }
+    if (!code) return false;
+    // Yield between ops so one call never holds loop() for long
+    if (millis() - start >= MACRO_STEP_BUDGET_MS) return true;
+
+    // Keep at least one whole op in the window
+    if (!codeEof && winLen - winPos < MACRO_OP_MAX) {
+      winLen -= winPos;
+      memmove(window, window + winPos, winLen);
+      winPos = 0;
+      size_t want = sizeof(window) - winLen;
+      int n = code.read(window + winLen, want);
+      if (n > 0) winLen += n;
+      if (n < (int)want) codeEof = true;
+    }
+
+    bool more = winPos < winLen && window[winPos] != MOP_END;
+    // Merge a run of DELAYs so the tempo and minimum gap apply to the
+    // whole pause between two events
+    if (more && window[winPos] == MOP_DELAY && winLen - winPos >= 3) {
+      gapMs += window[winPos + 1] | (window[winPos + 2] << 8);
+      winPos += 3;
+      opCount++;
+      continue;
+    }
+    if (gapMs > 0) {
+      scheduleGap(gapMs);
+      gapMs = 0;
+      continue;
+    }
+
+    size_t used = more ? exec(window + winPos, winLen - winPos) : 0;
+    if (used == 0) {  // MOP_END, EOF or truncated op
+      closeCode();
+      return pending != PENDING_NONE;
+    }
+    winPos += used;
+  }
+}
+
+// Remember a MOP_KEY_DOWN so stop() can release it
+void MacroVM::keyDown(uint8_t k) {
+  for (uint8_t i = 0; i < keysDownCount; ++i) {
+    if (keysDown[i] == k) return;
+  }
+  if (keysDownCount < MACRO_MAX_KEYS) keysDown[keysDownCount++] = k;
+}
+
+void MacroVM::keyUp(uint8_t k) {
+  for (uint8_t i = 0; i < keysDownCount; ++i) {
+    if (keysDown[i] == k) {
+      keysDown[i] = keysDown[--keysDownCount];
+      return;
+    }
+  }
+}
+
+// Only what this VM pressed is released: another VM (Live Control in the
+// HID task, or file playback) may be holding keys of its own
+void MacroVM::stop() {
+  HidLockGuard lock;
+  if (pending == PENDING_KEYS) {
+    for (uint8_t i = heldCount; i-- > 0; ) hidKeyRelease(held[i]);
+  }
+  heldCount = 0;
+  for (uint8_t i = keysDownCount; i-- > 0; ) hidKeyRelease(keysDown[i]);
+  keysDownCount = 0;
+  pending = PENDING_NONE;
+  closeCode();
+  if (coalesceMouse) mouseAccFlushAll();
+  if (buttonsDown) Mouse.release(buttonsDown);
+  buttonsDown = 0;
+  if (padUsed) Gamepad.send(0, 0, 0, 0, 0, 0, HAT_CENTER, 0);
+  padUsed = false;
+}
+
+void MacroVM::runFile(File& f) {
+  begin(f);
+  while (step()) waitDue();
+}
+
+// ------------------------------------------------------------------
+// SD cache
+// ------------------------------------------------------------------
+
+// Cache file header; a zero magic marks an interrupted compile
+struct MacroCacheHeader {
+  char magic[4];
+  uint8_t version;
+  uint8_t reserved[3];
+  uint32_t srcSize;
+  uint32_t srcMtime;
+  uint32_t srcHash;
+};
+
+static const char MACRO_CACHE_MAGIC[4] = {'P', 'W', 'M', 'B'};
+static const uint8_t MACRO_CACHE_VERSION = 4;
+
+uint32_t macroHash(uint32_t h, const uint8_t* data, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    h ^= data[i];
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+static uint32_t hashFile(File& f) {
+  uint8_t buf[512];
+  uint32_t h = MACRO_HASH_SEED;
+  f.seek(0);
+  while (true) {
+    int n = f.read(buf, sizeof(buf));
+    if (n <= 0) break;
+    h = macroHash(h, buf, n);
+  }
+  return h;
+}
+
+// Buffers compiler output so SD sees sector-sized writes
+class FileSink : public MacroSink {
+public:
+  explicit FileSink(File& file) : f(file), used(0), ok(true) {}
+  void write(const uint8_t* data, size_t len) override {
+    if (used + len > sizeof(buf)) flush();
+    if (len > sizeof(buf)) {
+      ok = ok && f.write(data, len) == len;
+      return;
+    }
+    memcpy(buf + used, data, len);
+    used += len;
+  }
+  bool flush() {
+    if (used > 0) ok = ok && f.write(buf, used) == used;
+    used = 0;
+    return ok;
+  }
+
+private:
+  File& f;
+  uint8_t buf[512];
+  size_t used;
+  bool ok;
+};
+
+String macroCachePath(const String& srcPath) {
+  if (srcPath.endsWith(".txt")) {
+    return srcPath.substring(0, srcPath.length() - 4) + MACRO_CACHE_EXT;
+  }
+  return srcPath + MACRO_CACHE_EXT;
+}
+
+void macroInvalidateCache(fs::FS& fs, const String& srcPath) {
+  String cachePath = macroCachePath(srcPath);
+  if (fs.exists(cachePath)) fs.remove(cachePath);
+}
+
+static bool readCacheHeader(File& cache, MacroCacheHeader& hdr) {
+  if (cache.read((uint8_t*)&hdr, sizeof(hdr)) != sizeof(hdr)) return false;
+  return memcmp(hdr.magic, MACRO_CACHE_MAGIC, 4) == 0 && hdr.version == MACRO_CACHE_VERSION;
+}
+
+// The content matched under a new mtime: store it, so the next check
+// skips the hash again
+static void updateCacheMtime(fs::FS& fs, const String& cachePath, MacroCacheHeader& hdr, uint32_t mtime) {
+  File out = fs.open(cachePath, "r+");
+  if (out) {
+    hdr.srcMtime = mtime;
+    out.write((const uint8_t*)&hdr, sizeof(hdr));
+    out.close();
+  }
+}
+
+// Same size and mtime: fresh without reading the source (everything that
+// writes macros on the device invalidates the cache, and a PC sets a new
+// mtime). Only a changed mtime at the same size is checked by hashing.
+static bool cacheMatches(fs::FS& fs, const String& cachePath, File& cache, File& src) {
+  MacroCacheHeader hdr;
+  if (!readCacheHeader(cache, hdr)) return false;
+  if (hdr.srcSize != (uint32_t)src.size()) return false;
+  uint32_t mtime = (uint32_t)src.getLastWrite();
+  if (hdr.srcMtime == mtime) return true;
+  if (hdr.srcHash != hashFile(src)) return false;
+  updateCacheMtime(fs, cachePath, hdr, mtime);
+  return true;
+}
+
+// Compile `src` into `cachePath`; header is written last so a partial
+// file never validates
+static bool compileToCache(fs::FS& fs, File& src, const String& cachePath) {
+  File out = fs.open(cachePath, FILE_WRITE);
+  if (!out) return false;
+
+  MacroCacheHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  out.write((const uint8_t*)&hdr, sizeof(hdr));
+
+  FileSink sink(out);
+  MacroCompiler compiler(sink);
+  uint8_t buf[MACRO_FEED_CHUNK];
+  uint32_t h = MACRO_HASH_SEED;
+  src.seek(0);
+  compiler.acceptHeader();
+  while (true) {
+    int n = src.read(buf, sizeof(buf));
+    if (n <= 0) break;
+    h = macroHash(h, buf, n);
+    compiler.feed((const char*)buf, n);
+  }
+  compiler.finish();
+  uint8_t end = MOP_END;
+  sink.write(&end, 1);
+  bool ok = sink.flush();
+
+  memcpy(hdr.magic, MACRO_CACHE_MAGIC, 4);
+  hdr.version = MACRO_CACHE_VERSION;
+  hdr.srcSize = (uint32_t)src.size();
+  hdr.srcMtime = (uint32_t)src.getLastWrite();
+  hdr.srcHash = h;
+  ok = ok && out.seek(0) && out.write((const uint8_t*)&hdr, sizeof(hdr)) == sizeof(hdr);
+  out.close();
+
+  if (!ok) fs.remove(cachePath);
+  return ok;
+}
+
+bool macroCacheFresh(fs::FS& fs, const String& srcPath) {
+  File cache = fs.open(macroCachePath(srcPath), FILE_READ);
+  if (!cache) return false;
+  File src = fs.open(srcPath, FILE_READ);
+  bool fresh = src && cacheMatches(fs, macroCachePath(srcPath), cache, src);
+  cache.close();
+  if (src) src.close();
+  return fresh;
+}
+
+bool macroCacheFresh(fs::FS& fs, const String& srcPath, uint32_t srcSize, uint32_t srcMtime,
+                     uint32_t srcHash) {
+  String cachePath = macroCachePath(srcPath);
+  File cache = fs.open(cachePath, FILE_READ);
+  if (!cache) return false;
+  MacroCacheHeader hdr;
+  bool fresh = readCacheHeader(cache, hdr) && hdr.srcSize == srcSize && hdr.srcHash == srcHash;
+  cache.close();
+  if (fresh && hdr.srcMtime != srcMtime) updateCacheMtime(fs, cachePath, hdr, srcMtime);
+  return fresh;
+}
+
+bool macroOpenCompiled(fs::FS& fs, const String& srcPath, File& code) {
+  File src = fs.open(srcPath, FILE_READ);
+  if (!src) return false;
+  bool ok = macroOpenCompiled(fs, src, srcPath, code);
+  src.close();
+  return ok;
+}
+
+bool macroOpenCompiled(fs::FS& fs, File& src, const String& srcPath, File& code) {
+  String cachePath = macroCachePath(srcPath);
+  File cache = fs.open(cachePath, FILE_READ);
+  if (cache) {
+    if (cacheMatches(fs, cachePath, cache, src)) {
+      code = cache;
+      return true;
+    }
+    cache.close();
+  }
+
+  if (!compileToCache(fs, src, cachePath)) return false;
+
+  code = fs.open(cachePath, FILE_READ);
+  if (!code) return false;
+  code.seek(sizeof(MacroCacheHeader));
+  return true;
+}
+
+bool macroPlayFile(fs::FS& fs, const String& srcPath, uint16_t keyHoldMs) {
+  File src = fs.open(srcPath, FILE_READ);
+  if (!src) return false;
+  macroPlayFile(fs, src, srcPath, keyHoldMs);
+  src.close();
+  return true;
+}
+
+void macroPlayFile(fs::FS& fs, File& src, const String& srcPath, uint16_t keyHoldMs) {
+  MacroVM vm(keyHoldMs);
+  File code;
+  if (macroOpenCompiled(fs, src, srcPath, code)) {
+    vm.runFile(code);
+    code.close();
+    return;
+  }
+
+  // No usable cache (e.g. card full): compile straight into the VM
+  MacroCompiler compiler(vm);
+  src.seek(0);
+  compiler.feedFile(src);
+  compiler.finish();
+}
+
+// ------------------------------------------------------------------
+// Background playback
+// ------------------------------------------------------------------
+
+static MacroVM macroPlayer(MACRO_FILE_KEY_HOLD_MS);
+static MacroTiming macroPlayerTiming;
+static bool macroPlayerActive = false;
+static uint32_t macroPlayerStart = 0;
+static uint32_t macroPlayerElapsed = 0;  // duration of the last finished run
+
+bool macroPlaybackStart(fs::FS& fs, const String& srcPath, uint16_t tempoPct, uint16_t minGapMs) {
+  macroPlaybackStop();
+  File code;
+  if (!macroOpenCompiled(fs, srcPath, code)) return false;
+  macroPlayer.setTiming(&macroPlayerTiming);
+  macroPlayer.setTempo(tempoPct, minGapMs);
+  macroPlayer.begin(code);
+  macroPlayerActive = true;
+  macroPlayerStart = millis();
+  return true;
+}
+
+bool macroPlaybackStep() {
+  if (!macroPlayerActive) return false;
+  macroPlayerActive = macroPlayer.step();
+  if (!macroPlayerActive) macroPlayerElapsed = millis() - macroPlayerStart;
+  return macroPlayerActive;
+}
+
+void macroPlaybackStop() {
+  if (!macroPlayerActive) return;
+  macroPlayer.stop();
+  macroPlayerActive = false;
+  macroPlayerElapsed = millis() - macroPlayerStart;
+}
+
+bool macroPlaybackActive() {
+  return macroPlayerActive;
+}
+
+uint32_t macroPlaybackElapsedMs() {
+  return macroPlayerActive ? millis() - macroPlayerStart : macroPlayerElapsed;
+}
+
+uint32_t macroPlaybackOps() {
+  return macroPlayer.opsExecuted();
+}
+
+uint32_t macroPlaybackRecordedMs() {
+  return macroPlayer.recordedDelayMs();
+}
+
+const MacroTiming& macroPlaybackTiming() {
+  return macroPlayerTiming;
+}
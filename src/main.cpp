@@ -13,6 +13,7 @@
 #include "storage.h"
 #include "usb.h"
 #include "bluetooth.h"
+#include "absmouse.h"
 
 // Core shared objects and state (defined here, referenced by modules)
 TFT_eSPI tft = TFT_eSPI();
@@ -20,6 +21,7 @@ Preferences prefs; // NVS storage
 USBHIDKeyboard Keyboard;
 USBHIDMouse Mouse;
 USBHIDGamepad Gamepad;
+USBHIDAbsMouse AbsMouse;  // absolute pointer for MOUSE:MOVE (when enabled)
 
 String PASSWORDS[MAX_DEVICES];
 String menuItems[MAX_DEVICES];
@@ -31,7 +33,6 @@ int bootMenuSelection = 0;
 
 // File menu state
 bool inFileMenu = false;
-String fileList[15];
 int fileCount = 0;
 int fileMenuSelection = 0;
 
@@ -206,9 +207,9 @@ void setup() {
     } else if (bootMenuSelection == 4) {
       // Macro / Text Mode - show file selection menu
       inFileMenu = true;
-      listSDTextFiles(fileList, fileCount);
+      fileCount = countSDTextFiles();
       fileMenuSelection = 0;
-      drawFileMenu(fileMenuSelection, fileList, fileCount);
+      drawFileMenu(fileMenuSelection, fileCount);
     }
     
     // For Password/Storage/Text File modes, continue to normal HID loop
@@ -296,6 +297,8 @@ void loop() {
       processBLELine(line);
       processedCount++;
     }
+    // Advance a running macro; never blocks, so commands above stay live
+    servicePlayback();
     // No delay - let USB and BLE coexist
     return;  // Don't process HID input in BLE mode
   }
@@ -317,10 +320,13 @@ void loop() {
         showStartupMessage("Loading file...");
         delay(200);
         
-        processTextFileAuto(fileList[fileMenuSelection]);
+        String selected;
+        if (readSDTextFiles(fileMenuSelection, &selected, 1) == 1) {
+          processTextFileAuto(selected);
+        }
         
         // Return to file menu
-        drawFileMenu(fileMenuSelection, fileList, fileCount);
+        drawFileMenu(fileMenuSelection, fileCount);
       }
     } else if (!codeAccepted) {
       readButton();
@@ -0,0 +1,50 @@
+#include "mouseacc.h"
+#include "hidlock.h"
+#include <USBHIDMouse.h>
+
+// External mouse reference from main.cpp
+extern USBHIDMouse Mouse;
+
+static int32_t accX = 0;
+static int32_t accY = 0;
+static int32_t accWheel = 0;
+static int32_t accPan = 0;
+
+static int32_t saturatingAdd(int32_t a, int32_t b) {
+  int64_t sum = (int64_t)a + b;
+  if (sum > INT32_MAX) return INT32_MAX;
+  if (sum < INT32_MIN) return INT32_MIN;
+  return (int32_t)sum;
+}
+
+// Take up to one report's worth (+/-127) from an accumulator
+static int8_t takeStep(int32_t& acc) {
+  int32_t step = acc > 127 ? 127 : (acc < -127 ? -127 : acc);
+  acc -= step;
+  return (int8_t)step;
+}
+
+void mouseAccAdd(int dx, int dy, int wheel, int pan) {
+  accX = saturatingAdd(accX, dx);
+  accY = saturatingAdd(accY, dy);
+  accWheel = saturatingAdd(accWheel, wheel);
+  accPan = saturatingAdd(accPan, pan);
+}
+
+bool mouseAccPending() {
+  return accX != 0 || accY != 0 || accWheel != 0 || accPan != 0;
+}
+
+void mouseAccFlushOne() {
+  if (!mouseAccPending()) return;
+  int8_t x = takeStep(accX);
+  int8_t y = takeStep(accY);
+  int8_t wheel = takeStep(accWheel);
+  int8_t pan = takeStep(accPan);
+  HidLockGuard lock;
+  Mouse.move(x, y, wheel, pan);
+}
+
+void mouseAccFlushAll() {
+  while (mouseAccPending()) mouseAccFlushOne();
+}
@@ -0,0 +1,132 @@
+#include "padframe.h"
+#include "hidlock.h"
+#include <USBHIDGamepad.h>
+
+// External gamepad reference from main.cpp
+extern USBHIDGamepad Gamepad;
+
+struct PadReport {
+  int8_t x, y, z, rz, rx, ry;
+  uint8_t hat;
+  uint32_t buttons;
+};
+
+static int8_t shadow[PAD_INPUT_COUNT];
+static bool dirty = false;
+static bool sentValid = false;
+static PadReport lastSent;
+
+static const struct { const char* xb1; const char* ps4; uint8_t input; } padNames[] = {
+  {"XB1_A", "PS4_CROSS", PAD_A}, {"XB1_B", "PS4_CIRCLE", PAD_B},
+  {"XB1_X", "PS4_SQUARE", PAD_X}, {"XB1_Y", "PS4_TRIANGLE", PAD_Y},
+  {"XB1_LB", "PS4_L1", PAD_LB}, {"XB1_RB", "PS4_R1", PAD_RB},
+  {"XB1_VIEW", "PS4_SHARE", PAD_VIEW}, {"XB1_MENU", "PS4_OPTIONS", PAD_MENU},
+  {"XB1_XBOX", "PS4_PS", PAD_HOME},
+  {"XB1_LS", "PS4_L3", PAD_LS}, {"XB1_RS", "PS4_R3", PAD_RS},
+  {"XB1_UP", "PS4_UP", PAD_UP}, {"XB1_DOWN", "PS4_DOWN", PAD_DOWN},
+  {"XB1_LEFT", "PS4_LEFT", PAD_LEFT}, {"XB1_RIGHT", "PS4_RIGHT", PAD_RIGHT},
+  {"XB1_LT", "PS4_L2", PAD_LT}, {"XB1_RT", "PS4_R2", PAD_RT},
+  {"XB1_LX", "PS4_LX", PAD_LX}, {"XB1_LY", "PS4_LY", PAD_LY},
+  {"XB1_RX", "PS4_RX", PAD_RX}, {"XB1_RY", "PS4_RY", PAD_RY},
+};
+
+// Report button bit of each digital input (d-pad goes to the hat)
+static const uint8_t padButtons[][2] = {
+  {PAD_A, BUTTON_A}, {PAD_B, BUTTON_B}, {PAD_X, BUTTON_X}, {PAD_Y, BUTTON_Y},
+  {PAD_LB, BUTTON_TL}, {PAD_RB, BUTTON_TR},
+  {PAD_VIEW, BUTTON_SELECT}, {PAD_MENU, BUTTON_START}, {PAD_HOME, BUTTON_MODE},
+  {PAD_LS, BUTTON_THUMBL}, {PAD_RS, BUTTON_THUMBR},
+  {PAD_LT, BUTTON_TL2}, {PAD_RT, BUTTON_TR2},  // triggers also as buttons
+};
+
+static bool equalsNoCase(const char* s, size_t len, const char* word) {
+  if (strlen(word) != len) return false;
+  for (size_t i = 0; i < len; i++) {
+    if (toupper((unsigned char)s[i]) != word[i]) return false;
+  }
+  return true;
+}
+
+uint8_t padInputByName(const char* name, size_t len) {
+  for (const auto& n : padNames) {
+    if (equalsNoCase(name, len, n.xb1) || equalsNoCase(name, len, n.ps4)) return n.input;
+  }
+  return PAD_INPUT_NONE;
+}
+
+static bool isStick(uint8_t input) {
+  return input >= PAD_LX && input <= PAD_RY;
+}
+
+// GPC -100..100 / 0..100 to the report's -127..127
+static int8_t toAxis(int8_t v) {
+  return (int8_t)((int)v * 127 / 100);
+}
+
+static uint8_t hatFromDpad() {
+  // Opposite directions cancel
+  int v = (shadow[PAD_UP] ? 1 : 0) - (shadow[PAD_DOWN] ? 1 : 0);
+  int h = (shadow[PAD_RIGHT] ? 1 : 0) - (shadow[PAD_LEFT] ? 1 : 0);
+  static const uint8_t hats[3][3] = {
+    // h = -1         h = 0        h = 1
+    {HAT_DOWN_LEFT, HAT_DOWN, HAT_DOWN_RIGHT},  // v = -1
+    {HAT_LEFT, HAT_CENTER, HAT_RIGHT},          // v = 0
+    {HAT_UP_LEFT, HAT_UP, HAT_UP_RIGHT},        // v = 1
+  };
+  return hats[v + 1][h + 1];
+}
+
+void padFrameBegin() {
+  memset(shadow, 0, sizeof(shadow));
+  dirty = false;
+  sentValid = false;
+}
+
+void padFrameReset() {
+  for (uint8_t i = 0; i < PAD_INPUT_COUNT; i++) padFrameSet(i, 0);
+}
+
+void padFrameSet(uint8_t input, int value) {
+  if (input >= PAD_INPUT_COUNT) return;
+  int lo = isStick(input) ? -100 : 0;
+  if (value < lo) value = lo;
+  if (value > 100) value = 100;
+  if (shadow[input] != value) {
+    shadow[input] = (int8_t)value;
+    dirty = true;
+  }
+}
+
+int padFrameGet(uint8_t input) {
+  return input < PAD_INPUT_COUNT ? shadow[input] : 0;
+}
+
+bool padFrameDirty() {
+  return dirty;
+}
+
+bool padFrameSend() {
+  if (!dirty) return false;
+  dirty = false;
+
+  PadReport r;
+  memset(&r, 0, sizeof(r));
+  r.x = toAxis(shadow[PAD_LX]);
+  r.y = toAxis(shadow[PAD_LY]);
+  r.z = toAxis(shadow[PAD_RX]);
+  r.rz = toAxis(shadow[PAD_RY]);
+  r.rx = toAxis(shadow[PAD_LT]);
+  r.ry = toAxis(shadow[PAD_RT]);
+  r.hat = hatFromDpad();
+  for (const auto& b : padButtons) {
+    if (shadow[b[0]]) r.buttons |= 1UL << b[1];
+  }
+
+  // Values that changed and changed back within a frame send nothing
+  if (sentValid && memcmp(&r, &lastSent, sizeof(r)) == 0) return false;
+  HidLockGuard lock;
+  Gamepad.send(r.x, r.y, r.z, r.rz, r.rx, r.ry, r.hat, r.buttons);
+  lastSent = r;
+  sentValid = true;
+  return true;
+}
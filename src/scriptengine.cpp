@@ -3,430 +3,1043 @@
 #include <USBHIDKeyboard.h>
 #include <USBHIDMouse.h>
 #include <USBHIDGamepad.h>
+#include "padframe.h"
 #include "usb.h"
 
+#ifndef BOOT_BUTTON_PIN
+#define BOOT_BUTTON_PIN 0
+#endif
+
 // External references
 extern USBHIDKeyboard Keyboard;
 extern USBHIDMouse Mouse;
 extern USBHIDGamepad Gamepad;
 
-// Helper: Trim whitespace
-static String trim(const String& s) {
-    String result = s;
-    result.trim();
-    return result;
-}
-
-// Helper: Split string by delimiter
-static std::vector<String> split(const String& s, char delim) {
-    std::vector<String> result;
-    int start = 0;
-    for (size_t i = 0; i <= s.length(); i++) {
-        if (i == s.length() || s[i] == delim) {
-            result.push_back(s.substring(start, i));
-            start = i + 1;
-        }
-    }
-    return result;
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
 }
 
-// Evaluate arithmetic expression with variables
-// Supports: +, -, *, /, %, parentheses, variables
-int evaluateExpression(ScriptContext& ctx, const String& expr) {
-    String e = trim(expr);
-    
-    // Check if it's just a number
-    bool isNum = true;
-    bool hasNeg = e.startsWith("-");
-    for (size_t i = (hasNeg ? 1 : 0); i < e.length(); i++) {
-        if (e[i] < '0' || e[i] > '9') {
-            isNum = false;
-            break;
+static bool isIdentStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static bool isIdentChar(char c) {
+    return isIdentStart(c) || (c >= '0' && c <= '9');
+}
+
+// A slice of the script arena. The loader works on these rather than
+// String copies; the calls mirror the String ones they replace.
+struct Span {
+    char* s;
+    size_t len;
+
+    Span(char* s, size_t len) : s(s), len(len) {}
+
+    Span trimmed() const {
+        Span t = *this;
+        while (t.len > 0 && isBlank(t.s[0])) { t.s++; t.len--; }
+        while (t.len > 0 && isBlank(t.s[t.len - 1])) t.len--;
+        return t;
+    }
+    Span substring(size_t from) const { return Span(s + from, len - from); }
+    Span substring(size_t from, size_t to) const { return Span(s + from, to - from); }
+
+    int indexOf(char c) const {
+        const char* p = (const char*)memchr(s, c, len);
+        return p ? p - s : -1;
+    }
+    int indexOf(const char* w) const {
+        size_t n = strlen(w);
+        for (size_t i = 0; i + n <= len; i++) {
+            if (memcmp(s + i, w, n) == 0) return i;
         }
+        return -1;
     }
-    if (isNum) return e.toInt();
-    
-    // Check if it's a variable
-    if (e.length() > 0 && ((e[0] >= 'a' && e[0] <= 'z') || (e[0] >= 'A' && e[0] <= 'Z') || e[0] == '_')) {
-        bool isVar = true;
-        for (size_t i = 1; i < e.length(); i++) {
-            char c = e[i];
-            if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_')) {
-                isVar = false;
-                break;
-            }
+    bool startsWith(const char* p) const {
+        size_t n = strlen(p);
+        return len >= n && memcmp(s, p, n) == 0;
+    }
+    bool endsWith(const char* p) const {
+        size_t n = strlen(p);
+        return len >= n && memcmp(s + len - n, p, n) == 0;
+    }
+    bool operator==(const char* w) const {
+        return len == strlen(w) && memcmp(s, w, len) == 0;
+    }
+    bool equalsIgnoreCase(const char* w) const {
+        if (len != strlen(w)) return false;
+        for (size_t i = 0; i < len; i++) {
+            if (toupper((unsigned char)s[i]) != w[i]) return false;
         }
-        if (isVar) return ctx.getVar(e);
+        return true;
     }
-    
-    // Simple recursive descent parser
-    // For now, support basic operations: +, -, *, /, %
-    
-    // Find lowest precedence operator (+ or -)
-    int parenDepth = 0;
-    int opPos = -1;
-    char opChar = 0;
-    
-    for (int i = e.length() - 1; i >= 0; i--) {
-        char c = e[i];
-        if (c == ')') parenDepth++;
-        else if (c == '(') parenDepth--;
-        else if (parenDepth == 0 && (c == '+' || c == '-') && i > 0) {
-            opPos = i;
-            opChar = c;
-            break;
+    bool isIdentifier() const {
+        if (len == 0 || !isIdentStart(s[0])) return false;
+        for (size_t i = 1; i < len; i++) {
+            if (!isIdentChar(s[i])) return false;
         }
+        return true;
     }
-    
-    // If no +/-, look for */ %
-    if (opPos < 0) {
-        parenDepth = 0;
-        for (int i = e.length() - 1; i >= 0; i--) {
-            char c = e[i];
-            if (c == ')') parenDepth++;
-            else if (c == '(') parenDepth--;
-            else if (parenDepth == 0 && (c == '*' || c == '/' || c == '%') && i > 0) {
-                opPos = i;
-                opChar = c;
-                break;
+};
+
+// ------------------------------------------------------------------
+// Expression compiler
+// ------------------------------------------------------------------
+
+// Recursive descent over the expression text, emitting RPN into
+// ctx.code. Precedence, lowest first: ||, &&, comparisons, + -, * / %,
+// unary - !. Tracks the operand stack depth the ops will need.
+class ExprCompiler {
+public:
+    ExprCompiler(ScriptContext& ctx, const char* text, size_t len)
+        : ctx(ctx), p(text), end(text + len), depth(0), maxDepth(0), ok(true) {}
+
+    bool compile() {
+        parseOr();
+        skipSpace();
+        return ok && p == end && maxDepth <= SCRIPT_EVAL_STACK;
+    }
+
+private:
+    void skipSpace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    }
+
+    // Consume `op` if it comes next (and isn't the start of a longer one)
+    bool accept(const char* op) {
+        skipSpace();
+        size_t n = strlen(op);
+        if ((size_t)(end - p) < n || memcmp(p, op, n) != 0) return false;
+        if (n == 1 && p + 1 < end && p[1] == '=' && (*op == '<' || *op == '>' || *op == '!')) return false;
+        p += n;
+        return true;
+    }
+
+    void push(ScriptOpCode code, int value = 0) {
+        ScriptOp op;
+        op.code = code;
+        op.value = value;
+        ctx.code.push_back(op);
+    }
+
+    void pushOperand(ScriptOpCode code, int value) {
+        push(code, value);
+        if (++depth > maxDepth) maxDepth = depth;
+    }
+
+    void binary(ScriptOpCode code) {
+        push(code);
+        depth--;
+    }
+
+    void parseOr() {
+        parseAnd();
+        while (ok && accept("||")) { parseAnd(); binary(SOP_OR); }
+    }
+
+    void parseAnd() {
+        parseCompare();
+        while (ok && accept("&&")) { parseCompare(); binary(SOP_AND); }
+    }
+
+    void parseCompare() {
+        parseSum();
+        static const char* const ops[] = {"==", "!=", "<=", ">=", "<", ">"};
+        static const ScriptOpCode codes[] = {SOP_EQ, SOP_NE, SOP_LE, SOP_GE, SOP_LT, SOP_GT};
+        for (int i = 0; ok && i < 6; i++) {
+            if (accept(ops[i])) {
+                parseSum();
+                binary(codes[i]);
+                return;
             }
         }
     }
-    
-    if (opPos > 0) {
-        int left = evaluateExpression(ctx, e.substring(0, opPos));
-        int right = evaluateExpression(ctx, e.substring(opPos + 1));
-        
-        switch (opChar) {
-            case '+': return left + right;
-            case '-': return left - right;
-            case '*': return left * right;
-            case '/': return (right != 0) ? (left / right) : 0;
-            case '%': return (right != 0) ? (left % right) : 0;
+
+    void parseSum() {
+        parseProduct();
+        while (ok) {
+            if (accept("+")) { parseProduct(); binary(SOP_ADD); }
+            else if (accept("-")) { parseProduct(); binary(SOP_SUB); }
+            else break;
         }
     }
-    
-    // Handle parentheses
-    if (e.startsWith("(") && e.endsWith(")")) {
-        return evaluateExpression(ctx, e.substring(1, e.length() - 1));
+
+    void parseProduct() {
+        parseUnary();
+        while (ok) {
+            if (accept("*")) { parseUnary(); binary(SOP_MUL); }
+            else if (accept("/")) { parseUnary(); binary(SOP_DIV); }
+            else if (accept("%")) { parseUnary(); binary(SOP_MOD); }
+            else break;
+        }
     }
-    
-    // Default: try to parse as number
-    return e.toInt();
-}
 
-// Evaluate boolean condition
-// Supports: ==, !=, <, >, <=, >=, &&, ||
-bool evaluateCondition(ScriptContext& ctx, const String& condition) {
-    String c = trim(condition);
-    
-    // Handle && and ||
-    int parenDepth = 0;
-    for (size_t i = 0; i < c.length() - 1; i++) {
-        if (c[i] == '(') parenDepth++;
-        else if (c[i] == ')') parenDepth--;
-        else if (parenDepth == 0) {
-            if (c.substring(i, i + 2) == "||") {
-                bool left = evaluateCondition(ctx, c.substring(0, i));
-                bool right = evaluateCondition(ctx, c.substring(i + 2));
-                return left || right;
-            }
+    void parseUnary() {
+        if (accept("-")) {
+            parseUnary();
+            // Fold negative literals
+            if (ok && ctx.code.back().code == SOP_CONST) ctx.code.back().value = -ctx.code.back().value;
+            else push(SOP_NEG);
+        } else if (accept("!")) {
+            parseUnary();
+            push(SOP_NOT);
+        } else {
+            parsePrimary();
         }
     }
-    
-    parenDepth = 0;
-    for (size_t i = 0; i < c.length() - 1; i++) {
-        if (c[i] == '(') parenDepth++;
-        else if (c[i] == ')') parenDepth--;
-        else if (parenDepth == 0) {
-            if (c.substring(i, i + 2) == "&&") {
-                bool left = evaluateCondition(ctx, c.substring(0, i));
-                bool right = evaluateCondition(ctx, c.substring(i + 2));
-                return left && right;
-            }
+
+    void parsePrimary() {
+        skipSpace();
+        if (p == end) { ok = false; return; }
+        if (*p == '(') {
+            p++;
+            parseOr();
+            if (!accept(")")) ok = false;
+        } else if (*p >= '0' && *p <= '9') {
+            long v = 0;
+            while (p < end && *p >= '0' && *p <= '9') v = v * 10 + (*p++ - '0');
+            pushOperand(SOP_CONST, (int)v);
+        } else if (isIdentStart(*p)) {
+            const char* start = p;
+            while (p < end && isIdentChar(*p)) p++;
+            pushOperand(SOP_VAR, ctx.intern(start, p - start));
+        } else {
+            ok = false;
         }
     }
-    
-    // Handle comparison operators
-    const char* ops[] = {"==", "!=", "<=", ">=", "<", ">"};
-    for (int opIdx = 0; opIdx < 6; opIdx++) {
-        int opLen = (opIdx < 4) ? 2 : 1;
-        String opStr = String(ops[opIdx]);
-        
-        int pos = c.indexOf(opStr);
-        if (pos > 0) {
-            int left = evaluateExpression(ctx, c.substring(0, pos));
-            int right = evaluateExpression(ctx, c.substring(pos + opLen));
-            
-            switch (opIdx) {
-                case 0: return left == right;  // ==
-                case 1: return left != right;  // !=
-                case 2: return left <= right;  // <=
-                case 3: return left >= right;  // >=
-                case 4: return left < right;   // <
-                case 5: return left > right;   // >
-            }
+
+    ScriptContext& ctx;
+    const char* p;
+    const char* end;
+    int depth;
+    int maxDepth;
+    bool ok;
+};
+
+ScriptExpr compileExpression(ScriptContext& ctx, const char* text, size_t len) {
+    ScriptExpr expr;
+    expr.start = ctx.code.size();
+    ExprCompiler compiler(ctx, text, len);
+    if (!compiler.compile()) {
+        // Not an expression: like String::toInt(), use the leading number
+        ctx.code.resize(expr.start);
+        String number;
+        number.concat(text, len);
+        ScriptOp op;
+        op.code = SOP_CONST;
+        op.value = number.toInt();
+        ctx.code.push_back(op);
+    }
+    expr.count = ctx.code.size() - expr.start;
+    return expr;
+}
+
+static ScriptExpr compileExpression(ScriptContext& ctx, const Span& text) {
+    return compileExpression(ctx, text.s, text.len);
+}
+
+// Runs the op list on a fixed stack; no parsing, no allocation
+int evaluateExpression(ScriptContext& ctx, const ScriptExpr& expr) {
+    int stack[SCRIPT_EVAL_STACK];
+    int sp = 0;
+    const int* values = ctx.values.data();
+    const ScriptOp* op = ctx.code.data() + expr.start;
+    const ScriptOp* last = op + expr.count;
+    ctx.stats.evals++;
+    for (; op < last; op++) {
+        switch (op->code) {
+            case SOP_CONST: stack[sp++] = op->value; continue;
+            case SOP_VAR:   stack[sp++] = values[op->value]; continue;
+            case SOP_NEG:   stack[sp - 1] = -stack[sp - 1]; continue;
+            case SOP_NOT:   stack[sp - 1] = !stack[sp - 1]; continue;
+            default: break;
+        }
+        int right = stack[--sp];
+        int& left = stack[sp - 1];
+        switch (op->code) {
+            case SOP_ADD: left += right; break;
+            case SOP_SUB: left -= right; break;
+            case SOP_MUL: left *= right; break;
+            case SOP_DIV: left = (right != 0) ? (left / right) : 0; break;
+            case SOP_MOD: left = (right != 0) ? (left % right) : 0; break;
+            case SOP_EQ:  left = left == right; break;
+            case SOP_NE:  left = left != right; break;
+            case SOP_LT:  left = left < right; break;
+            case SOP_GT:  left = left > right; break;
+            case SOP_LE:  left = left <= right; break;
+            case SOP_GE:  left = left >= right; break;
+            case SOP_AND: left = left && right; break;
+            case SOP_OR:  left = left || right; break;
+            default: break;
         }
     }
-    
-    // If no operator, treat as expression != 0
-    return evaluateExpression(ctx, c) != 0;
+    return sp > 0 ? stack[0] : 0;
 }
 
-// Execute GPC-style command
-void executeGPCCommand(ScriptContext& ctx, const String& command) {
-    String cmd = trim(command);
-    
-    // wait(ms) - delay
-    if (cmd.startsWith("wait(") && cmd.endsWith(")")) {
-        int ms = evaluateExpression(ctx, cmd.substring(5, cmd.length() - 1));
-        delay(ms);
-        return;
+// Evaluation with the CPU time added to the run statistics
+static int evaluateTimed(ScriptContext& ctx, const ScriptExpr& expr) {
+    uint32_t start = ESP.getCycleCount();
+    int value = evaluateExpression(ctx, expr);
+    ctx.stats.evalCycles += (uint32_t)(ESP.getCycleCount() - start);
+    return value;
+}
+
+uint32_t ScriptStats::evalsPerSec() const {
+    if (evalCycles == 0) return 0;
+    return (uint32_t)((uint64_t)evals * ESP.getCpuFreqMHz() * 1000000ULL / evalCycles);
+}
+
+// ------------------------------------------------------------------
+// Statement compiler
+// ------------------------------------------------------------------
+
+// Make `text` the statement's text operand, NUL-terminated in place
+// (there is always a byte after it: whitespace, a quote, the newline or
+// the arena's final NUL)
+static void setText(ScriptContext& ctx, ScriptStmt& stmt, const Span& text) {
+    text.s[text.len] = '\0';
+    stmt.text = text.s - ctx.arena.data();
+    stmt.textLen = text.len;
+}
+
+// `name = value`: numeric values compile to an expression, quoted ones
+// are string assignments of the text between the quotes
+static void compileAssignment(ScriptContext& ctx, ScriptStmt& stmt,
+                              const Span& varName, const Span& valueExpr) {
+    stmt.var = ctx.intern(varName.s, varName.len);
+    if (valueExpr.len >= 2 && valueExpr.startsWith("\"") && valueExpr.endsWith("\"")) {
+        stmt.kind = STMT_ASSIGN_STR;
+        setText(ctx, stmt, valueExpr.substring(1, valueExpr.len - 1));
+    } else {
+        stmt.kind = STMT_ASSIGN;
+        stmt.a = compileExpression(ctx, valueExpr);
     }
-    
-    // set_val(button, value) - set gamepad button/axis
-    if (cmd.startsWith("set_val(") && cmd.endsWith(")")) {
-        String args = cmd.substring(8, cmd.length() - 1);
+}
+
+// GPC-style calls: wait(ms), set_val(button, value), combo_run(name),
+// combo_stop(name). False if `cmd` isn't one of them.
+static bool compileGPCCommand(ScriptContext& ctx, ScriptStmt& stmt, const Span& cmd) {
+    if (cmd.startsWith("wait(")) {
+        stmt.kind = STMT_WAIT;
+        stmt.a = compileExpression(ctx, cmd.substring(5, cmd.len - 1));
+    } else if (cmd.startsWith("set_val(")) {
+        Span args = cmd.substring(8, cmd.len - 1);
         int comma = args.indexOf(',');
         if (comma > 0) {
-            String btnName = trim(args.substring(0, comma));
-            int value = evaluateExpression(ctx, args.substring(comma + 1));
-            
-            // Map common GPC button names to gamepad
-            btnName.toUpperCase();
-            if (btnName == "PS4_CROSS" || btnName == "XB1_A") {
-                if (value > 0) Gamepad.pressButton(1); else Gamepad.releaseButton(1);
-            } else if (btnName == "PS4_CIRCLE" || btnName == "XB1_B") {
-                if (value > 0) Gamepad.pressButton(2); else Gamepad.releaseButton(2);
-            } else if (btnName == "PS4_SQUARE" || btnName == "XB1_X") {
-                if (value > 0) Gamepad.pressButton(3); else Gamepad.releaseButton(3);
-            } else if (btnName == "PS4_TRIANGLE" || btnName == "XB1_Y") {
-                if (value > 0) Gamepad.pressButton(4); else Gamepad.releaseButton(4);
-            }
+            stmt.kind = STMT_SET_VAL;
+            Span name = args.substring(0, comma).trimmed();
+            stmt.button = padInputByName(name.s, name.len);
+            stmt.a = compileExpression(ctx, args.substring(comma + 1));
         }
-        return;
-    }
-    
-    // combo_run(name) - placeholder for combo execution
-    if (cmd.startsWith("combo_run(")) {
-        // Would need combo definitions - for now just delay
-        delay(100);
-        return;
+    } else if (cmd.startsWith("combo_run(") || cmd.startsWith("combo_stop(")) {
+        // Names resolve to combo indexes in linkScriptBlocks()
+        bool run = cmd.startsWith("combo_run(");
+        Span name = cmd.substring(run ? 10 : 11, cmd.len - 1).trimmed();
+        if (name.isIdentifier()) {
+            stmt.kind = run ? STMT_COMBO_RUN : STMT_COMBO_STOP;
+            stmt.var = ctx.intern(name.s, name.len);
+        }
+    } else {
+        return false;
     }
+    return true;
 }
 
-// Execute single script line with context
-bool executeScriptLine(ScriptContext& ctx, const String& line) {
-    String trimmedLine = trim(line);
+void compileScriptLine(ScriptContext& ctx, size_t index, char* line, size_t len) {
+    ScriptStmt& stmt = ctx.program[index];
+    memset(&stmt, 0, sizeof(stmt));
+    stmt.kind = STMT_NOP;
+
+    Span trimmedLine = Span(line, len).trimmed();
     
     // Skip empty lines and comments
-    if (trimmedLine.length() == 0 || trimmedLine.startsWith("//") || trimmedLine.startsWith("REM ")) {
-        return true;
+    if (trimmedLine.len == 0 || trimmedLine.startsWith("//") || trimmedLine.startsWith("REM ")) {
+        return;
     }
     
     // Variable assignment: VAR name = value
     if (trimmedLine.startsWith("VAR ") || trimmedLine.startsWith("var ")) {
         int eqPos = trimmedLine.indexOf('=');
         if (eqPos > 0) {
-            String varName = trim(trimmedLine.substring(4, eqPos));
-            String valueExpr = trim(trimmedLine.substring(eqPos + 1));
-            
-            // Check if it's a string assignment (quoted)
-            if (valueExpr.startsWith("\"") && valueExpr.endsWith("\"")) {
-                ctx.setStringVar(varName, valueExpr.substring(1, valueExpr.length() - 1));
-            } else {
-                int value = evaluateExpression(ctx, valueExpr);
-                ctx.setVar(varName, value);
-            }
+            compileAssignment(ctx, stmt, trimmedLine.substring(4, eqPos).trimmed(),
+                              trimmedLine.substring(eqPos + 1).trimmed());
         }
-        return true;
+        return;
     }
     
     // Assignment without VAR keyword: name = value
-    if (trimmedLine.indexOf('=') > 0 && !trimmedLine.startsWith("IF ") && !trimmedLine.startsWith("if ")) {
-        int eqPos = trimmedLine.indexOf('=');
-        String varName = trim(trimmedLine.substring(0, eqPos));
-        
-        // Check if varName is valid identifier
-        if (varName.length() > 0 && ((varName[0] >= 'a' && varName[0] <= 'z') || 
-                                      (varName[0] >= 'A' && varName[0] <= 'Z') || 
-                                      varName[0] == '_')) {
-            String valueExpr = trim(trimmedLine.substring(eqPos + 1));
-            
-            if (valueExpr.startsWith("\"") && valueExpr.endsWith("\"")) {
-                ctx.setStringVar(varName, valueExpr.substring(1, valueExpr.length() - 1));
-            } else {
-                int value = evaluateExpression(ctx, valueExpr);
-                ctx.setVar(varName, value);
-            }
-            return true;
+    int eqPos = trimmedLine.indexOf('=');
+    if (eqPos > 0 && ((size_t)eqPos + 1 == trimmedLine.len || trimmedLine.s[eqPos + 1] != '=')) {
+        Span varName = trimmedLine.substring(0, eqPos).trimmed();
+        if (varName.isIdentifier()) {
+            compileAssignment(ctx, stmt, varName, trimmedLine.substring(eqPos + 1).trimmed());
+            return;
         }
     }
     
     // IF statement
     if (trimmedLine.startsWith("IF ") || trimmedLine.startsWith("if ")) {
-        String condition = trim(trimmedLine.substring(3));
+        Span condition = trimmedLine.substring(3).trimmed();
         
         // Remove trailing 'then' if present
         if (condition.endsWith(" THEN") || condition.endsWith(" then")) {
-            condition = trim(condition.substring(0, condition.length() - 5));
-        }
-        
-        bool result = evaluateCondition(ctx, condition);
-        
-        if (!result) {
-            ctx.skipMode = true;
-            ctx.skipDepth = 1;
+            condition = condition.substring(0, condition.len - 5).trimmed();
         }
-        return true;
+        stmt.kind = STMT_IF;
+        stmt.a = compileExpression(ctx, condition);
+        return;
     }
     
-    // ELSE statement
     if (trimmedLine == "ELSE" || trimmedLine == "else") {
-        if (ctx.skipDepth == 1) {
-            ctx.skipMode = !ctx.skipMode;
-        }
-        return true;
+        stmt.kind = STMT_ELSE;
+        return;
     }
     
-    // ENDIF statement
     if (trimmedLine == "ENDIF" || trimmedLine == "endif") {
-        if (ctx.skipMode && ctx.skipDepth == 1) {
-            ctx.skipMode = false;
-            ctx.skipDepth = 0;
-        }
-        return true;
+        stmt.kind = STMT_ENDIF;
+        return;
     }
     
-    // LOOP statement: LOOP count
+    // LOOP statement: LOOP count (the remaining count gets its own slot,
+    // so loops in combos and the main script don't share state)
     if (trimmedLine.startsWith("LOOP ") || trimmedLine.startsWith("loop ")) {
-        int count = evaluateExpression(ctx, trimmedLine.substring(5));
-        ctx.loopStack.push_back(count);
-        ctx.loopStartPositions.push_back(ctx.currentLine);
-        return true;
+        stmt.kind = STMT_LOOP;
+        stmt.var = ctx.hiddenSlot();
+        stmt.a = compileExpression(ctx, trimmedLine.substring(5));
+        return;
     }
     
-    // ENDLOOP statement
     if (trimmedLine == "ENDLOOP" || trimmedLine == "endloop") {
-        if (!ctx.loopStack.empty()) {
-            ctx.loopStack.back()--;
-            
-            if (ctx.loopStack.back() > 0) {
-                // Continue loop - jump back to loop start
-                ctx.currentLine = ctx.loopStartPositions.back();
-            } else {
-                // Loop finished
-                ctx.loopStack.pop_back();
-                ctx.loopStartPositions.pop_back();
-            }
-        }
-        return true;
+        stmt.kind = STMT_ENDLOOP;
+        return;
     }
     
     // FOR loop: FOR var = start TO end
     if (trimmedLine.startsWith("FOR ") || trimmedLine.startsWith("for ")) {
-        // Simple FOR parsing: FOR i = 0 TO 10
-        String forExpr = trimmedLine.substring(4);
+        Span forExpr = trimmedLine.substring(4);
         int eqPos = forExpr.indexOf('=');
         int toPos = forExpr.indexOf(" TO ");
         if (toPos < 0) toPos = forExpr.indexOf(" to ");
         
         if (eqPos > 0 && toPos > eqPos) {
-            String varName = trim(forExpr.substring(0, eqPos));
-            int startVal = evaluateExpression(ctx, forExpr.substring(eqPos + 1, toPos));
-            int endVal = evaluateExpression(ctx, forExpr.substring(toPos + 4));
-            
-            ctx.setVar(varName, startVal);
-            ctx.setVar("__FOR_END_" + varName, endVal);
-            ctx.setVar("__FOR_VAR", 1); // Mark that we're in a FOR loop
-            ctx.loopStartPositions.push_back(ctx.currentLine);
+            Span varName = forExpr.substring(0, eqPos).trimmed();
+            String endName = "__FOR_END_";
+            endName.concat(varName.s, varName.len);
+            stmt.kind = STMT_FOR;
+            stmt.var = ctx.intern(varName.s, varName.len);
+            stmt.limit = ctx.intern(endName.c_str(), endName.length());
+            stmt.a = compileExpression(ctx, forExpr.substring(eqPos + 1, toPos));
+            stmt.b = compileExpression(ctx, forExpr.substring(toPos + 4));
         }
-        return true;
+        return;
     }
     
-    // NEXT statement (end of FOR loop)
-    if (trimmedLine.startsWith("NEXT ") || trimmedLine.startsWith("next ")) {
-        String varName = trim(trimmedLine.substring(5));
-        int currentVal = ctx.getVar(varName);
-        int endVal = ctx.getVar("__FOR_END_" + varName);
-        
-        currentVal++;
-        ctx.setVar(varName, currentVal);
-        
-        if (currentVal <= endVal && !ctx.loopStartPositions.empty()) {
-            ctx.currentLine = ctx.loopStartPositions.back();
-        } else {
-            if (!ctx.loopStartPositions.empty()) {
-                ctx.loopStartPositions.pop_back();
-            }
+    // NEXT statement (end of FOR loop); the variable is optional, NEXT
+    // steps the FOR it is matched to
+    if (trimmedLine == "NEXT" || trimmedLine == "next" ||
+        trimmedLine.startsWith("NEXT ") || trimmedLine.startsWith("next ")) {
+        stmt.kind = STMT_NEXT;
+        return;
+    }
+    
+    // Combo definition: combo name { ... }, the brace may be on its own line
+    if (trimmedLine.startsWith("combo ") || trimmedLine.startsWith("COMBO ")) {
+        Span name = trimmedLine.substring(6).trimmed();
+        if (name.endsWith("{")) name = name.substring(0, name.len - 1).trimmed();
+        if (name.isIdentifier()) {
+            stmt.kind = STMT_COMBO;
+            stmt.var = ctx.intern(name.s, name.len);
         }
-        return true;
+        return;
     }
     
-    // GPC-style commands
-    if (trimmedLine.indexOf('(') > 0 && trimmedLine.endsWith(")")) {
-        executeGPCCommand(ctx, trimmedLine);
-        return true;
+    // GPC main block, run once per scheduler tick
+    if (trimmedLine == "main" || trimmedLine == "MAIN" ||
+        trimmedLine.startsWith("main ") || trimmedLine.startsWith("MAIN ") ||
+        trimmedLine.startsWith("main{") || trimmedLine.startsWith("MAIN{")) {
+        Span rest = trimmedLine.substring(4).trimmed();
+        if (rest.len == 0 || rest == "{") {
+            stmt.kind = STMT_MAIN;
+            return;
+        }
+    }
+    
+    if (trimmedLine == "{") {
+        return;
+    }
+    
+    if (trimmedLine == "}") {
+        stmt.kind = STMT_BLOCK_END;
+        return;
+    }
+    
+    // GPC-style commands; the trailing ';' is optional, unknown calls are
+    // ignored (never typed)
+    Span call = trimmedLine;
+    if (call.endsWith(";")) call = call.substring(0, call.len - 1).trimmed();
+    if (call.indexOf('(') > 0 && call.endsWith(")")) {
+        if (!compileGPCCommand(ctx, stmt, call)) stmt.kind = STMT_NOP;
+        return;
     }
     
     // Pass through to existing processors (DuckyScript or Macro)
     // This allows mixing advanced scripting with existing commands
-    processMacroText(trimmedLine);
-    
-    return true;
+    stmt.kind = STMT_TEXT;
+    setText(ctx, stmt, trimmedLine);
 }
 
-// Execute advanced script
-void executeAdvancedScript(const String& script) {
-    ScriptContext ctx;
-    ctx.reset();
+// Pairs IF/ELSE/ENDIF, LOOP/ENDLOOP and FOR/NEXT with a stack of open
+// blocks. A closer only matches the innermost open block of its kind;
+// NEXT steps that FOR's variable whatever name it gives.
+void linkScriptBlocks(ScriptContext& ctx) {
+    std::vector<uint16_t> open;
+    int gpcOpen = 0;  // open main/combo blocks
     
-    // Split script into lines
-    int start = 0;
-    for (size_t i = 0; i <= script.length(); i++) {
-        if (i == script.length() || script[i] == '\n') {
-            ctx.lines.push_back(script.substring(start, i));
-            start = i + 1;
+    for (size_t i = 0; i < ctx.program.size(); i++) {
+        ScriptStmt& stmt = ctx.program[i];
+        ScriptStmt* top = open.empty() ? nullptr : &ctx.program[open.back()];
+        
+        switch (stmt.kind) {
+            case STMT_IF:
+            case STMT_LOOP:
+            case STMT_FOR:
+                open.push_back(i);
+                break;
+                
+            case STMT_COMBO: {
+                ScriptCombo combo;
+                memset(&combo, 0, sizeof(combo));
+                combo.name = stmt.var;
+                combo.start = i;
+                ctx.combos.push_back(combo);
+                open.push_back(i);
+                gpcOpen++;
+                break;
+            }
+                
+            case STMT_MAIN:
+                // A second main block is never run
+                if (ctx.mainLine < 0) ctx.mainLine = i;
+                open.push_back(i);
+                gpcOpen++;
+                break;
+                
+            case STMT_TEXT:
+                // Inside main/combo, lines the engine doesn't know (GPC
+                // `if (...) {`, ...) are skipped rather than typed every
+                // tick. Their braces open and close blocks of their own, so
+                // the block's closing brace still ends it.
+                if (gpcOpen > 0) {
+                    const char* t = ctx.text(stmt);
+                    stmt.kind = STMT_NOP;
+                    if (t[0] == '}' && top && top->kind == STMT_NOP) open.pop_back();
+                    if (stmt.textLen > 0 && t[stmt.textLen - 1] == '{') open.push_back(i);
+                }
+                break;
+                
+            case STMT_ELSE:
+                if (top && top->kind == STMT_IF) {
+                    top->jump = i;
+                    open.back() = i;
+                } else {
+                    stmt.kind = STMT_NOP;
+                }
+                break;
+                
+            case STMT_ENDIF:
+                if (top && (top->kind == STMT_IF || top->kind == STMT_ELSE)) {
+                    top->jump = i;
+                    open.pop_back();
+                } else {
+                    stmt.kind = STMT_NOP;
+                }
+                break;
+                
+            case STMT_ENDLOOP:
+                if (top && top->kind == STMT_LOOP) {
+                    top->jump = i;
+                    stmt.jump = open.back();
+                    stmt.var = top->var;
+                    open.pop_back();
+                } else {
+                    stmt.kind = STMT_NOP;
+                }
+                break;
+                
+            case STMT_NEXT:
+                if (top && top->kind == STMT_FOR) {
+                    top->jump = i;
+                    stmt.jump = open.back();
+                    stmt.var = top->var;
+                    stmt.limit = top->limit;
+                    open.pop_back();
+                } else {
+                    stmt.kind = STMT_NOP;
+                }
+                break;
+                
+            case STMT_BLOCK_END:
+                if (top && top->kind == STMT_NOP) {
+                    // Closes a skipped line's brace
+                    stmt.kind = STMT_NOP;
+                    open.pop_back();
+                } else if (top && (top->kind == STMT_COMBO || top->kind == STMT_MAIN)) {
+                    top->jump = i;
+                    stmt.jump = open.back();
+                    open.pop_back();
+                    gpcOpen--;
+                } else {
+                    stmt.kind = STMT_NOP;
+                }
+                break;
+                
+            default:
+                break;
         }
     }
     
-    // Execute lines
-    while (ctx.currentLine < ctx.lines.size()) {
-        String line = ctx.lines[ctx.currentLine];
-        
-        if (!ctx.skipMode) {
-            executeScriptLine(ctx, line);
+    // Blocks never closed: skipping one skips the rest of the script
+    for (uint16_t i : open) {
+        ctx.program[i].jump = ctx.program.size();
+    }
+    
+    // combo_run/combo_stop: combo name symbol -> combo index
+    for (ScriptStmt& stmt : ctx.program) {
+        if (stmt.kind != STMT_COMBO_RUN && stmt.kind != STMT_COMBO_STOP) continue;
+        size_t c = 0;
+        while (c < ctx.combos.size() && ctx.combos[c].name != stmt.var) c++;
+        if (c < ctx.combos.size()) {
+            stmt.var = c;
         } else {
-            // In skip mode - only watch for control flow
-            String trimmedLine = trim(line);
-            if (trimmedLine.startsWith("IF ") || trimmedLine.startsWith("if ")) {
-                ctx.skipDepth++;
-            } else if (trimmedLine == "ENDIF" || trimmedLine == "endif") {
-                ctx.skipDepth--;
-                if (ctx.skipDepth == 0) {
-                    ctx.skipMode = false;
-                }
-            } else if (trimmedLine == "ELSE" || trimmedLine == "else") {
-                if (ctx.skipDepth == 1) {
-                    ctx.skipMode = false;
-                }
+            stmt.kind = STMT_NOP;
+        }
+    }
+}
+
+// ------------------------------------------------------------------
+// Scheduler
+// ------------------------------------------------------------------
+
+static uint8_t tickMs = SCRIPT_TICK_MS_DEFAULT;
+
+void scriptSetTickMs(uint8_t ms) {
+    tickMs = ms > 0 ? ms : SCRIPT_TICK_MS_DEFAULT;
+}
+
+uint8_t scriptTickMs() {
+    return tickMs;
+}
+
+static void sleepUntil(int64_t deadline) {
+    int64_t us = deadline - esp_timer_get_time();
+    if (us >= 1000) delay(us / 1000);
+    else if (us > 0) delayMicroseconds(us);
+}
+
+// Outside the main block the scheduler only ticks while it has work:
+// combos to step or a changed gamepad frame to send. set_val() calls
+// between waits therefore go out together as one report.
+static bool tickPending(const ScriptContext& ctx) {
+    return ctx.combosRunning > 0 || padFrameDirty();
+}
+
+// combo_run: starts from the top unless already running
+static void startCombo(ScriptContext& ctx, ScriptCombo& combo) {
+    if (combo.running) return;
+    combo.running = true;
+    combo.pc = combo.start + 1;
+    combo.wakeAt = esp_timer_get_time();
+    ctx.combosRunning++;
+    if (ctx.combosRunning > ctx.stats.comboPeak) ctx.stats.comboPeak = ctx.combosRunning;
+}
+
+static void stopCombo(ScriptContext& ctx, ScriptCombo& combo) {
+    if (!combo.running) return;
+    combo.running = false;
+    ctx.combosRunning--;
+}
+
+// wait() inside a combo parks it. Deadlines follow on from the previous
+// one so a sequence of waits doesn't drift by a tick each; a combo held
+// up by blocking work (typing) restarts its schedule from now.
+static void comboWait(ScriptContext& ctx, ScriptCombo& combo, int ms) {
+    int64_t now = esp_timer_get_time();
+    if (combo.wakeAt < now - ctx.tickUs) combo.wakeAt = now;
+    if (ms > 0) combo.wakeAt += (int64_t)ms * 1000;
+}
+
+// Run one combo from its pc until it waits, ends or uses up its budget
+static void stepCombo(ScriptContext& ctx, ScriptCombo& combo, int64_t now) {
+    size_t mainLine = ctx.currentLine;
+    ctx.activeCombo = &combo;
+    ctx.currentLine = combo.pc;
+    for (int n = 0; n < SCRIPT_COMBO_BUDGET && combo.running && combo.wakeAt <= now; n++) {
+        if (ctx.currentLine >= ctx.program.size()) {
+            stopCombo(ctx, combo);  // unclosed combo ran off the end
+            break;
+        }
+        executeScriptStatement(ctx);
+        ctx.currentLine++;
+    }
+    combo.pc = ctx.currentLine;
+    ctx.currentLine = mainLine;
+    ctx.activeCombo = nullptr;
+}
+
+// One scheduler tick: every combo whose deadline has passed runs until
+// its next wait(), then the gamepad frame goes out if it changed. `start`
+// is when the tick's work began (the frame loop runs main first); the
+// tick's CPU time goes into the run statistics.
+static void scriptTick(ScriptContext& ctx, int64_t start) {
+    int64_t now = esp_timer_get_time();
+    for (size_t i = 0; i < ctx.combos.size(); i++) {
+        ScriptCombo& combo = ctx.combos[i];
+        if (combo.running && combo.wakeAt <= now) stepCombo(ctx, combo, now);
+    }
+    if (padFrameSend()) ctx.stats.reports++;
+    uint32_t us = esp_timer_get_time() - start;
+    ctx.stats.ticks++;
+    ctx.stats.tickUs += us;
+    if (us > ctx.stats.tickMaxUs) ctx.stats.tickMaxUs = us;
+    
+    // Missed ticks (the main script was busy) are dropped, not caught up
+    ctx.tickAt += ctx.tickUs;
+    if (ctx.tickAt <= start) ctx.tickAt = start + ctx.tickUs;
+}
+
+// wait() in the main script: keeps ticking combos until the deadline
+static void scriptWait(ScriptContext& ctx, int ms) {
+    int64_t until = esp_timer_get_time() + (int64_t)(ms > 0 ? ms : 0) * 1000;
+    while (tickPending(ctx)) {
+        int64_t now = esp_timer_get_time();
+        if (now >= ctx.tickAt) scriptTick(ctx, now);
+        if (esp_timer_get_time() >= until) return;
+        sleepUntil(ctx.tickAt < until ? ctx.tickAt : until);
+    }
+    sleepUntil(until);
+}
+
+// GPC main block: runs top to bottom once per tick, followed by the
+// combos and the gamepad frame, until the BOOT button is pressed (a
+// press still held from starting the script doesn't count) or BLE
+// sends STOP
+static void runMainBlock(ScriptContext& ctx) {
+    const ScriptStmt& header = ctx.program[ctx.mainLine];
+    bool released = false;
+    while (true) {
+        if (digitalRead(BOOT_BUTTON_PIN) == HIGH) released = true;
+        else if (released) break;
+        if (scriptStopRequested()) break;
+        sleepUntil(ctx.tickAt);
+        int64_t start = esp_timer_get_time();
+        for (ctx.currentLine = ctx.mainLine + 1; ctx.currentLine < header.jump; ctx.currentLine++) {
+            executeScriptStatement(ctx);
+        }
+        scriptTick(ctx, start);
+    }
+}
+
+// ------------------------------------------------------------------
+// Execution
+// ------------------------------------------------------------------
+
+// Statements that jump set currentLine to the target line; the run loop
+// then steps past it.
+
+static void runStatement(ScriptContext& ctx) {
+    const ScriptStmt& stmt = ctx.program[ctx.currentLine];
+    ctx.stats.statements++;
+    
+    switch (stmt.kind) {
+        case STMT_NOP:
+            break;
+            
+        case STMT_ASSIGN:
+            ctx.setVar(stmt.var, evaluateTimed(ctx, stmt.a));
+            break;
+            
+        case STMT_ASSIGN_STR:
+            ctx.setStringVar(stmt.var, ctx.text(stmt));
+            break;
+            
+        case STMT_IF:
+            if (!evaluateTimed(ctx, stmt.a)) {
+                ctx.currentLine = stmt.jump;  // ELSE (runs its branch) or ENDIF
+            }
+            break;
+            
+        case STMT_ELSE:
+            // End of the IF branch: skip the ELSE branch
+            ctx.currentLine = stmt.jump;
+            break;
+            
+        case STMT_ENDIF:
+            break;
+            
+        case STMT_LOOP: {
+            int count = evaluateTimed(ctx, stmt.a);
+            if (count > 0) {
+                ctx.setVar(stmt.var, count);
+            } else {
+                ctx.currentLine = stmt.jump;
+            }
+            break;
+        }
+            
+        case STMT_ENDLOOP:
+            if (--ctx.values[stmt.var] > 0) {
+                // Continue loop - jump back to loop start
+                ctx.currentLine = stmt.jump;
+            }
+            break;
+            
+        case STMT_FOR:
+            ctx.setVar(stmt.var, evaluateTimed(ctx, stmt.a));
+            ctx.setVar(stmt.limit, evaluateTimed(ctx, stmt.b));
+            if (ctx.getVar(stmt.var) > ctx.getVar(stmt.limit)) {
+                ctx.currentLine = stmt.jump;
+            }
+            break;
+            
+        case STMT_NEXT:
+            if (++ctx.values[stmt.var] <= ctx.getVar(stmt.limit)) {
+                ctx.currentLine = stmt.jump;
+            }
+            break;
+            
+        case STMT_WAIT: {
+            int ms = evaluateTimed(ctx, stmt.a);
+            if (ctx.activeCombo) {
+                comboWait(ctx, *ctx.activeCombo, ms);
+            } else {
+                scriptWait(ctx, ms);
             }
+            break;
+        }
+            
+        case STMT_SET_VAL: {
+            int value = evaluateTimed(ctx, stmt.a);
+            if (stmt.button != PAD_INPUT_NONE) padFrameSet(stmt.button, value);
+            break;
         }
+            
+        case STMT_COMBO:
+        case STMT_MAIN:
+            // Definitions only run through combo_run / the frame loop
+            ctx.currentLine = stmt.jump;
+            break;
+            
+        case STMT_BLOCK_END:
+            if (ctx.activeCombo) stopCombo(ctx, *ctx.activeCombo);
+            break;
+            
+        case STMT_COMBO_RUN:
+            startCombo(ctx, ctx.combos[stmt.var]);
+            break;
+            
+        case STMT_COMBO_STOP:
+            stopCombo(ctx, ctx.combos[stmt.var]);
+            break;
+            
+        case STMT_TEXT:
+            processMacroText(ctx.text(stmt), stmt.textLen);
+            break;
+    }
+}
+
+void executeScriptStatement(ScriptContext& ctx) {
+    if (!ctx.profiling) {
+        runStatement(ctx);
+        return;
+    }
+    size_t line = ctx.currentLine;
+    uint8_t kind = ctx.program[line].kind;
+    int64_t start = esp_timer_get_time();
+    runStatement(ctx);
+    uint32_t us = esp_timer_get_time() - start;
+    ctx.lineProfile[line].hits++;
+    ctx.lineProfile[line].us += us;
+    ctx.kindProfile[kind].hits++;
+    ctx.kindProfile[kind].us += us;
+}
+
+static ScriptStats lastRunStats;
+static bool profileNext = false;
+static ScriptProfile lastProfile;
+
+const ScriptStats& scriptLastRunStats() {
+    return lastRunStats;
+}
+
+// ------------------------------------------------------------------
+// Profiling
+// ------------------------------------------------------------------
+
+void scriptSetProfiling(bool on) {
+    profileNext = on;
+    if (on) memset(&lastProfile, 0, sizeof(lastProfile));
+}
+
+const ScriptProfile& scriptLastProfile() {
+    return lastProfile;
+}
+
+const char* scriptStmtKindName(uint8_t kind) {
+    static const char* const names[SCRIPT_STMT_KINDS] = {
+        "nop", "assign", "assign_str", "if", "else", "endif", "loop", "endloop",
+        "for", "next", "wait", "set_val", "combo", "main", "}", "combo_run",
+        "combo_stop", "text"
+    };
+    return kind < SCRIPT_STMT_KINDS ? names[kind] : "?";
+}
+
+// Keep the slowest lines (with the start of their source text, while the
+// arena is still there) and the per-kind totals
+static void saveProfile(const ScriptContext& ctx) {
+    memset(&lastProfile, 0, sizeof(lastProfile));
+    lastProfile.valid = true;
+    memcpy(lastProfile.kinds, ctx.kindProfile, sizeof(lastProfile.kinds));
+    
+    for (size_t i = 0; i < ctx.lineProfile.size(); i++) {
+        const ScriptProfileEntry& e = ctx.lineProfile[i];
+        if (e.hits == 0) continue;
+        lastProfile.linesHit++;
         
+        // Insertion into the top list, slowest first
+        uint16_t n = lastProfile.lineCount;
+        if (n == SCRIPT_PROFILE_TOP && e.us <= lastProfile.lines[n - 1].total.us) continue;
+        if (n < SCRIPT_PROFILE_TOP) lastProfile.lineCount++;
+        else n--;
+        while (n > 0 && lastProfile.lines[n - 1].total.us < e.us) {
+            lastProfile.lines[n] = lastProfile.lines[n - 1];
+            n--;
+        }
+        ScriptProfileLine& slot = lastProfile.lines[n];
+        slot.line = i + 1;
+        slot.total = e;
+        const char* text = ctx.arena.data() + ctx.lineStart[i];
+        while (*text == ' ' || *text == '\t') text++;
+        size_t len = 0;
+        while (len < SCRIPT_PROFILE_TEXT && text[len] != '\0' && text[len] != '\n' && text[len] != '\r') {
+            slot.text[len] = text[len] == '\t' ? ' ' : text[len];
+            len++;
+        }
+        slot.text[len] = '\0';
+    }
+}
+
+// Index, compile and run the script already loaded into ctx.arena; false
+// without running if its per-line tables don't fit in the heap (a failed
+// allocation aborts the firmware)
+static bool runScript(ScriptContext& ctx) {
+    char* text = ctx.arena.data();
+    size_t len = ctx.arena.size() - 1;  // without the final NUL
+    
+    // One statement per line, allocated up front
+    size_t count = 1;
+    for (size_t i = 0; i < len; i++) {
+        if (text[i] == '\n') count++;
+    }
+    if (count > SCRIPT_MAX_LINES) count = SCRIPT_MAX_LINES;
+    size_t perLine = sizeof(ScriptStmt);
+    if (profileNext) perLine += sizeof(uint32_t) + sizeof(ScriptProfileEntry);
+    if (count * perLine + SCRIPT_HEAP_RESERVE > ESP.getMaxAllocHeap()) return false;
+    ctx.program.resize(count);
+    ctx.profiling = profileNext;
+    if (ctx.profiling) {
+        ctx.lineStart.resize(count);
+        ctx.lineProfile.assign(count, ScriptProfileEntry());
+    }
+    
+    // Compile every line once, in place, then resolve block jumps
+    size_t start = 0;
+    for (size_t i = 0; i < count; i++) {
+        const char* nl = (const char*)memchr(text + start, '\n', len - start);
+        size_t end = nl ? nl - text : len;
+        if (ctx.profiling) ctx.lineStart[i] = start;
+        compileScriptLine(ctx, i, text + start, end - start);
+        start = end + 1;
+    }
+    linkScriptBlocks(ctx);
+    
+    // Execute lines (the init section when there is a main block)
+    uint32_t startMs = millis();
+    ctx.tickUs = (int64_t)tickMs * 1000;
+    padFrameBegin();
+    while (ctx.currentLine < ctx.program.size()) {
+        executeScriptStatement(ctx);
         ctx.currentLine++;
+        if (ctx.combosRunning > 0 && esp_timer_get_time() >= ctx.tickAt) {
+            scriptTick(ctx, esp_timer_get_time());
+        }
     }
+    
+    if (ctx.mainLine >= 0) runMainBlock(ctx);
+    
+    // Let running combos finish
+    while (ctx.combosRunning > 0) {
+        sleepUntil(ctx.tickAt);
+        scriptTick(ctx, esp_timer_get_time());
+    }
+    
+    // Release everything the script left held
+    padFrameReset();
+    if (padFrameSend()) ctx.stats.reports++;
+    ctx.stats.runMs = millis() - startMs;
+    lastRunStats = ctx.stats;
+    if (ctx.profiling) saveProfile(ctx);
+    return true;
+}
+
+// Execute advanced script
+void executeAdvancedScript(const String& script) {
+    ScriptContext ctx;
+    ctx.reset();
+    ctx.arena.resize(script.length() + 1);
+    memcpy(ctx.arena.data(), script.c_str(), script.length() + 1);
+    runScript(ctx);
+}
+
+// Read the rest of the file straight into the arena
+bool executeAdvancedScriptFile(File& f) {
+    size_t len = f.size() - f.position();
+    // A failed arena allocation aborts the firmware, so refuse first
+    if (len + 1 > ESP.getMaxAllocHeap()) return false;
+    ScriptContext ctx;
+    ctx.reset();
+    ctx.arena.resize(len + 1);
+    size_t got = 0;
+    while (got < len) {
+        int n = f.read((uint8_t*)ctx.arena.data() + got, len - got);
+        if (n <= 0) break;
+        got += n;
+    }
+    ctx.arena.resize(got + 1);
+    ctx.arena[got] = '\0';
+    return runScript(ctx);
+}
+
+// Case-insensitive search for an uppercase `word`, without copying
+static bool containsNoCase(const char* s, size_t len, const char* word) {
+    size_t n = strlen(word);
+    for (size_t i = 0; i + n <= len; i++) {
+        size_t j = 0;
+        while (j < n && toupper((unsigned char)s[i + j]) == word[j]) j++;
+        if (j == n) return true;
+    }
+    return false;
 }
 
 // Detect if script uses advanced features
+bool isAdvancedScript(const char* content, size_t len) {
+    static const char* const words[] = {"VAR ", "\nIF ", "LOOP ", "FOR ", "WAIT(", "SET_VAL(", "COMBO_RUN(", "MAIN {"};
+    for (const char* w : words) {
+        if (containsNoCase(content, len, w)) return true;
+    }
+    const char* eq = (const char*)memchr(content, '=', len);
+    return eq != nullptr && eq > content;  // Assignment operator
+}
+
 bool isAdvancedScript(const String& content) {
-    String upper = content;
-    upper.toUpperCase();
-    
-    return upper.indexOf("VAR ") >= 0 ||
-           upper.indexOf("\nIF ") >= 0 ||
-           upper.indexOf("LOOP ") >= 0 ||
-           upper.indexOf("FOR ") >= 0 ||
-           upper.indexOf("WAIT(") >= 0 ||
-           upper.indexOf("SET_VAL(") >= 0 ||
-           content.indexOf('=') > 0;  // Assignment operator
+    return isAdvancedScript(content.c_str(), content.length());
 }
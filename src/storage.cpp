@@ -11,6 +11,10 @@ extern int MENU_ITEM_COUNT;
 #define DEVSTORE_NAMESPACE "devstore"
 #define CDC_NAMESPACE "CDC"
 #define MSC_NAMESPACE "MSC"
+#define MOUSE_NAMESPACE "MOUSE"
+#define PLAYBACK_NAMESPACE "PLAYBACK"
+#define PLAYBACK_MIN_GAP_DEFAULT 5  // ms between events after speed scaling
+#define SCRIPT_TICK_DEFAULT 1       // ms per advanced-script scheduler tick
 
 void storeDeviceData(int index, const String &device, const String &password) {
   prefs.begin(DEVSTORE_NAMESPACE, false);  // writable
@@ -209,3 +213,60 @@ bool initializeMSCFlag() {
   prefs.end();
   return false;
 }
+
+bool setAbsMouseEnabled(bool value) {
+  prefs.begin(MOUSE_NAMESPACE, false);
+  prefs.putBool("absolute", value);
+  prefs.end();
+  return true;
+}
+
+bool getAbsMouseEnabled() {
+  prefs.begin(MOUSE_NAMESPACE, true);
+  bool enabled = prefs.getBool("absolute", false);
+  prefs.end();
+  return enabled;
+}
+
+bool setScreenSize(uint16_t width, uint16_t height) {
+  prefs.begin(MOUSE_NAMESPACE, false);
+  prefs.putInt("screenW", width);
+  prefs.putInt("screenH", height);
+  prefs.end();
+  return true;
+}
+
+void getScreenSize(uint16_t& width, uint16_t& height) {
+  prefs.begin(MOUSE_NAMESPACE, true);
+  width = (uint16_t)prefs.getInt("screenW", 1920);
+  height = (uint16_t)prefs.getInt("screenH", 1080);
+  prefs.end();
+}
+
+bool setPlaybackMinGap(uint16_t ms) {
+  prefs.begin(PLAYBACK_NAMESPACE, false);
+  prefs.putInt("minGap", ms);
+  prefs.end();
+  return true;
+}
+
+uint16_t getPlaybackMinGap() {
+  prefs.begin(PLAYBACK_NAMESPACE, true);
+  uint16_t ms = (uint16_t)prefs.getInt("minGap", PLAYBACK_MIN_GAP_DEFAULT);
+  prefs.end();
+  return ms;
+}
+
+bool setScriptTickMs(uint8_t ms) {
+  prefs.begin(PLAYBACK_NAMESPACE, false);
+  prefs.putInt("tickMs", ms);
+  prefs.end();
+  return true;
+}
+
+uint8_t getScriptTickMs() {
+  prefs.begin(PLAYBACK_NAMESPACE, true);
+  uint8_t ms = (uint8_t)prefs.getInt("tickMs", SCRIPT_TICK_DEFAULT);
+  prefs.end();
+  return ms;
+}
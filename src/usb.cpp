@@ -15,11 +15,19 @@
 #include "display.h"
 #include "duckyscript.h"
 #include "scriptengine.h"
+#include "macrovm.h"
+#include "macroopt.h"
+#include "macroindex.h"
+#include "hidtyper.h"
+#include "hidtask.h"
+#include "livectl.h"
+#include "absmouse.h"
 
 // External references (defined in main.cpp)
 extern USBHIDKeyboard Keyboard;
 extern USBHIDMouse Mouse;
 extern USBHIDGamepad Gamepad;
+extern USBHIDAbsMouse AbsMouse;
 
 // Runtime USB mode
 int currentUSBMode = MODE_HID;
@@ -28,12 +36,7 @@ static sdmmc_card_t* sdCard = nullptr;
 bool sdUseMMC = false;  // Non-static to allow extern access from bluetooth.cpp
 static bool sdReady = false;
 static SPIClass sdSPI(HSPI);
-
-// Mouse position tracking for absolute positioning
-static int mouseX = 0;
-static int mouseY = 0;
-static const int SCREEN_WIDTH = 1920;  // Default screen resolution
-static const int SCREEN_HEIGHT = 1080;
+static String playbackName;  // macro running on the background player
 
 // Command processing state
 enum SerialCmdState {
@@ -53,8 +56,14 @@ static File saveMacroFile;
 // Temp storage for operations
 static int candidateOldCode[4];
 
+// LIST page size (entries per reply)
+#define LIST_PAGE_DEFAULT 20
+#define LIST_PAGE_MAX 100
+
 // Forward declarations
 static bool ensureSDReady();
+static bool detectTextFileFormat(const String& baseName, MacroFileFormat& format);
+static fs::FS& sdFS();
 static sdmmc_card_t* getMMCCardPtr();
 static int32_t mscRead(uint32_t lba, uint32_t offset, void* buffer, uint32_t bufsize);
 static int32_t mscWrite(uint32_t lba, uint32_t offset, uint8_t* buffer, uint32_t bufsize);
@@ -77,12 +86,72 @@ static void parseFourDigitString(const String &s, int out[4]) {
 #include "bluetooth.h"
 // setCorrectCode and isAccessCode are declared in security.h
 
+// Deadline lateness of the last file playback (DELAY events only)
+static void sendPlaybackTiming() {
+  const MacroTiming& t = macroPlaybackTiming();
+  if (t.count() == 0) return;
+  sendBLEResponse("Timing: " + String(t.count()) + " events, error mean " + String(t.meanUs()) +
+                  " us, p99 " + String(t.percentileUs(99)) + " us, max " + String(t.maxUs()) + " us");
+}
+
+// Expression throughput of the last advanced script
+static void sendScriptStats() {
+  const ScriptStats& s = scriptLastRunStats();
+  sendBLEResponse("Script: " + String(s.statements) + " statements in " + String(s.runMs) + " ms, " +
+                  String(s.evals) + " evals, " + String(s.evalsPerSec()) + " evals/s");
+  if (s.ticks > 0) {
+    sendBLEResponse("Ticks: " + String(s.ticks) + " x " + String(scriptTickMs()) + " ms, mean " +
+                    String((uint32_t)(s.tickUs / s.ticks)) + " us, max " + String(s.tickMaxUs) + " us, " +
+                    String(s.reports) + " gamepad reports, peak " + String(s.comboPeak) + " combos");
+  }
+}
+
+// Per-line and per-kind table of the last PROFILE run, slowest lines first
+static void sendScriptProfile() {
+  const ScriptProfile& p = scriptLastProfile();
+  if (!p.valid) {
+    sendBLEResponse("ERROR: No profile (PROFILE applies to advanced scripts)");
+    return;
+  }
+  sendBLEResponse("OK: Profile: " + String(p.linesHit) + " lines run, slowest " + String(p.lineCount) + ":");
+  sendBLEResponse("  line hits us source");
+  for (uint16_t i = 0; i < p.lineCount; i++) {
+    const ScriptProfileLine& l = p.lines[i];
+    sendBLEResponse("  " + String(l.line) + " " + String(l.total.hits) + " " +
+                    String((uint32_t)l.total.us) + " " + String(l.text));
+  }
+  sendBLEResponse("  kind hits us");
+  for (uint8_t k = 0; k < SCRIPT_STMT_KINDS; k++) {
+    if (p.kinds[k].hits == 0) continue;
+    sendBLEResponse("  " + String(scriptStmtKindName(k)) + " " + String(p.kinds[k].hits) + " " +
+                    String((uint32_t)p.kinds[k].us));
+  }
+  // Expression time is part of the statements above; shown on its own
+  const ScriptStats& s = scriptLastRunStats();
+  if (s.evals > 0) {
+    sendBLEResponse("  (expr " + String(s.evals) + " " +
+                    String((uint32_t)(s.evalCycles / ESP.getCpuFreqMHz())) + ")");
+  }
+}
+
+// Queue live input for the HID task; the sender is told when it was
+// dropped because the task couldn't keep up
+static bool queueLiveInput(const String& text) {
+  if (hidQueueMacroText(text)) return true;
+  sendBLEResponse("ERROR: HID busy, input dropped");
+  return false;
+}
+
 void resetSerialState() {
   serialState = CMD_IDLE;
 }
 
 // BLE command processor (mirrors serial commands + keystroke relay)
 void processBLELine(const String& rawLine) {
+  // Compact Live Control frames go straight to the HID queue, before any
+  // command matching (see livectl.h)
+  if (serialState == CMD_IDLE && liveControlFrame(rawLine.c_str(), rawLine.length())) return;
+
   // Check if line ends with \r (CRLF from terminal)
   bool hadCR = false;
   if (rawLine.length() > 0 && rawLine.charAt(rawLine.length() - 1) == '\r') {
@@ -107,12 +176,19 @@ void processBLELine(const String& rawLine) {
       sendBLEResponse("  CHANGELOGIN - change the 4-digit login code");
       sendBLEResponse("  RECORD:filename - start macro recording");
       sendBLEResponse("  STOPRECORD - stop macro recording");
-      sendBLEResponse("  PLAY:filename - play/execute a macro file");
-      sendBLEResponse("  LIST - list macro files on SD card");
+      sendBLEResponse("  PLAY:filename[@2x] - play/execute a macro file (optional speed)");
+      sendBLEResponse("  STOP - abort playback or a script main block (or stop recording)");
+      sendBLEResponse("  STATUS - show playback progress and queue stats");
+      sendBLEResponse("  LIST[:offset,count[,prefix]] - list macro files (paged)");
+      sendBLEResponse("  REINDEX - rebuild the macro file index");
       sendBLEResponse("  SAVE_MACRO:filename - save macro from BLE to SD card");
       sendBLEResponse("  KEY:keyname - record key press");
       sendBLEResponse("  MOUSE:action - record mouse action");
       sendBLEResponse("  TYPE:text - record text typing");
+      sendBLEResponse("  MINGAP:ms - minimum gap between events for PLAY:name@2x");
+      sendBLEResponse("  GPCTICK:1/4/8 - frame tick (ms) for GPC scripts");
+      sendBLEResponse("  PROFILE:filename - run a script, report time per line");
+      sendBLEResponse("  OPTIMIZE:filename[,slackMs] - shrink a recorded macro");
       sendBLEResponse("Mouse commands:");
       sendBLEResponse("  MOUSE:RESET - move to (0,0)");
       sendBLEResponse("  MOUSE:MOVE:x,y - absolute position");
@@ -120,6 +196,10 @@ void processBLELine(const String& rawLine) {
       sendBLEResponse("  MOUSE:CLICK:left/right/middle");
       sendBLEResponse("  MOUSE:DOWN:button / MOUSE:UP:button");
       sendBLEResponse("  MOUSE:SCROLL:amount");
+      sendBLEResponse("  ABSMOUSE:ON/OFF/WxH - absolute pointer for MOVE/RESET");
+      sendBLEResponse("Live Control frames (no reply):");
+      sendBLEResponse("  K:code:D / K:code:U - key down/up (Android keycode, char or key name)");
+      sendBLEResponse("  M:dx:dy[:L|R|M|W:+/-] - move, then left/right click, move only or scroll");
       sendBLEResponse("Macro syntax: {{KEY:name}}, {{DELAY:ms}}, {{MOUSE:...}}, {{GAMEPAD:...}}, {{AUDIO:...}}");
       sendBLEResponse("Any text without command prefix is typed via USB HID");
       sendBLEResponse("Usage: send command, then follow prompts from device");
@@ -154,11 +234,152 @@ void processBLELine(const String& rawLine) {
       return;
     }
     
+    // STOP aborts a running macro first; otherwise it ends recording
+    if (line.equalsIgnoreCase("STOP") && macroPlaybackActive()) {
+      macroPlaybackStop();
+      sendBLEResponse("OK: Playback stopped");
+      return;
+    }
+    
     if (line.equalsIgnoreCase("STOPRECORD") || line.equalsIgnoreCase("STOP")) {
       stopMacroRecording();
       return;
     }
     
+    // ABSMOUSE[:ON|OFF|WxH] - absolute pointer for MOUSE:MOVE/RESET
+    if (line.equalsIgnoreCase("ABSMOUSE") || line.startsWith("ABSMOUSE:") || line.startsWith("absmouse:")) {
+      String arg = line.length() > 9 ? line.substring(9) : "";
+      arg.trim();
+      bool enabled = getAbsMouseEnabled();
+      uint16_t screenW, screenH;
+      getScreenSize(screenW, screenH);
+      int x = arg.indexOf('x');
+      if (arg.equalsIgnoreCase("ON") || arg.equalsIgnoreCase("OFF")) {
+        enabled = arg.equalsIgnoreCase("ON");
+        setAbsMouseEnabled(enabled);
+      } else if (x > 0) {
+        long w = arg.substring(0, x).toInt();
+        long h = arg.substring(x + 1).toInt();
+        if (w < 2 || h < 2 || w > 16384 || h > 16384) {
+          sendBLEResponse("ERROR: Usage: ABSMOUSE:ON, ABSMOUSE:OFF or ABSMOUSE:1920x1080");
+          return;
+        }
+        screenW = (uint16_t)w;
+        screenH = (uint16_t)h;
+        setScreenSize(screenW, screenH);
+      } else if (arg.length() > 0) {
+        sendBLEResponse("ERROR: Usage: ABSMOUSE:ON, ABSMOUSE:OFF or ABSMOUSE:1920x1080");
+        return;
+      }
+      absMouseConfigure(enabled, screenW, screenH);
+      sendBLEResponse(String("OK: Absolute mouse ") + (enabled ? "ON" : "OFF") + " (" +
+                      String(screenW) + "x" + String(screenH) + ")");
+      return;
+    }
+    
+    if (line.equalsIgnoreCase("STATUS")) {
+      if (macroPlaybackActive()) {
+        sendBLEResponse("OK: Playing " + playbackName + " - " + String(macroPlaybackElapsedMs()) +
+                        " ms, " + String(macroPlaybackOps()) + " ops");
+      } else {
+        sendBLEResponse("OK: Idle");
+      }
+      sendPlaybackTiming();
+      RingStats rx = bleRxQueueStats();
+      RingStats hid = hidQueueStats();
+      sendBLEResponse("Queue rx: " + String(rx.depth) + "/" + String(rx.capacity) + " B, peak " +
+                      String(rx.highWater) + ", dropped " + String(rx.dropped));
+      sendBLEResponse("Queue hid: " + String(hid.depth) + "/" + String(hid.capacity) + " B, peak " +
+                      String(hid.highWater) + ", dropped " + String(hid.dropped));
+      return;
+    }
+    
+    // OPTIMIZE:name[,slackMs] - rewrite a macro file into a smaller equivalent
+    if (line.startsWith("OPTIMIZE:") || line.startsWith("optimize:")) {
+      String name = line.substring(9);
+      name.trim();
+      uint16_t slackMs = 0;
+      int comma = name.indexOf(',');
+      if (comma > 0) {
+        long slack = name.substring(comma + 1).toInt();
+        slackMs = (uint16_t)(slack < 0 ? 0 : (slack > 1000 ? 1000 : slack));
+        name = name.substring(0, comma);
+        name.trim();
+      }
+      if (name.endsWith(".txt")) name = name.substring(0, name.length() - 4);
+      if (name.length() == 0) {
+        sendBLEResponse("ERROR: Usage: OPTIMIZE:filename[,slackMs]");
+        return;
+      }
+      if (macroPlaybackActive()) {
+        sendBLEResponse("ERROR: Playback in progress (send STOP)");
+        return;
+      }
+      if (!ensureSDReady()) {
+        sendBLEResponse("ERROR: SD card not available");
+        return;
+      }
+      String path = "/" + name + ".txt";
+      MacroFileFormat format;
+      if (!detectTextFileFormat(name, format)) {
+        sendBLEResponse("ERROR: File not found: " + name);
+        return;
+      }
+      if (format != MACRO_FORMAT_MACRO) {
+        sendBLEResponse("ERROR: Only macro-format files can be optimized");
+        return;
+      }
+      MacroOptStats st;
+      uint32_t bytesIn = 0;
+      bool optimized = macroOptimizeFile(sdFS(), path, slackMs, st, bytesIn);
+      macroIndexUpdate(sdFS(), name);
+      if (!optimized) {
+        sendBLEResponse("ERROR: Optimize failed (original kept)");
+        return;
+      }
+      int sizePct = bytesIn ? (int)(100 - (uint64_t)st.bytesOut * 100 / bytesIn) : 0;
+      int timePct = st.playMsIn ? (int)(100 - (uint64_t)st.playMsOut * 100 / st.playMsIn) : 0;
+      sendBLEResponse("OK: Optimized " + name + " (original saved as " + name + ".bak)");
+      sendBLEResponse("Size: " + String(bytesIn) + " -> " + String(st.bytesOut) + " bytes (-" +
+                      String(sizePct) + "%), events " + String(st.eventsIn) + " -> " + String(st.eventsOut));
+      sendBLEResponse("Play time: " + String(st.playMsIn) + " -> " + String(st.playMsOut) + " ms (-" +
+                      String(timePct) + "%)");
+      return;
+    }
+    
+    // MINGAP[:ms] - shortest pause between macro events after speed scaling
+    if (line.equalsIgnoreCase("MINGAP") || line.startsWith("MINGAP:") || line.startsWith("mingap:")) {
+      if (line.length() > 7) {
+        String arg = line.substring(7);
+        arg.trim();
+        long ms = arg.toInt();
+        if (ms < 0 || ms > 1000 || (ms == 0 && arg != "0")) {
+          sendBLEResponse("ERROR: Usage: MINGAP:ms (0-1000)");
+          return;
+        }
+        setPlaybackMinGap((uint16_t)ms);
+      }
+      sendBLEResponse("OK: Minimum event gap " + String(getPlaybackMinGap()) + " ms");
+      return;
+    }
+    
+    // GPCTICK[:ms] - scheduler tick of advanced scripts: combos, the GPC
+    // main block and gamepad reports (1 ms matches a 1000 Hz USB poll)
+    if (line.equalsIgnoreCase("GPCTICK") || line.startsWith("GPCTICK:") || line.startsWith("gpctick:")) {
+      if (line.length() > 8) {
+        String arg = line.substring(8);
+        arg.trim();
+        long ms = arg.toInt();
+        if (ms != 1 && ms != 4 && ms != 8) {
+          sendBLEResponse("ERROR: Usage: GPCTICK:ms (1, 4 or 8)");
+          return;
+        }
+        setScriptTickMs((uint8_t)ms);
+      }
+      sendBLEResponse("OK: GPC tick " + String(getScriptTickMs()) + " ms");
+      return;
+    }
+    
     // Macro playback commands
     if (line.startsWith("PLAY:") || line.startsWith("play:")) {
       String filename = line.substring(5);
@@ -167,35 +388,139 @@ void processBLELine(const String& rawLine) {
         sendBLEResponse("ERROR: Filename required. Usage: PLAY:filename");
         return;
       }
+      // Optional speed factor: PLAY:name@2x, PLAY:name@0.5x
+      uint16_t tempoPct = 100;
+      int at = filename.lastIndexOf('@');
+      if (at > 0) {
+        String factor = filename.substring(at + 1);
+        filename = filename.substring(0, at);
+        filename.trim();
+        if (factor.endsWith("x") || factor.endsWith("X")) factor = factor.substring(0, factor.length() - 1);
+        long pct = (long)(factor.toFloat() * 100 + 0.5f);
+        if (pct < MACRO_TEMPO_MIN || pct > MACRO_TEMPO_MAX) {
+          sendBLEResponse("ERROR: Speed must be 0.1x to 20x (e.g. PLAY:name@2x)");
+          return;
+        }
+        tempoPct = (uint16_t)pct;
+      }
       // Remove .txt extension if present (processTextFileAuto adds it)
       if (filename.endsWith(".txt")) {
         filename = filename.substring(0, filename.length() - 4);
       }
+      if (macroPlaybackActive()) {
+        sendBLEResponse("ERROR: Playback in progress (send STOP)");
+        return;
+      }
+      // Macro files run in the background so STOP/STATUS stay responsive;
+      // scripts still execute synchronously
+      PlaybackStart started = startMacroPlayback(filename, tempoPct);
+      if (started == PLAYBACK_NO_SD) {
+        sendBLEResponse("ERROR: SD card not available");
+        return;
+      }
+      if (started == PLAYBACK_CACHE_FAILED) {
+        sendBLEResponse("ERROR: Cache write failed for " + filename + ".mbc (card full or read-only?)");
+        return;
+      }
       sendBLEResponse("OK: Playing " + filename);
+      if (started == PLAYBACK_STARTED) return;
+      if (tempoPct != 100) sendBLEResponse("Note: speed factor applies to macro files only");
       processTextFileAuto(filename);
       sendBLEResponse("OK: Playback complete");
       return;
     }
     
-    if (line.equalsIgnoreCase("LIST")) {
+    // PROFILE:filename - run an advanced script with every statement timed
+    if (line.startsWith("PROFILE:") || line.startsWith("profile:")) {
+      String filename = line.substring(8);
+      filename.trim();
+      if (filename.endsWith(".txt")) {
+        filename = filename.substring(0, filename.length() - 4);
+      }
+      if (filename.length() == 0) {
+        sendBLEResponse("ERROR: Filename required. Usage: PROFILE:filename");
+        return;
+      }
+      if (macroPlaybackActive()) {
+        sendBLEResponse("ERROR: Playback in progress (send STOP)");
+        return;
+      }
+      sendBLEResponse("OK: Profiling " + filename);
+      scriptSetProfiling(true);
+      processTextFileAuto(filename);
+      scriptSetProfiling(false);
+      sendScriptProfile();
+      return;
+    }
+    
+    // LIST[:offset,count[,prefix]] - one page of the macro index; the
+    // trailer names the command for the next page
+    if (line.equalsIgnoreCase("LIST") || line.startsWith("LIST:") || line.startsWith("list:")) {
+      uint32_t offset = 0;
+      uint32_t count = LIST_PAGE_DEFAULT;
+      String prefix = "";
+      if (line.length() > 5) {
+        String args = line.substring(5);
+        int c1 = args.indexOf(',');
+        int c2 = c1 >= 0 ? args.indexOf(',', c1 + 1) : -1;
+        long off = args.substring(0, c1 >= 0 ? c1 : args.length()).toInt();
+        long cnt = c1 >= 0 ? args.substring(c1 + 1, c2 >= 0 ? c2 : args.length()).toInt() : LIST_PAGE_DEFAULT;
+        if (c2 >= 0) {
+          prefix = args.substring(c2 + 1);
+          prefix.trim();
+          if (prefix.startsWith("/")) prefix = prefix.substring(1);
+        }
+        if (off < 0 || cnt < 1 || cnt > LIST_PAGE_MAX) {
+          sendBLEResponse("ERROR: Usage: LIST:offset,count[,prefix] (count 1-" + String(LIST_PAGE_MAX) + ")");
+          return;
+        }
+        offset = (uint32_t)off;
+        count = (uint32_t)cnt;
+      }
       if (!ensureSDReadyForRecording()) {
         sendBLEResponse("ERROR: SD card not available");
         return;
       }
+      MacroIndexCursor cur;
+      if (!macroIndexBegin(sdFS(), cur, offset, prefix)) {
+        sendBLEResponse("ERROR: Could not read macro index");
+        return;
+      }
       sendBLEResponse("OK: Listing macro files:");
-      String fileList[15];
-      int fileCount = 0;
-      listSDTextFiles(fileList, fileCount);
-      if (fileCount == 0) {
-        sendBLEResponse("  (no files found)");
+      MacroIndexEntry entry;
+      uint32_t shown = 0;
+      while (shown < count && macroIndexNext(cur, entry)) {
+        sendBLEResponse("  " + String(cur.last + 1) + ". " + String(entry.name) + " (" +
+                        macroFormatName(entry.format) + ", " + String(entry.size) + " B)");
+        shown++;
+      }
+      // Only promise another page if one more match exists
+      bool more = shown == count && macroIndexNext(cur, entry);
+      macroIndexEnd(cur);
+      if (shown == 0) sendBLEResponse("  (no files found)");
+      if (more) {
+        sendBLEResponse("OK: More - LIST:" + String(cur.last) + "," + String(count) +
+                        (prefix.length() ? "," + prefix : String("")));
       } else {
-        for (int i = 0; i < fileCount; i++) {
-          sendBLEResponse("  " + String(i+1) + ". " + fileList[i]);
-        }
+        sendBLEResponse("OK: End of list (" + String(macroIndexCount()) + " files indexed)");
       }
       return;
     }
     
+    // REINDEX - rebuild the macro index after files changed behind our back
+    if (line.equalsIgnoreCase("REINDEX")) {
+      if (!ensureSDReadyForRecording()) {
+        sendBLEResponse("ERROR: SD card not available");
+        return;
+      }
+      if (!macroIndexRebuild(sdFS())) {
+        sendBLEResponse("ERROR: Could not write macro index");
+        return;
+      }
+      sendBLEResponse("OK: Indexed " + String(macroIndexCount()) + " macro files");
+      return;
+    }
+    
     // VIEW:filename - read and send macro file content to app
     if (line.startsWith("VIEW:") || line.startsWith("view:")) {
       String filename = line.substring(5);
@@ -245,9 +570,16 @@ void processBLELine(const String& rawLine) {
         sendBLEResponse("ERROR: Filename required. Usage: SAVE_MACRO:filename");
         return;
       }
-      // Ensure .txt extension
-      if (!filename.endsWith(".txt")) {
-        filename += ".txt";
+      // SD paths are absolute: "/name.txt" or "/folder/name.txt"
+      if (filename.endsWith(".txt")) {
+        filename = filename.substring(0, filename.length() - 4);
+      }
+      if (filename.startsWith("/")) {
+        filename = filename.substring(1);
+      }
+      if (filename.length() >= MACRO_INDEX_NAME_MAX) {
+        sendBLEResponse("ERROR: Filename too long");
+        return;
       }
       if (!ensureSDReadyForRecording()) {
         sendBLEResponse("ERROR: SD card not available");
@@ -256,10 +588,13 @@ void processBLELine(const String& rawLine) {
       // Start receiving macro content
       serialState = CMD_SAVE_MACRO;
       saveMacroFilename = filename;
+      String path = "/" + filename + ".txt";
+      macroMakeParentDirs(sdFS(), path);
+      macroInvalidateCache(sdFS(), path);
       if (sdUseMMC) {
-        saveMacroFile = SD_MMC.open(filename.c_str(), FILE_WRITE);
+        saveMacroFile = SD_MMC.open(path.c_str(), FILE_WRITE);
       } else {
-        saveMacroFile = SD.open(filename.c_str(), FILE_WRITE);
+        saveMacroFile = SD.open(path.c_str(), FILE_WRITE);
       }
       if (!saveMacroFile) {
         sendBLEResponse("ERROR: Could not open file for writing");
@@ -278,7 +613,8 @@ void processBLELine(const String& rawLine) {
           saveMacroFile.close();
         }
         serialState = CMD_IDLE;
-        sendBLEResponse("OK: Macro saved as " + saveMacroFilename);
+        macroIndexUpdate(sdFS(), saveMacroFilename);
+        sendBLEResponse("OK: Macro saved as " + saveMacroFilename + ".txt");
         saveMacroFilename = "";
         return;
       }
@@ -296,8 +632,7 @@ void processBLELine(const String& rawLine) {
         keyName.trim();
         recordAction("{{KEY:" + keyName + "}}");
         // Execute in real-time for passthrough
-        processMacroText("{{KEY:" + keyName + "}}");
-        sendBLEResponse("OK: Recorded & executed key");
+        if (queueLiveInput("{{KEY:" + keyName + "}}")) sendBLEResponse("OK: Recorded & executed key");
         return;
       }
       
@@ -329,7 +664,7 @@ void processBLELine(const String& rawLine) {
           }
         }
         
-        processMacroText("{{MOUSE:" + executionAction + "}}");
+        queueLiveInput("{{MOUSE:" + executionAction + "}}");
         return;
       }
       
@@ -338,8 +673,7 @@ void processBLELine(const String& rawLine) {
         // Don't trim - preserve spaces
         recordAction(text);
         // Execute in real-time for passthrough
-        processMacroText(text);
-        sendBLEResponse("OK: Recorded & executed text");
+        if (queueLiveInput(text)) sendBLEResponse("OK: Recorded & executed text");
         return;
       }
       
@@ -348,16 +682,14 @@ void processBLELine(const String& rawLine) {
         gamepadAction.trim();
         recordAction("{{GAMEPAD:" + gamepadAction + "}}");
         // Execute in real-time for passthrough
-        processMacroText("{{GAMEPAD:" + gamepadAction + "}}");
-        sendBLEResponse("OK: Recorded & executed gamepad");
+        if (queueLiveInput("{{GAMEPAD:" + gamepadAction + "}}")) sendBLEResponse("OK: Recorded & executed gamepad");
         return;
       }
       
       // In recording mode, treat any other text as literal typing
       recordAction(line);
       // Execute in real-time for passthrough
-      processMacroText(line);
-      sendBLEResponse("OK: Recorded & executed");
+      if (queueLiveInput(line)) sendBLEResponse("OK: Recorded & executed");
       return;
     }
     
@@ -395,7 +727,7 @@ void processBLELine(const String& rawLine) {
         keyAction = keyAction.substring(0, keyAction.length() - 3);
       }
       
-      processMacroText("{{KEY:" + keyAction + "}}");
+      queueLiveInput("{{KEY:" + keyAction + "}}");
       // Skip BLE response for KEY commands to reduce latency
       return;
     }
@@ -443,11 +775,11 @@ void processBLELine(const String& rawLine) {
         Serial.print("DEBUG: converted=");
         Serial.println(convertedAction);
         
-        processMacroText("{{MOUSE:" + convertedAction + "}}");
+        queueLiveInput("{{MOUSE:" + convertedAction + "}}");
       } else {
         // Fallback for other formats
         Serial.println("DEBUG: Using fallback format");
-        processMacroText("{{MOUSE:" + mouseAction + "}}");
+        queueLiveInput("{{MOUSE:" + mouseAction + "}}");
       }
       
       // Skip BLE response for mouse commands to reduce latency
@@ -457,16 +789,14 @@ void processBLELine(const String& rawLine) {
     if (line.startsWith("TYPE:") || line.startsWith("type:")) {
       String text = line.substring(5);
       // Don't trim - preserve spaces
-      processMacroText(text);
-      sendBLEResponse("OK: Text sent");
+      if (queueLiveInput(text)) sendBLEResponse("OK: Text sent");
       return;
     }
     
     if (line.startsWith("GAMEPAD:") || line.startsWith("gamepad:")) {
       String gamepadAction = line.substring(8);
       gamepadAction.trim();
-      processMacroText("{{GAMEPAD:" + gamepadAction + "}}");
-      sendBLEResponse("OK: Gamepad action sent");
+      if (queueLiveInput("{{GAMEPAD:" + gamepadAction + "}}")) sendBLEResponse("OK: Gamepad action sent");
       return;
     }
     
@@ -475,12 +805,8 @@ void processBLELine(const String& rawLine) {
       Serial.print("Processing as macro text: ");
       Serial.println(line);
       // If original line ended with \r (CRLF from terminal), append Enter keypress
-      if (hadCR) {
-        processMacroText(line + "{{KEY:enter}}");
-      } else {
-        processMacroText(line);
-      }
-      sendBLEResponse("OK: Processed");
+      bool queued = hadCR ? queueLiveInput(line + "{{KEY:enter}}") : queueLiveInput(line);
+      if (queued) sendBLEResponse("OK: Processed");
     }
     return;
   }
@@ -678,6 +1004,10 @@ void startUSBMode(int mode) {
     Keyboard.begin();
     Mouse.begin();
     Gamepad.begin();
+    AbsMouse.begin();
+    uint16_t screenW, screenH;
+    getScreenSize(screenW, screenH);
+    absMouseConfigure(getAbsMouseEnabled(), screenW, screenH);
     currentUSBMode = MODE_HID;
 
   } else if (mode == MODE_CDC) {
@@ -719,6 +1049,8 @@ void startUSBMode(int mode) {
     MSC.onRead(mscRead);
     MSC.onWrite(mscWrite);
     MSC.onStartStop(mscStartStop);
+    // The host can change any file while exported; rebuild on next use
+    macroIndexDrop(SD_MMC);
     MSC.mediaPresent(true);
     MSC.begin(sectorCount, (uint16_t)sectorSize);
     USB.begin();
@@ -731,7 +1063,9 @@ void sendPassword(String password) {
   delay(1000);
   startUSBMode(MODE_HID);
 
-  Keyboard.println(password); // Types the string and presses Enter
+  // Raw reports paced by host polling, then Enter
+  hidTypeText(password, false, 0);
+  hidTypeText("\n", false, 0);
 
   // Visual feedback on screen
   showPasswordSentScreen(password);
@@ -769,6 +1103,12 @@ static sdmmc_card_t* getMMCCardPtr() {
   return reinterpret_cast<SDMMCAccess*>(&SD_MMC)->getCardPtr();
 }
 
+// Whichever SD backend ensureSDReady() brought up
+static fs::FS& sdFS() {
+  if (sdUseMMC) return SD_MMC;
+  return SD;
+}
+
 static bool ensureSDReady() {
   // Try SD_MMC with known board pins first; if that fails, try SPI SD.
   if (sdReady) return true;
@@ -833,489 +1173,24 @@ static bool mscStartStop(uint8_t power_condition, bool start, bool load_eject) {
   return true;
 }
 
-// Process macro text: parses {{TOKEN}} syntax and types via USB HID
-// Used by both BLE commands and SD file typing
+// Process macro text: parses {{TOKEN}} syntax and types via USB HID.
+// Shares the streaming tokenizer/compiler with SD playback; opcodes are
+// executed as they are produced, so nothing is buffered per character.
 void processMacroText(const String& text) {
+  processMacroText(text.c_str(), text.length());
+}
+
+void processMacroText(const char* text, size_t len) {
   // Only initialize USB HID if not already active (avoid reinitialization overhead)
   if (currentUSBMode != MODE_HID) {
     startUSBMode(MODE_HID);
   }
 
-  int speedMs = 3;
-  bool inToken = false;
-  bool sawFirstBrace = false;
-  String token;
-
-  // sendKeyByName lambda - optimized for Live Control with reduced delay (20ms vs 50ms)
-  auto sendKeyByName = [](String keyName) {
-    String key = keyName; key.toLowerCase();
-    if (key == "enter" || key == "return") { Keyboard.press(KEY_RETURN); delay(10); Keyboard.release(KEY_RETURN); }
-    else if (key == "backspace") { Keyboard.press(KEY_BACKSPACE); delay(10); Keyboard.release(KEY_BACKSPACE); }
-    else if (key == "delete") { Keyboard.press(KEY_DELETE); delay(10); Keyboard.release(KEY_DELETE); }
-    else if (key == "tab") { Keyboard.press(KEY_TAB); delay(10); Keyboard.release(KEY_TAB); }
-    else if (key == "space") { Keyboard.press(' '); delay(10); Keyboard.release(' '); }
-    else if (key == "escape" || key == "esc") { Keyboard.press(KEY_ESC); delay(10); Keyboard.release(KEY_ESC); }
-    else if (key == "up") { Keyboard.press(KEY_UP_ARROW); delay(10); Keyboard.release(KEY_UP_ARROW); }
-    else if (key == "down") { Keyboard.press(KEY_DOWN_ARROW); delay(10); Keyboard.release(KEY_DOWN_ARROW); }
-    else if (key == "left") { Keyboard.press(KEY_LEFT_ARROW); delay(10); Keyboard.release(KEY_LEFT_ARROW); }
-    else if (key == "right") { Keyboard.press(KEY_RIGHT_ARROW); delay(10); Keyboard.release(KEY_RIGHT_ARROW); }
-    else if (key == "home") { Keyboard.press(KEY_HOME); delay(10); Keyboard.release(KEY_HOME); }
-    else if (key == "end") { Keyboard.press(KEY_END); delay(10); Keyboard.release(KEY_END); }
-    else if (key == "pageup") { Keyboard.press(KEY_PAGE_UP); delay(10); Keyboard.release(KEY_PAGE_UP); }
-    else if (key == "pagedown") { Keyboard.press(KEY_PAGE_DOWN); delay(10); Keyboard.release(KEY_PAGE_DOWN); }
-    else if (key == "f1") { Keyboard.press(KEY_F1); delay(10); Keyboard.release(KEY_F1); }
-    else if (key == "f2") { Keyboard.press(KEY_F2); delay(10); Keyboard.release(KEY_F2); }
-    else if (key == "f3") { Keyboard.press(KEY_F3); delay(10); Keyboard.release(KEY_F3); }
-    else if (key == "f4") { Keyboard.press(KEY_F4); delay(10); Keyboard.release(KEY_F4); }
-    else if (key == "f5") { Keyboard.press(KEY_F5); delay(10); Keyboard.release(KEY_F5); }
-    else if (key == "f6") { Keyboard.press(KEY_F6); delay(10); Keyboard.release(KEY_F6); }
-    else if (key == "f7") { Keyboard.press(KEY_F7); delay(10); Keyboard.release(KEY_F7); }
-    else if (key == "f8") { Keyboard.press(KEY_F8); delay(10); Keyboard.release(KEY_F8); }
-    else if (key == "f9") { Keyboard.press(KEY_F9); delay(10); Keyboard.release(KEY_F9); }
-    else if (key == "f10") { Keyboard.press(KEY_F10); delay(10); Keyboard.release(KEY_F10); }
-    else if (key == "f11") { Keyboard.press(KEY_F11); delay(10); Keyboard.release(KEY_F11); }
-    else if (key == "f12") { Keyboard.press(KEY_F12); delay(10); Keyboard.release(KEY_F12); }
-    #ifdef KEY_CAPS_LOCK
-    else if (key == "capslock" || key == "caps") { Keyboard.press(KEY_CAPS_LOCK); delay(10); Keyboard.release(KEY_CAPS_LOCK); }
-    #endif
-    #ifdef KEY_NUM_LOCK
-    else if (key == "numlock" || key == "num") { Keyboard.press(KEY_NUM_LOCK); delay(10); Keyboard.release(KEY_NUM_LOCK); }
-    #endif
-    #ifdef KEY_SCROLL_LOCK
-    else if (key == "scrolllock" || key == "scroll") { Keyboard.press(KEY_SCROLL_LOCK); delay(10); Keyboard.release(KEY_SCROLL_LOCK); }
-    #endif
-    #ifdef KEY_PRINT_SCREEN
-    else if (key == "printscreen" || key == "print") { Keyboard.press(KEY_PRINT_SCREEN); delay(10); Keyboard.release(KEY_PRINT_SCREEN); }
-    #endif
-    #ifdef KEY_PAUSE
-    else if (key == "pause" || key == "break") { Keyboard.press(KEY_PAUSE); delay(10); Keyboard.release(KEY_PAUSE); }
-    #endif
-    else if (key == "insert" || key == "ins") { Keyboard.press(KEY_INSERT); delay(10); Keyboard.release(KEY_INSERT); }
-    else if (key == "win" || key == "windows") { Keyboard.press(KEY_LEFT_GUI); delay(10); Keyboard.release(KEY_LEFT_GUI); }
-    else if (key == "rwin" || key == "rwindows") { Keyboard.press(KEY_RIGHT_GUI); delay(10); Keyboard.release(KEY_RIGHT_GUI); }
-    #ifdef KEY_MENU
-    else if (key == "menu" || key == "app") { Keyboard.press(KEY_MENU); delay(10); Keyboard.release(KEY_MENU); }
-    #endif
-    #ifdef KEY_KP_0
-    else if (key == "kp0" || key == "numpad0") { Keyboard.press(KEY_KP_0); delay(10); Keyboard.release(KEY_KP_0); }
-    else if (key == "kp1" || key == "numpad1") { Keyboard.press(KEY_KP_1); delay(10); Keyboard.release(KEY_KP_1); }
-    else if (key == "kp2" || key == "numpad2") { Keyboard.press(KEY_KP_2); delay(10); Keyboard.release(KEY_KP_2); }
-    else if (key == "kp3" || key == "numpad3") { Keyboard.press(KEY_KP_3); delay(10); Keyboard.release(KEY_KP_3); }
-    else if (key == "kp4" || key == "numpad4") { Keyboard.press(KEY_KP_4); delay(10); Keyboard.release(KEY_KP_4); }
-    else if (key == "kp5" || key == "numpad5") { Keyboard.press(KEY_KP_5); delay(10); Keyboard.release(KEY_KP_5); }
-    else if (key == "kp6" || key == "numpad6") { Keyboard.press(KEY_KP_6); delay(10); Keyboard.release(KEY_KP_6); }
-    else if (key == "kp7" || key == "numpad7") { Keyboard.press(KEY_KP_7); delay(10); Keyboard.release(KEY_KP_7); }
-    else if (key == "kp8" || key == "numpad8") { Keyboard.press(KEY_KP_8); delay(10); Keyboard.release(KEY_KP_8); }
-    else if (key == "kp9" || key == "numpad9") { Keyboard.press(KEY_KP_9); delay(10); Keyboard.release(KEY_KP_9); }
-    else if (key == "kp_add" || key == "numpad_add") { Keyboard.press(KEY_KP_ADD); delay(10); Keyboard.release(KEY_KP_ADD); }
-    else if (key == "kp_subtract" || key == "numpad_subtract") { Keyboard.press(KEY_KP_SUBTRACT); delay(10); Keyboard.release(KEY_KP_SUBTRACT); }
-    else if (key == "kp_multiply" || key == "numpad_multiply") { Keyboard.press(KEY_KP_MULTIPLY); delay(10); Keyboard.release(KEY_KP_MULTIPLY); }
-    else if (key == "kp_divide" || key == "numpad_divide") { Keyboard.press(KEY_KP_DIVIDE); delay(10); Keyboard.release(KEY_KP_DIVIDE); }
-    else if (key == "kp_decimal" || key == "numpad_decimal" || key == "kp_dot") { Keyboard.press(KEY_KP_DECIMAL); delay(10); Keyboard.release(KEY_KP_DECIMAL); }
-    else if (key == "kp_enter" || key == "numpad_enter") { Keyboard.press(KEY_KP_ENTER); delay(10); Keyboard.release(KEY_KP_ENTER); }
-    #endif
-    else if (key == "rctrl" || key == "rcontrol") { Keyboard.press(KEY_RIGHT_CTRL); delay(10); Keyboard.release(KEY_RIGHT_CTRL); }
-    else if (key == "ralt" || key == "raltgr") { Keyboard.press(KEY_RIGHT_ALT); delay(10); Keyboard.release(KEY_RIGHT_ALT); }
-    else if (key == "rshift") { Keyboard.press(KEY_RIGHT_SHIFT); delay(10); Keyboard.release(KEY_RIGHT_SHIFT); }
-    #ifdef KEY_MEDIA_PLAY_PAUSE
-    else if (key == "play" || key == "playpause") { Keyboard.press(KEY_MEDIA_PLAY_PAUSE); delay(10); Keyboard.release(KEY_MEDIA_PLAY_PAUSE); }
-    #endif
-    #ifdef KEY_MEDIA_STOP
-    else if (key == "stop") { Keyboard.press(KEY_MEDIA_STOP); delay(10); Keyboard.release(KEY_MEDIA_STOP); }
-    #endif
-    #ifdef KEY_MEDIA_NEXT_TRACK
-    else if (key == "next" || key == "nexttrack") { Keyboard.press(KEY_MEDIA_NEXT_TRACK); delay(10); Keyboard.release(KEY_MEDIA_NEXT_TRACK); }
-    #endif
-    #ifdef KEY_MEDIA_PREV_TRACK
-    else if (key == "prev" || key == "prevtrack") { Keyboard.press(KEY_MEDIA_PREV_TRACK); delay(10); Keyboard.release(KEY_MEDIA_PREV_TRACK); }
-    #endif
-    #ifdef KEY_MEDIA_VOLUME_UP
-    else if (key == "volup" || key == "volumeup") { Keyboard.press(KEY_MEDIA_VOLUME_UP); delay(10); Keyboard.release(KEY_MEDIA_VOLUME_UP); }
-    #endif
-    #ifdef KEY_MEDIA_VOLUME_DOWN
-    else if (key == "voldown" || key == "volumedown") { Keyboard.press(KEY_MEDIA_VOLUME_DOWN); delay(10); Keyboard.release(KEY_MEDIA_VOLUME_DOWN); }
-    #endif
-    #ifdef KEY_MEDIA_VOLUME_MUTE
-    else if (key == "mute" || key == "volumemute") { Keyboard.press(KEY_MEDIA_VOLUME_MUTE); delay(10); Keyboard.release(KEY_MEDIA_VOLUME_MUTE); }
-    #endif
-    // Handle single-character keys: a-z, 0-9, and other printable ASCII characters
-    else if (key.length() == 1) {
-      char c = key[0];
-      Keyboard.press((uint8_t)c);
-      delay(10);
-      Keyboard.release((uint8_t)c);
-    }
-    else if (key.indexOf('+') >= 0) {
-      std::vector<String> parts;
-      int start = 0;
-      while (true) {
-        int p = key.indexOf('+', start);
-        if (p < 0) { parts.push_back(key.substring(start)); break; }
-        parts.push_back(key.substring(start, p));
-        start = p + 1;
-      }
-      for (size_t i = 0; i + 1 < parts.size(); ++i) {
-        String m = parts[i]; m.toLowerCase();
-        if (m == "ctrl") Keyboard.press(KEY_LEFT_CTRL);
-        else if (m == "alt") Keyboard.press(KEY_LEFT_ALT);
-        else if (m == "shift") Keyboard.press(KEY_LEFT_SHIFT);
-        else if (m == "win" || m == "gui" || m == "windows") Keyboard.press(KEY_LEFT_GUI);
-        else if (m == "rctrl" || m == "rcontrol") Keyboard.press(KEY_RIGHT_CTRL);
-        else if (m == "ralt" || m == "raltgr") Keyboard.press(KEY_RIGHT_ALT);
-        else if (m == "rshift") Keyboard.press(KEY_RIGHT_SHIFT);
-        else if (m == "rwin" || m == "rgui" || m == "rwindows") Keyboard.press(KEY_RIGHT_GUI);
-      }
-      String last = parts.back(); last.toLowerCase();
-      bool pressed = false;
-      if (last.length() == 1) { Keyboard.press((uint8_t)last[0]); pressed = true; }
-      else {
-        if (last == "enter" || last == "return") { Keyboard.press(KEY_RETURN); pressed = true; }
-        else if (last == "tab") { Keyboard.press(KEY_TAB); pressed = true; }
-        else if (last == "esc" || last == "escape") { Keyboard.press(KEY_ESC); pressed = true; }
-        else if (last == "space") { Keyboard.press(' '); pressed = true; }
-        else if (last == "up") { Keyboard.press(KEY_UP_ARROW); pressed = true; }
-        else if (last == "down") { Keyboard.press(KEY_DOWN_ARROW); pressed = true; }
-        else if (last == "left") { Keyboard.press(KEY_LEFT_ARROW); pressed = true; }
-        else if (last == "right") { Keyboard.press(KEY_RIGHT_ARROW); pressed = true; }
-        else if (last == "home") { Keyboard.press(KEY_HOME); pressed = true; }
-        else if (last == "end") { Keyboard.press(KEY_END); pressed = true; }
-        else if (last == "pageup") { Keyboard.press(KEY_PAGE_UP); pressed = true; }
-        else if (last == "pagedown") { Keyboard.press(KEY_PAGE_DOWN); pressed = true; }
-        else if (last == "delete") { Keyboard.press(KEY_DELETE); pressed = true; }
-        else if (last == "backspace") { Keyboard.press(KEY_BACKSPACE); pressed = true; }
-        else if (last.startsWith("f")) {
-          int fn = last.substring(1).toInt();
-          switch (fn) {
-            case 1: Keyboard.press(KEY_F1); pressed = true; break;
-            case 2: Keyboard.press(KEY_F2); pressed = true; break;
-            case 3: Keyboard.press(KEY_F3); pressed = true; break;
-            case 4: Keyboard.press(KEY_F4); pressed = true; break;
-            case 5: Keyboard.press(KEY_F5); pressed = true; break;
-            case 6: Keyboard.press(KEY_F6); pressed = true; break;
-            case 7: Keyboard.press(KEY_F7); pressed = true; break;
-            case 8: Keyboard.press(KEY_F8); pressed = true; break;
-            case 9: Keyboard.press(KEY_F9); pressed = true; break;
-            case 10: Keyboard.press(KEY_F10); pressed = true; break;
-            case 11: Keyboard.press(KEY_F11); pressed = true; break;
-            case 12: Keyboard.press(KEY_F12); pressed = true; break;
-          }
-        }
-      }
-      delay(10);
-      if (pressed) {
-        if (last.length() == 1) Keyboard.release((uint8_t)last[0]);
-        else {
-          if (last == "enter" || last == "return") Keyboard.release(KEY_RETURN);
-          else if (last == "tab") Keyboard.release(KEY_TAB);
-          else if (last == "esc" || last == "escape") Keyboard.release(KEY_ESC);
-          else if (last == "space") Keyboard.release(' ');
-          else if (last == "up") Keyboard.release(KEY_UP_ARROW);
-          else if (last == "down") Keyboard.release(KEY_DOWN_ARROW);
-          else if (last == "left") Keyboard.release(KEY_LEFT_ARROW);
-          else if (last == "right") Keyboard.release(KEY_RIGHT_ARROW);
-          else if (last == "home") Keyboard.release(KEY_HOME);
-          else if (last == "end") Keyboard.release(KEY_END);
-          else if (last == "pageup") Keyboard.release(KEY_PAGE_UP);
-          else if (last == "pagedown") Keyboard.release(KEY_PAGE_DOWN);
-          else if (last == "delete") Keyboard.release(KEY_DELETE);
-          else if (last == "backspace") Keyboard.release(KEY_BACKSPACE);
-          else if (last.startsWith("f")) {
-            int fn = last.substring(1).toInt();
-            switch (fn) {
-              case 1: Keyboard.release(KEY_F1); break;
-              case 2: Keyboard.release(KEY_F2); break;
-              case 3: Keyboard.release(KEY_F3); break;
-              case 4: Keyboard.release(KEY_F4); break;
-              case 5: Keyboard.release(KEY_F5); break;
-              case 6: Keyboard.release(KEY_F6); break;
-              case 7: Keyboard.release(KEY_F7); break;
-              case 8: Keyboard.release(KEY_F8); break;
-              case 9: Keyboard.release(KEY_F9); break;
-              case 10: Keyboard.release(KEY_F10); break;
-              case 11: Keyboard.release(KEY_F11); break;
-              case 12: Keyboard.release(KEY_F12); break;
-            }
-          }
-        }
-      }
-      for (size_t i = parts.size(); i-- > 0; ) {
-        String m = parts[i]; m.toLowerCase();
-        if (m == "ctrl") Keyboard.release(KEY_LEFT_CTRL);
-        else if (m == "alt") Keyboard.release(KEY_LEFT_ALT);
-        else if (m == "shift") Keyboard.release(KEY_LEFT_SHIFT);
-        else if (m == "win" || m == "gui" || m == "windows") Keyboard.release(KEY_LEFT_GUI);
-        else if (m == "rctrl" || m == "rcontrol") Keyboard.release(KEY_RIGHT_CTRL);
-        else if (m == "ralt" || m == "raltgr") Keyboard.release(KEY_RIGHT_ALT);
-        else if (m == "rshift") Keyboard.release(KEY_RIGHT_SHIFT);
-        else if (m == "rwin" || m == "rgui" || m == "rwindows") Keyboard.release(KEY_RIGHT_GUI);
-      }
-    }
-  };
-
-  // Token parsing loop - process String character-by-character
-  for (size_t i = 0; i < text.length(); ++i) {
-    char c = text[i];
-
-    if (inToken) {
-      token += c;
-      int L = token.length();
-      if (L >= 2 && token.charAt(L-2) == '}' && token.charAt(L-1) == '}') {
-        String body = token.substring(0, L-2); body.trim();
-
-        if (body.startsWith("DELAY:")) {
-          long ms = body.substring(6).toInt();
-          if (ms < 0) ms = 0; if (ms > 5000) ms = 5000;
-          delay((uint32_t)ms);
-        } else if (body.startsWith("SPEED:")) {
-          long ms = body.substring(6).toInt();
-          if (ms < 0) ms = 0; if (ms > 200) ms = 200;
-          speedMs = (int)ms;
-        } else if (body.startsWith("KEY:")) {
-          String keyName = body.substring(4); keyName.trim();
-          sendKeyByName(keyName);
-        } else if (body.startsWith("TEXT:")) {
-          String txt = body.substring(5);
-          for (size_t k = 0; k < txt.length(); ++k) {
-            Keyboard.write((uint8_t)txt[k]);
-            if (speedMs > 0) delay(speedMs);
-          }
-        } else if (body.startsWith("MOUSE:")) {
-          String cmd = body.substring(6); cmd.trim();
-          if (cmd.equalsIgnoreCase("RESET")) {
-            // Move mouse to (0,0) - top-left corner
-            // Calculate delta from current position to origin
-            int dx = -mouseX;
-            int dy = -mouseY;
-            // Move in chunks to handle large distances - NO DELAY for speed
-            while (dx != 0 || dy != 0) {
-              int stepX = (dx > 127) ? 127 : ((dx < -127) ? -127 : dx);
-              int stepY = (dy > 127) ? 127 : ((dy < -127) ? -127 : dy);
-              Mouse.move(stepX, stepY);
-              dx -= stepX;
-              dy -= stepY;
-            }
-            mouseX = 0;
-            mouseY = 0;
-          } else if (cmd.startsWith("MOVE:")) {
-            // Absolute positioning: MOVE:x,y
-            String coords = cmd.substring(5);
-            int commaIdx = coords.indexOf(',');
-            if (commaIdx > 0) {
-              int targetX = coords.substring(0, commaIdx).toInt();
-              int targetY = coords.substring(commaIdx+1).toInt();
-              // Calculate delta from current to target
-              int dx = targetX - mouseX;
-              int dy = targetY - mouseY;
-              // Move in chunks (USB HID mouse reports are limited to -127 to 127)
-              // NO DELAY for speed - let USB handle the timing
-              while (dx != 0 || dy != 0) {
-                int stepX = (dx > 127) ? 127 : ((dx < -127) ? -127 : dx);
-                int stepY = (dy > 127) ? 127 : ((dy < -127) ? -127 : dy);
-                Mouse.move(stepX, stepY);
-                dx -= stepX;
-                dy -= stepY;
-              }
-              mouseX = targetX;
-              mouseY = targetY;
-            }
-          } else if (cmd.startsWith("MOVE_REL:") || cmd.startsWith("MOVE ")) {
-            // Relative movement: MOVE_REL:dx,dy or MOVE dx dy (legacy)
-            // This is the PREFERRED method for live recording (no edge-stopping)
-            String rest = cmd.startsWith("MOVE_REL:") ? cmd.substring(9) : cmd.substring(5);
-            int sepIdx = rest.indexOf(',');
-            if (sepIdx < 0) sepIdx = rest.indexOf(' ');
-            if (sepIdx > 0) {
-              int dx = rest.substring(0, sepIdx).toInt();
-              int dy = rest.substring(sepIdx+1).toInt();
-              Serial.print("[DEBUG] MOVE_REL dx=");
-              Serial.print(dx);
-              Serial.print(" dy=");
-              Serial.println(dy);
-              // Move in chunks for large distances - NO DELAY for speed
-              while (dx != 0 || dy != 0) {
-                int stepX = (dx > 127) ? 127 : ((dx < -127) ? -127 : dx);
-                int stepY = (dy > 127) ? 127 : ((dy < -127) ? -127 : dy);
-                Mouse.move(stepX, stepY);
-                dx -= stepX;
-                dy -= stepY;
-                mouseX += stepX;
-                mouseY += stepY;
-              }
-            }
-          } else if (cmd.startsWith("DOWN:")) {
-            String btn = cmd.substring(5); btn.trim(); btn.toLowerCase();
-            if (btn == "left") { Mouse.press(MOUSE_LEFT); }
-            else if (btn == "right") { Mouse.press(MOUSE_RIGHT); }
-            else if (btn == "middle") { Mouse.press(MOUSE_MIDDLE); }
-          } else if (cmd.startsWith("UP:")) {
-            String btn = cmd.substring(3); btn.trim(); btn.toLowerCase();
-            if (btn == "left") { Mouse.release(MOUSE_LEFT); }
-            else if (btn == "right") { Mouse.release(MOUSE_RIGHT); }
-            else if (btn == "middle") { Mouse.release(MOUSE_MIDDLE); }
-          } else if (cmd.startsWith("CLICK:") || cmd.startsWith("CLICK ")) {
-            String btn = cmd.substring(6); btn.trim(); btn.toLowerCase();
-            if (btn == "left") { Mouse.click(MOUSE_LEFT); }
-            else if (btn == "right") { Mouse.click(MOUSE_RIGHT); }
-            else if (btn == "middle") { Mouse.click(MOUSE_MIDDLE); }
-          } else if (cmd.startsWith("SCROLL:") || cmd.startsWith("SCROLL ")) {
-            int n = cmd.substring(7).toInt();
-            if (n > 0) { for (int j = 0; j < n; ++j) { Mouse.move(0, 0, 1); delay(10); } }
-            else if (n < 0) { for (int j = 0; j < -n; ++j) { Mouse.move(0, 0, -1); delay(10); } }
-          } else if (cmd.startsWith("HSCROLL:") || cmd.startsWith("HSCROLL ")) {
-            // Simulate horizontal scroll using Shift + vertical wheel (common OS mapping)
-            int n = cmd.substring(8).toInt();
-            int steps = (n > 0) ? n : -n;
-            int dir = (n > 0) ? 1 : -1; // + = right, - = left
-            for (int j = 0; j < steps; ++j) {
-              Keyboard.press(KEY_LEFT_SHIFT);
-              Mouse.move(0, 0, dir);
-              delay(10);
-              Keyboard.release(KEY_LEFT_SHIFT);
-            }
-          }
-        } else if (body.startsWith("GAMEPAD:")) {
-          String cmd = body.substring(8); cmd.trim();
-          auto mapButton = [](String n)->int {
-            n.toLowerCase();
-            if (n == "a" || n == "south") return BUTTON_A;
-            if (n == "b" || n == "east") return BUTTON_B;
-            if (n == "x" || n == "north") return BUTTON_X;
-            if (n == "y" || n == "west") return BUTTON_Y;
-            if (n == "tl" || n == "lb") return BUTTON_TL;
-            if (n == "tr" || n == "rb") return BUTTON_TR;
-            if (n == "tl2" || n == "lt") return BUTTON_TL2;
-            if (n == "tr2" || n == "rt") return BUTTON_TR2;
-            if (n == "select" || n == "back") return BUTTON_SELECT;
-            if (n == "start") return BUTTON_START;
-            if (n == "mode" || n == "home") return BUTTON_MODE;
-            if (n == "thumbl" || n == "ls") return BUTTON_THUMBL;
-            if (n == "thumbr" || n == "rs") return BUTTON_THUMBR;
-            return -1;
-          };
-          auto mapHat = [](String d)->uint8_t {
-            d.toLowerCase();
-            if (d == "center" || d == "neutral") return HAT_CENTER;
-            if (d == "up") return HAT_UP;
-            if (d == "up_right" || d == "upright") return HAT_UP_RIGHT;
-            if (d == "right") return HAT_RIGHT;
-            if (d == "down_right" || d == "downright") return HAT_DOWN_RIGHT;
-            if (d == "down") return HAT_DOWN;
-            if (d == "down_left" || d == "downleft") return HAT_DOWN_LEFT;
-            if (d == "left") return HAT_LEFT;
-            if (d == "up_left" || d == "upleft") return HAT_UP_LEFT;
-            return HAT_CENTER;
-          };
-          if (cmd.startsWith("PRESS ")) {
-            String bn = cmd.substring(6); bn.trim();
-            int b = mapButton(bn);
-            if (b >= 0) Gamepad.pressButton((uint8_t)b);
-          } else if (cmd.startsWith("RELEASE ")) {
-            String bn = cmd.substring(8); bn.trim();
-            int b = mapButton(bn);
-            if (b >= 0) Gamepad.releaseButton((uint8_t)b);
-          } else if (cmd.startsWith("DPAD ")) {
-            String dn = cmd.substring(5); dn.trim();
-            Gamepad.hat(mapHat(dn));
-          } else if (cmd.startsWith("LS ")) {
-            String rest = cmd.substring(3);
-            int sp = rest.indexOf(' ');
-            if (sp > 0) {
-              int x = rest.substring(0, sp).toInt();
-              int y = rest.substring(sp+1).toInt();
-              if (x < -127) x = -127; if (x > 127) x = 127;
-              if (y < -127) y = -127; if (y > 127) y = 127;
-              Gamepad.leftStick((int8_t)x, (int8_t)y);
-            }
-          } else if (cmd.startsWith("RS ")) {
-            String rest = cmd.substring(3);
-            int sp = rest.indexOf(' ');
-            if (sp > 0) {
-              int z = rest.substring(0, sp).toInt();
-              int rz = rest.substring(sp+1).toInt();
-              if (z < -127) z = -127; if (z > 127) z = 127;
-              if (rz < -127) rz = -127; if (rz > 127) rz = 127;
-              Gamepad.rightStick((int8_t)z, (int8_t)rz);
-            }
-          } else if (cmd.startsWith("LT ")) {
-            int v = cmd.substring(3).toInt(); if (v < -127) v = -127; if (v > 127) v = 127;
-            Gamepad.leftTrigger((int8_t)v);
-          } else if (cmd.startsWith("RT ")) {
-            int v = cmd.substring(3).toInt(); if (v < -127) v = -127; if (v > 127) v = 127;
-            Gamepad.rightTrigger((int8_t)v);
-          }
-        } else if (body.startsWith("AUDIO:")) {
-          String cmd = body.substring(6); cmd.trim(); cmd.toLowerCase();
-          if (cmd.startsWith("volup")) {
-            int n = 1; int colon = cmd.indexOf(':'); if (colon > 0) n = cmd.substring(colon+1).toInt(); if (n < 1) n = 1; if (n > 10) n = 10;
-            #ifdef KEY_MEDIA_VOLUME_UP
-            for (int j = 0; j < n; ++j) { Keyboard.press(KEY_MEDIA_VOLUME_UP); delay(30); Keyboard.release(KEY_MEDIA_VOLUME_UP); }
-            #endif
-          } else if (cmd.startsWith("voldown")) {
-            int n = 1; int colon = cmd.indexOf(':'); if (colon > 0) n = cmd.substring(colon+1).toInt(); if (n < 1) n = 1; if (n > 10) n = 10;
-            #ifdef KEY_MEDIA_VOLUME_DOWN
-            for (int j = 0; j < n; ++j) { Keyboard.press(KEY_MEDIA_VOLUME_DOWN); delay(30); Keyboard.release(KEY_MEDIA_VOLUME_DOWN); }
-            #endif
-          } else if (cmd == "mute") {
-            #ifdef KEY_MEDIA_VOLUME_MUTE
-            Keyboard.press(KEY_MEDIA_VOLUME_MUTE); delay(30); Keyboard.release(KEY_MEDIA_VOLUME_MUTE);
-            #endif
-          } else if (cmd == "play" || cmd == "playpause") {
-            #ifdef KEY_MEDIA_PLAY_PAUSE
-            Keyboard.press(KEY_MEDIA_PLAY_PAUSE); delay(30); Keyboard.release(KEY_MEDIA_PLAY_PAUSE);
-            #endif
-          } else if (cmd == "stop") {
-            #ifdef KEY_MEDIA_STOP
-            Keyboard.press(KEY_MEDIA_STOP); delay(30); Keyboard.release(KEY_MEDIA_STOP);
-            #endif
-          } else if (cmd == "next" || cmd == "nexttrack") {
-            #ifdef KEY_MEDIA_NEXT_TRACK
-            Keyboard.press(KEY_MEDIA_NEXT_TRACK); delay(30); Keyboard.release(KEY_MEDIA_NEXT_TRACK);
-            #endif
-          } else if (cmd == "prev" || cmd == "prevtrack") {
-            #ifdef KEY_MEDIA_PREV_TRACK
-            Keyboard.press(KEY_MEDIA_PREV_TRACK); delay(30); Keyboard.release(KEY_MEDIA_PREV_TRACK);
-            #endif
-          }
-        } else {
-          String literal = String("{{") + body + String("}}");
-          for (size_t k = 0; k < literal.length(); ++k) {
-            Keyboard.write((uint8_t)literal[k]);
-            if (speedMs > 0) delay(speedMs);
-          }
-        }
-
-        inToken = false;
-        token = "";
-      }
-      continue;
-    }
-
-    if (!sawFirstBrace) {
-      if (c == '{') { sawFirstBrace = true; continue; }
-      // Skip newline characters to avoid typing Enter between tokens
-      if (c == '\n' || c == '\r') continue;
-      Keyboard.write((uint8_t)c);
-      if (speedMs > 0) delay(speedMs);
-    } else {
-      if (c == '{') {
-        inToken = true;
-        sawFirstBrace = false;
-        token = "";
-      } else {
-        Keyboard.write((uint8_t)'{'); if (speedMs > 0) delay(speedMs);
-        Keyboard.write((uint8_t)c); if (speedMs > 0) delay(speedMs);
-        sawFirstBrace = false;
-      }
-    }
-  }
-
-  if (inToken || sawFirstBrace) {
-    String leftover = String( (sawFirstBrace && !inToken) ? "{" : "" ) + token;
-    for (size_t k = 0; k < leftover.length(); ++k) {
-      Keyboard.write((uint8_t)leftover[k]);
-      if (speedMs > 0) delay(speedMs);
-    }
-  }
+  // Live Control uses a short key hold (10ms vs 50ms for SD files)
+  MacroVM vm(10);
+  MacroCompiler compiler(vm);
+  compiler.feed(text, len);
+  compiler.finish();
 }
 
 bool typeTextFileFromSD(const String& baseName) {
@@ -1329,15 +1204,7 @@ bool typeTextFileFromSD(const String& baseName) {
   }
 
   String filename = "/" + baseName + ".txt";
-  File f;
-  // Open via whichever backend was initialized
-  if (sdUseMMC) {
-    f = SD_MMC.open(filename.c_str(), FILE_READ);
-  } else {
-    f = SD.open(filename.c_str(), FILE_READ);
-  }
-
-  if (!f) {
+  if (!sdFS().exists(filename)) {
     showStartupMessage("File not found");
     delay(800);
     return false;
@@ -1346,559 +1213,64 @@ bool typeTextFileFromSD(const String& baseName) {
   showStartupMessage("Typing file...");
   delay(300);
 
-  // Macro-aware stream parser
-  // Supported tokens: {{DELAY:ms}}, {{SPEED:ms}}, {{KEY:name}}, {{TEXT:...}}
-  int speedMs = 3;
-  bool inToken = false;
-  bool sawFirstBrace = false;
-  String token;
-
-  // Local helper for KEY tokens (independent of BLE state)
-  auto sendKeyByName = [](String keyName) {
-    String key = keyName; key.toLowerCase();
-    if (key == "enter" || key == "return") { Keyboard.press(KEY_RETURN); delay(50); Keyboard.release(KEY_RETURN); }
-    else if (key == "backspace") { Keyboard.press(KEY_BACKSPACE); delay(50); Keyboard.release(KEY_BACKSPACE); }
-    else if (key == "delete") { Keyboard.press(KEY_DELETE); delay(50); Keyboard.release(KEY_DELETE); }
-    else if (key == "tab") { Keyboard.press(KEY_TAB); delay(50); Keyboard.release(KEY_TAB); }
-    else if (key == "space") { Keyboard.press(' '); delay(50); Keyboard.release(' '); }
-    else if (key == "escape" || key == "esc") { Keyboard.press(KEY_ESC); delay(50); Keyboard.release(KEY_ESC); }
-    else if (key == "up") { Keyboard.press(KEY_UP_ARROW); delay(50); Keyboard.release(KEY_UP_ARROW); }
-    else if (key == "down") { Keyboard.press(KEY_DOWN_ARROW); delay(50); Keyboard.release(KEY_DOWN_ARROW); }
-    else if (key == "left") { Keyboard.press(KEY_LEFT_ARROW); delay(50); Keyboard.release(KEY_LEFT_ARROW); }
-    else if (key == "right") { Keyboard.press(KEY_RIGHT_ARROW); delay(50); Keyboard.release(KEY_RIGHT_ARROW); }
-    else if (key == "home") { Keyboard.press(KEY_HOME); delay(50); Keyboard.release(KEY_HOME); }
-    else if (key == "end") { Keyboard.press(KEY_END); delay(50); Keyboard.release(KEY_END); }
-    else if (key == "pageup") { Keyboard.press(KEY_PAGE_UP); delay(50); Keyboard.release(KEY_PAGE_UP); }
-    else if (key == "pagedown") { Keyboard.press(KEY_PAGE_DOWN); delay(50); Keyboard.release(KEY_PAGE_DOWN); }
-    // Function keys
-    else if (key == "f1") { Keyboard.press(KEY_F1); delay(50); Keyboard.release(KEY_F1); }
-    else if (key == "f2") { Keyboard.press(KEY_F2); delay(50); Keyboard.release(KEY_F2); }
-    else if (key == "f3") { Keyboard.press(KEY_F3); delay(50); Keyboard.release(KEY_F3); }
-    else if (key == "f4") { Keyboard.press(KEY_F4); delay(50); Keyboard.release(KEY_F4); }
-    else if (key == "f5") { Keyboard.press(KEY_F5); delay(50); Keyboard.release(KEY_F5); }
-    else if (key == "f6") { Keyboard.press(KEY_F6); delay(50); Keyboard.release(KEY_F6); }
-    else if (key == "f7") { Keyboard.press(KEY_F7); delay(50); Keyboard.release(KEY_F7); }
-    else if (key == "f8") { Keyboard.press(KEY_F8); delay(50); Keyboard.release(KEY_F8); }
-    else if (key == "f9") { Keyboard.press(KEY_F9); delay(50); Keyboard.release(KEY_F9); }
-    else if (key == "f10") { Keyboard.press(KEY_F10); delay(50); Keyboard.release(KEY_F10); }
-    else if (key == "f11") { Keyboard.press(KEY_F11); delay(50); Keyboard.release(KEY_F11); }
-    else if (key == "f12") { Keyboard.press(KEY_F12); delay(50); Keyboard.release(KEY_F12); }
-    // Lock keys (wrapped in #ifdef since not all boards support these)
-    #ifdef KEY_CAPS_LOCK
-    else if (key == "capslock" || key == "caps") { Keyboard.press(KEY_CAPS_LOCK); delay(50); Keyboard.release(KEY_CAPS_LOCK); }
-    #endif
-    #ifdef KEY_NUM_LOCK
-    else if (key == "numlock" || key == "num") { Keyboard.press(KEY_NUM_LOCK); delay(50); Keyboard.release(KEY_NUM_LOCK); }
-    #endif
-    #ifdef KEY_SCROLL_LOCK
-    else if (key == "scrolllock" || key == "scroll") { Keyboard.press(KEY_SCROLL_LOCK); delay(50); Keyboard.release(KEY_SCROLL_LOCK); }
-    #endif
-    // Print/Pause
-    #ifdef KEY_PRINT_SCREEN
-    else if (key == "printscreen" || key == "print") { Keyboard.press(KEY_PRINT_SCREEN); delay(50); Keyboard.release(KEY_PRINT_SCREEN); }
-    #endif
-    #ifdef KEY_PAUSE
-    else if (key == "pause" || key == "break") { Keyboard.press(KEY_PAUSE); delay(50); Keyboard.release(KEY_PAUSE); }
-    #endif
-    // Insert
-    else if (key == "insert" || key == "ins") { Keyboard.press(KEY_INSERT); delay(50); Keyboard.release(KEY_INSERT); }
-    // Windows/GUI keys
-    else if (key == "win" || key == "windows") { Keyboard.press(KEY_LEFT_GUI); delay(50); Keyboard.release(KEY_LEFT_GUI); }
-    else if (key == "rwin" || key == "rwindows") { Keyboard.press(KEY_RIGHT_GUI); delay(50); Keyboard.release(KEY_RIGHT_GUI); }
-    // Application/Menu keys
-    #ifdef KEY_MENU
-    else if (key == "menu" || key == "app") { Keyboard.press(KEY_MENU); delay(50); Keyboard.release(KEY_MENU); }
-    #endif
-    // Numpad keys (wrapped in #ifdef since not all boards support these)
-    #ifdef KEY_KP_0
-    else if (key == "kp0" || key == "numpad0") { Keyboard.press(KEY_KP_0); delay(50); Keyboard.release(KEY_KP_0); }
-    else if (key == "kp1" || key == "numpad1") { Keyboard.press(KEY_KP_1); delay(50); Keyboard.release(KEY_KP_1); }
-    else if (key == "kp2" || key == "numpad2") { Keyboard.press(KEY_KP_2); delay(50); Keyboard.release(KEY_KP_2); }
-    else if (key == "kp3" || key == "numpad3") { Keyboard.press(KEY_KP_3); delay(50); Keyboard.release(KEY_KP_3); }
-    else if (key == "kp4" || key == "numpad4") { Keyboard.press(KEY_KP_4); delay(50); Keyboard.release(KEY_KP_4); }
-    else if (key == "kp5" || key == "numpad5") { Keyboard.press(KEY_KP_5); delay(50); Keyboard.release(KEY_KP_5); }
-    else if (key == "kp6" || key == "numpad6") { Keyboard.press(KEY_KP_6); delay(50); Keyboard.release(KEY_KP_6); }
-    else if (key == "kp7" || key == "numpad7") { Keyboard.press(KEY_KP_7); delay(50); Keyboard.release(KEY_KP_7); }
-    else if (key == "kp8" || key == "numpad8") { Keyboard.press(KEY_KP_8); delay(50); Keyboard.release(KEY_KP_8); }
-    else if (key == "kp9" || key == "numpad9") { Keyboard.press(KEY_KP_9); delay(50); Keyboard.release(KEY_KP_9); }
-    else if (key == "kp_add" || key == "numpad_add") { Keyboard.press(KEY_KP_ADD); delay(50); Keyboard.release(KEY_KP_ADD); }
-    else if (key == "kp_subtract" || key == "numpad_subtract") { Keyboard.press(KEY_KP_SUBTRACT); delay(50); Keyboard.release(KEY_KP_SUBTRACT); }
-    else if (key == "kp_multiply" || key == "numpad_multiply") { Keyboard.press(KEY_KP_MULTIPLY); delay(50); Keyboard.release(KEY_KP_MULTIPLY); }
-    else if (key == "kp_divide" || key == "numpad_divide") { Keyboard.press(KEY_KP_DIVIDE); delay(50); Keyboard.release(KEY_KP_DIVIDE); }
-    else if (key == "kp_decimal" || key == "numpad_decimal" || key == "kp_dot") { Keyboard.press(KEY_KP_DECIMAL); delay(50); Keyboard.release(KEY_KP_DECIMAL); }
-    else if (key == "kp_enter" || key == "numpad_enter") { Keyboard.press(KEY_KP_ENTER); delay(50); Keyboard.release(KEY_KP_ENTER); }
-    #endif
-    // Right-side modifiers (for advanced combos)
-    else if (key == "rctrl" || key == "rcontrol") { Keyboard.press(KEY_RIGHT_CTRL); delay(50); Keyboard.release(KEY_RIGHT_CTRL); }
-    else if (key == "ralt" || key == "raltgr") { Keyboard.press(KEY_RIGHT_ALT); delay(50); Keyboard.release(KEY_RIGHT_ALT); }
-    else if (key == "rshift") { Keyboard.press(KEY_RIGHT_SHIFT); delay(50); Keyboard.release(KEY_RIGHT_SHIFT); }
-    // Media keys (may not be supported on all systems; gracefully ignored if unavailable)
-    #ifdef KEY_MEDIA_PLAY_PAUSE
-    else if (key == "play" || key == "playpause") { Keyboard.press(KEY_MEDIA_PLAY_PAUSE); delay(50); Keyboard.release(KEY_MEDIA_PLAY_PAUSE); }
-    #endif
-    #ifdef KEY_MEDIA_STOP
-    else if (key == "stop") { Keyboard.press(KEY_MEDIA_STOP); delay(50); Keyboard.release(KEY_MEDIA_STOP); }
-    #endif
-    #ifdef KEY_MEDIA_NEXT_TRACK
-    else if (key == "next" || key == "nexttrack") { Keyboard.press(KEY_MEDIA_NEXT_TRACK); delay(50); Keyboard.release(KEY_MEDIA_NEXT_TRACK); }
-    #endif
-    #ifdef KEY_MEDIA_PREV_TRACK
-    else if (key == "prev" || key == "prevtrack") { Keyboard.press(KEY_MEDIA_PREV_TRACK); delay(50); Keyboard.release(KEY_MEDIA_PREV_TRACK); }
-    #endif
-    #ifdef KEY_MEDIA_VOLUME_UP
-    else if (key == "volup" || key == "volumeup") { Keyboard.press(KEY_MEDIA_VOLUME_UP); delay(50); Keyboard.release(KEY_MEDIA_VOLUME_UP); }
-    #endif
-    #ifdef KEY_MEDIA_VOLUME_DOWN
-    else if (key == "voldown" || key == "volumedown") { Keyboard.press(KEY_MEDIA_VOLUME_DOWN); delay(50); Keyboard.release(KEY_MEDIA_VOLUME_DOWN); }
-    #endif
-    #ifdef KEY_MEDIA_VOLUME_MUTE
-    else if (key == "mute" || key == "volumemute") { Keyboard.press(KEY_MEDIA_VOLUME_MUTE); delay(50); Keyboard.release(KEY_MEDIA_VOLUME_MUTE); }
-    #endif
-    // Advanced modifier combinations: support multiple modifiers + named key
-    else if (key.indexOf('+') >= 0) {
-      // Parse tokens split by '+' and press all modifiers first
-      // Supported modifiers: ctrl, alt, shift, win, rctrl, ralt, rshift, rwin
-      // Final token can be a single character or a named key (e.g., f5, enter)
-      std::vector<String> parts;
-      int start = 0;
-      while (true) {
-        int p = key.indexOf('+', start);
-        if (p < 0) { parts.push_back(key.substring(start)); break; }
-        parts.push_back(key.substring(start, p));
-        start = p + 1;
-      }
-      // Press modifiers
-      for (size_t i = 0; i + 1 < parts.size(); ++i) {
-        String m = parts[i]; m.toLowerCase();
-        if (m == "ctrl") Keyboard.press(KEY_LEFT_CTRL);
-        else if (m == "alt") Keyboard.press(KEY_LEFT_ALT);
-        else if (m == "shift") Keyboard.press(KEY_LEFT_SHIFT);
-        else if (m == "win" || m == "gui" || m == "windows") Keyboard.press(KEY_LEFT_GUI);
-        else if (m == "rctrl" || m == "rcontrol") Keyboard.press(KEY_RIGHT_CTRL);
-        else if (m == "ralt" || m == "raltgr") Keyboard.press(KEY_RIGHT_ALT);
-        else if (m == "rshift") Keyboard.press(KEY_RIGHT_SHIFT);
-        else if (m == "rwin" || m == "rgui" || m == "rwindows") Keyboard.press(KEY_RIGHT_GUI);
-      }
-      // Press final key
-      String last = parts.back(); last.toLowerCase();
-      bool pressed = false;
-      if (last.length() == 1) {
-        Keyboard.press((uint8_t)last[0]); pressed = true;
-      } else {
-        // Named key support (subset sufficient for common combos)
-        if (last == "enter" || last == "return") { Keyboard.press(KEY_RETURN); pressed = true; }
-        else if (last == "tab") { Keyboard.press(KEY_TAB); pressed = true; }
-        else if (last == "esc" || last == "escape") { Keyboard.press(KEY_ESC); pressed = true; }
-        else if (last == "space") { Keyboard.press(' '); pressed = true; }
-        else if (last == "up") { Keyboard.press(KEY_UP_ARROW); pressed = true; }
-        else if (last == "down") { Keyboard.press(KEY_DOWN_ARROW); pressed = true; }
-        else if (last == "left") { Keyboard.press(KEY_LEFT_ARROW); pressed = true; }
-        else if (last == "right") { Keyboard.press(KEY_RIGHT_ARROW); pressed = true; }
-        else if (last == "home") { Keyboard.press(KEY_HOME); pressed = true; }
-        else if (last == "end") { Keyboard.press(KEY_END); pressed = true; }
-        else if (last == "pageup") { Keyboard.press(KEY_PAGE_UP); pressed = true; }
-        else if (last == "pagedown") { Keyboard.press(KEY_PAGE_DOWN); pressed = true; }
-        else if (last == "delete") { Keyboard.press(KEY_DELETE); pressed = true; }
-        else if (last == "backspace") { Keyboard.press(KEY_BACKSPACE); pressed = true; }
-        else if (last.startsWith("f")) {
-          int fn = last.substring(1).toInt();
-          switch (fn) {
-            case 1: Keyboard.press(KEY_F1); pressed = true; break;
-            case 2: Keyboard.press(KEY_F2); pressed = true; break;
-            case 3: Keyboard.press(KEY_F3); pressed = true; break;
-            case 4: Keyboard.press(KEY_F4); pressed = true; break;
-            case 5: Keyboard.press(KEY_F5); pressed = true; break;
-            case 6: Keyboard.press(KEY_F6); pressed = true; break;
-            case 7: Keyboard.press(KEY_F7); pressed = true; break;
-            case 8: Keyboard.press(KEY_F8); pressed = true; break;
-            case 9: Keyboard.press(KEY_F9); pressed = true; break;
-            case 10: Keyboard.press(KEY_F10); pressed = true; break;
-            case 11: Keyboard.press(KEY_F11); pressed = true; break;
-            case 12: Keyboard.press(KEY_F12); pressed = true; break;
-          }
-        }
-      }
-      delay(50);
-      // Release final key if pressed
-      if (pressed) {
-        if (last.length() == 1) Keyboard.release((uint8_t)last[0]);
-        else {
-          if (last == "enter" || last == "return") Keyboard.release(KEY_RETURN);
-          else if (last == "tab") Keyboard.release(KEY_TAB);
-          else if (last == "esc" || last == "escape") Keyboard.release(KEY_ESC);
-          else if (last == "space") Keyboard.release(' ');
-          else if (last == "up") Keyboard.release(KEY_UP_ARROW);
-          else if (last == "down") Keyboard.release(KEY_DOWN_ARROW);
-          else if (last == "left") Keyboard.release(KEY_LEFT_ARROW);
-          else if (last == "right") Keyboard.release(KEY_RIGHT_ARROW);
-          else if (last == "home") Keyboard.release(KEY_HOME);
-          else if (last == "end") Keyboard.release(KEY_END);
-          else if (last == "pageup") Keyboard.release(KEY_PAGE_UP);
-          else if (last == "pagedown") Keyboard.release(KEY_PAGE_DOWN);
-          else if (last == "delete") Keyboard.release(KEY_DELETE);
-          else if (last == "backspace") Keyboard.release(KEY_BACKSPACE);
-          else if (last.startsWith("f")) {
-            int fn = last.substring(1).toInt();
-            switch (fn) {
-              case 1: Keyboard.release(KEY_F1); break;
-              case 2: Keyboard.release(KEY_F2); break;
-              case 3: Keyboard.release(KEY_F3); break;
-              case 4: Keyboard.release(KEY_F4); break;
-              case 5: Keyboard.release(KEY_F5); break;
-              case 6: Keyboard.release(KEY_F6); break;
-              case 7: Keyboard.release(KEY_F7); break;
-              case 8: Keyboard.release(KEY_F8); break;
-              case 9: Keyboard.release(KEY_F9); break;
-              case 10: Keyboard.release(KEY_F10); break;
-              case 11: Keyboard.release(KEY_F11); break;
-              case 12: Keyboard.release(KEY_F12); break;
-            }
-          }
-        }
-      }
-      // Release modifiers (reverse order not strictly necessary here)
-      for (size_t i = parts.size(); i-- > 0; ) {
-        String m = parts[i]; m.toLowerCase();
-        if (m == "ctrl") Keyboard.release(KEY_LEFT_CTRL);
-        else if (m == "alt") Keyboard.release(KEY_LEFT_ALT);
-        else if (m == "shift") Keyboard.release(KEY_LEFT_SHIFT);
-        else if (m == "win" || m == "gui" || m == "windows") Keyboard.release(KEY_LEFT_GUI);
-        else if (m == "rctrl" || m == "rcontrol") Keyboard.release(KEY_RIGHT_CTRL);
-        else if (m == "ralt" || m == "raltgr") Keyboard.release(KEY_RIGHT_ALT);
-        else if (m == "rshift") Keyboard.release(KEY_RIGHT_SHIFT);
-        else if (m == "rwin" || m == "rgui" || m == "rwindows") Keyboard.release(KEY_RIGHT_GUI);
-      }
-    }
-  };
-
-  const size_t BUF_SZ = 256;
-  uint8_t buf[BUF_SZ];
-  while (true) {
-    int n = f.read(buf, BUF_SZ);
-    if (n <= 0) break;
-    for (int i = 0; i < n; ++i) {
-      char c = (char)buf[i];
-
-      if (inToken) {
-        token += c;
-        int L = token.length();
-        if (L >= 2 && token.charAt(L-2) == '}' && token.charAt(L-1) == '}') {
-          String body = token.substring(0, L-2);
-          body.trim();
-
-          if (body.startsWith("DELAY:")) {
-            long ms = body.substring(6).toInt();
-            if (ms < 0) ms = 0; if (ms > 5000) ms = 5000;
-            delay((uint32_t)ms);
-          } else if (body.startsWith("SPEED:")) {
-            long ms = body.substring(6).toInt();
-            if (ms < 0) ms = 0; if (ms > 200) ms = 200;
-            speedMs = (int)ms;
-          } else if (body.startsWith("KEY:")) {
-            String keyName = body.substring(4); keyName.trim();
-            sendKeyByName(keyName);
-          } else if (body.startsWith("TEXT:")) {
-            String text = body.substring(5);
-            for (size_t k = 0; k < text.length(); ++k) {
-              Keyboard.write((uint8_t)text[k]);
-              if (speedMs > 0) delay(speedMs);
-            }
-          } else if (body.startsWith("MOUSE:")) {
-            String cmd = body.substring(6); cmd.trim();
-            if (cmd.equalsIgnoreCase("RESET")) {
-              // Move mouse to (0,0) - top-left corner
-              int dx = -mouseX;
-              int dy = -mouseY;
-              while (dx != 0 || dy != 0) {
-                int stepX = (dx > 127) ? 127 : ((dx < -127) ? -127 : dx);
-                int stepY = (dy > 127) ? 127 : ((dy < -127) ? -127 : dy);
-                Mouse.move(stepX, stepY);
-                dx -= stepX;
-                dy -= stepY;
-                delay(1);
-              }
-              mouseX = 0;
-              mouseY = 0;
-            } else if (cmd.startsWith("MOVE:")) {
-              // Absolute positioning: MOVE:x,y
-              String coords = cmd.substring(5);
-              int commaIdx = coords.indexOf(',');
-              if (commaIdx > 0) {
-                int targetX = coords.substring(0, commaIdx).toInt();
-                int targetY = coords.substring(commaIdx+1).toInt();
-                int dx = targetX - mouseX;
-                int dy = targetY - mouseY;
-                while (dx != 0 || dy != 0) {
-                  int stepX = (dx > 127) ? 127 : ((dx < -127) ? -127 : dx);
-                  int stepY = (dy > 127) ? 127 : ((dy < -127) ? -127 : dy);
-                  Mouse.move(stepX, stepY);
-                  dx -= stepX;
-                  dy -= stepY;
-                  delay(1);
-                }
-                mouseX = targetX;
-                mouseY = targetY;
-              }
-            } else if (cmd.startsWith("MOVE_REL:") || cmd.startsWith("MOVE ")) {
-              // Relative movement: MOVE_REL:dx,dy or MOVE dx dy
-              String rest = cmd.startsWith("MOVE_REL:") ? cmd.substring(9) : cmd.substring(5);
-              int sepIdx = rest.indexOf(',');
-              if (sepIdx < 0) sepIdx = rest.indexOf(' ');
-              if (sepIdx > 0) {
-                int dx = rest.substring(0, sepIdx).toInt();
-                int dy = rest.substring(sepIdx+1).toInt();
-                while (dx != 0 || dy != 0) {
-                  int stepX = (dx > 127) ? 127 : ((dx < -127) ? -127 : dx);
-                  int stepY = (dy > 127) ? 127 : ((dy < -127) ? -127 : dy);
-                  Mouse.move(stepX, stepY);
-                  dx -= stepX;
-                  dy -= stepY;
-                  mouseX += stepX;
-                  mouseY += stepY;
-                  delay(1);
-                }
-              }
-            } else if (cmd.startsWith("DOWN:")) {
-              String btn = cmd.substring(5); btn.trim(); btn.toLowerCase();
-              if (btn == "left") { Mouse.press(MOUSE_LEFT); }
-              else if (btn == "right") { Mouse.press(MOUSE_RIGHT); }
-              else if (btn == "middle") { Mouse.press(MOUSE_MIDDLE); }
-            } else if (cmd.startsWith("UP:")) {
-              String btn = cmd.substring(3); btn.trim(); btn.toLowerCase();
-              if (btn == "left") { Mouse.release(MOUSE_LEFT); }
-              else if (btn == "right") { Mouse.release(MOUSE_RIGHT); }
-              else if (btn == "middle") { Mouse.release(MOUSE_MIDDLE); }
-            } else if (cmd.startsWith("CLICK:") || cmd.startsWith("CLICK ")) {
-              String btn = cmd.substring(6); btn.trim(); btn.toLowerCase();
-              if (btn == "left") { Mouse.click(MOUSE_LEFT); }
-              else if (btn == "right") { Mouse.click(MOUSE_RIGHT); }
-              else if (btn == "middle") { Mouse.click(MOUSE_MIDDLE); }
-            } else if (cmd.startsWith("SCROLL:") || cmd.startsWith("SCROLL ")) {
-              int n = cmd.substring(7).toInt();
-              if (n > 0) { for (int j = 0; j < n; ++j) { Mouse.move(0, 0, 1); delay(10); } }
-              else if (n < 0) { for (int j = 0; j < -n; ++j) { Mouse.move(0, 0, -1); delay(10); } }
-            } else if (cmd.startsWith("HSCROLL:") || cmd.startsWith("HSCROLL ")) {
-              int n = cmd.substring(8).toInt();
-              int steps = (n > 0) ? n : -n;
-              int dir = (n > 0) ? 1 : -1; // + = right, - = left
-              for (int j = 0; j < steps; ++j) {
-                Keyboard.press(KEY_LEFT_SHIFT);
-                Mouse.move(0, 0, dir);
-                delay(10);
-                Keyboard.release(KEY_LEFT_SHIFT);
-              }
-            }
-          } else if (body.startsWith("GAMEPAD:")) {
-            String cmd = body.substring(8); cmd.trim();
-            // Buttons: PRESS/RELEASE <name>
-            auto mapButton = [](String n)->int {
-              n.toLowerCase();
-              if (n == "a" || n == "south") return BUTTON_A;
-              if (n == "b" || n == "east") return BUTTON_B;
-              if (n == "x" || n == "north") return BUTTON_X;
-              if (n == "y" || n == "west") return BUTTON_Y;
-              if (n == "tl" || n == "lb") return BUTTON_TL;
-              if (n == "tr" || n == "rb") return BUTTON_TR;
-              if (n == "tl2" || n == "lt") return BUTTON_TL2;
-              if (n == "tr2" || n == "rt") return BUTTON_TR2;
-              if (n == "select" || n == "back") return BUTTON_SELECT;
-              if (n == "start") return BUTTON_START;
-              if (n == "mode" || n == "home") return BUTTON_MODE;
-              if (n == "thumbl" || n == "ls") return BUTTON_THUMBL;
-              if (n == "thumbr" || n == "rs") return BUTTON_THUMBR;
-              return -1;
-            };
-            auto mapHat = [](String d)->uint8_t {
-              d.toLowerCase();
-              if (d == "center" || d == "neutral") return HAT_CENTER;
-              if (d == "up") return HAT_UP;
-              if (d == "up_right" || d == "upright") return HAT_UP_RIGHT;
-              if (d == "right") return HAT_RIGHT;
-              if (d == "down_right" || d == "downright") return HAT_DOWN_RIGHT;
-              if (d == "down") return HAT_DOWN;
-              if (d == "down_left" || d == "downleft") return HAT_DOWN_LEFT;
-              if (d == "left") return HAT_LEFT;
-              if (d == "up_left" || d == "upleft") return HAT_UP_LEFT;
-              return HAT_CENTER;
-            };
-            if (cmd.startsWith("PRESS ")) {
-              String bn = cmd.substring(6); bn.trim();
-              int b = mapButton(bn);
-              if (b >= 0) Gamepad.pressButton((uint8_t)b);
-            } else if (cmd.startsWith("RELEASE ")) {
-              String bn = cmd.substring(8); bn.trim();
-              int b = mapButton(bn);
-              if (b >= 0) Gamepad.releaseButton((uint8_t)b);
-            } else if (cmd.startsWith("DPAD ")) {
-              String dn = cmd.substring(5); dn.trim();
-              Gamepad.hat(mapHat(dn));
-            } else if (cmd.startsWith("LS ")) {
-              String rest = cmd.substring(3);
-              int sp = rest.indexOf(' ');
-              if (sp > 0) {
-                int x = rest.substring(0, sp).toInt();
-                int y = rest.substring(sp+1).toInt();
-                if (x < -127) x = -127; if (x > 127) x = 127;
-                if (y < -127) y = -127; if (y > 127) y = 127;
-                Gamepad.leftStick((int8_t)x, (int8_t)y);
-              }
-            } else if (cmd.startsWith("RS ")) {
-              String rest = cmd.substring(3);
-              int sp = rest.indexOf(' ');
-              if (sp > 0) {
-                int z = rest.substring(0, sp).toInt();
-                int rz = rest.substring(sp+1).toInt();
-                if (z < -127) z = -127; if (z > 127) z = 127;
-                if (rz < -127) rz = -127; if (rz > 127) rz = 127;
-                Gamepad.rightStick((int8_t)z, (int8_t)rz);
-              }
-            } else if (cmd.startsWith("LT ")) {
-              int v = cmd.substring(3).toInt(); if (v < -127) v = -127; if (v > 127) v = 127;
-              Gamepad.leftTrigger((int8_t)v);
-            } else if (cmd.startsWith("RT ")) {
-              int v = cmd.substring(3).toInt(); if (v < -127) v = -127; if (v > 127) v = 127;
-              Gamepad.rightTrigger((int8_t)v);
-            }
-          } else if (body.startsWith("AUDIO:")) {
-            String cmd = body.substring(6); cmd.trim(); cmd.toLowerCase();
-            if (cmd.startsWith("VOLUP")) {
-              int n = 1; int colon = cmd.indexOf(':'); if (colon > 0) n = cmd.substring(colon+1).toInt(); if (n < 1) n = 1; if (n > 10) n = 10;
-              #ifdef KEY_MEDIA_VOLUME_UP
-              for (int j = 0; j < n; ++j) { Keyboard.press(KEY_MEDIA_VOLUME_UP); delay(30); Keyboard.release(KEY_MEDIA_VOLUME_UP); }
-              #endif
-            } else if (cmd.startsWith("VOLDOWN")) {
-              int n = 1; int colon = cmd.indexOf(':'); if (colon > 0) n = cmd.substring(colon+1).toInt(); if (n < 1) n = 1; if (n > 10) n = 10;
-              #ifdef KEY_MEDIA_VOLUME_DOWN
-              for (int j = 0; j < n; ++j) { Keyboard.press(KEY_MEDIA_VOLUME_DOWN); delay(30); Keyboard.release(KEY_MEDIA_VOLUME_DOWN); }
-              #endif
-            } else if (cmd == "MUTE") {
-              #ifdef KEY_MEDIA_VOLUME_MUTE
-              Keyboard.press(KEY_MEDIA_VOLUME_MUTE); delay(30); Keyboard.release(KEY_MEDIA_VOLUME_MUTE);
-              #endif
-            } else if (cmd == "PLAY" || cmd == "PLAYPAUSE") {
-              #ifdef KEY_MEDIA_PLAY_PAUSE
-              Keyboard.press(KEY_MEDIA_PLAY_PAUSE); delay(30); Keyboard.release(KEY_MEDIA_PLAY_PAUSE);
-              #endif
-            } else if (cmd == "STOP") {
-              #ifdef KEY_MEDIA_STOP
-              Keyboard.press(KEY_MEDIA_STOP); delay(30); Keyboard.release(KEY_MEDIA_STOP);
-              #endif
-            } else if (cmd == "NEXT" || cmd == "NEXTTRACK") {
-              #ifdef KEY_MEDIA_NEXT_TRACK
-              Keyboard.press(KEY_MEDIA_NEXT_TRACK); delay(30); Keyboard.release(KEY_MEDIA_NEXT_TRACK);
-              #endif
-            } else if (cmd == "PREV" || cmd == "PREVTRACK") {
-              #ifdef KEY_MEDIA_PREV_TRACK
-              Keyboard.press(KEY_MEDIA_PREV_TRACK); delay(30); Keyboard.release(KEY_MEDIA_PREV_TRACK);
-              #endif
-            }
-          } else {
-            String literal = String("{{") + body + String("}}");
-            for (size_t k = 0; k < literal.length(); ++k) {
-              Keyboard.write((uint8_t)literal[k]);
-              if (speedMs > 0) delay(speedMs);
-            }
-          }
-
-          inToken = false;
-          token = "";
-        }
-        continue;
-      }
-
-      if (!sawFirstBrace) {
-        if (c == '{') { sawFirstBrace = true; continue; }
-        // Skip newline characters to avoid typing Enter between tokens
-        if (c == '\n' || c == '\r') continue;
-        Keyboard.write((uint8_t)c);
-        if (speedMs > 0) delay(speedMs);
-      } else {
-        if (c == '{') {
-          inToken = true;
-          sawFirstBrace = false;
-          token = "";
-        } else {
-          Keyboard.write((uint8_t)'{'); if (speedMs > 0) delay(speedMs);
-          Keyboard.write((uint8_t)c); if (speedMs > 0) delay(speedMs);
-          sawFirstBrace = false;
-        }
-      }
-    }
-  }
-  f.close();
-
-  if (inToken || sawFirstBrace) {
-    String leftover = String( (sawFirstBrace && !inToken) ? "{" : "" ) + token;
-    for (size_t k = 0; k < leftover.length(); ++k) {
-      Keyboard.write((uint8_t)leftover[k]);
-      if (speedMs > 0) delay(speedMs);
-    }
-  }
+  // Compiled once to /<name>.mbc, then replayed from opcodes (50ms key hold)
+  macroPlayFile(sdFS(), filename, MACRO_FILE_KEY_HOLD_MS);
 
   showStartupMessage("File typed");
   delay(600);
   return true;
 }
-void listSDTextFiles(String fileList[15], int& count) {
-  // Scan SD for .txt files and populate fileList (up to 15)
-  count = 0;
-  if (!ensureSDReady()) return;
-
-  File root;
-  if (sdUseMMC) {
-    root = SD_MMC.open("/");
-  } else {
-    root = SD.open("/");
-  }
-  if (!root || !root.isDirectory()) return;
-
-  File file;
-  while (file = root.openNextFile()) {
-    if (!file.isDirectory()) {
-      String name = String(file.name());
-      // Check if it ends with .txt
-      if (name.endsWith(".txt")) {
-        // Extract the base name (remove .txt)
-        String base = name.substring(0, name.length() - 4);
-        fileList[count] = base;
-        count++;
-        if (count >= 15) break;
-      }
-    }
-    file.close();
+int countSDTextFiles() {
+  if (!ensureSDReady() || !macroIndexLoad(sdFS())) return 0;
+  return (int)macroIndexCount();
+}
+
+int readSDTextFiles(int first, String names[], int maxNames) {
+  // One window of the sorted index (the file menu's visible rows)
+  if (first < 0 || !ensureSDReady()) return 0;
+  MacroIndexCursor cur;
+  if (!macroIndexBegin(sdFS(), cur, (uint32_t)first)) return 0;
+  MacroIndexEntry entry;
+  int n = 0;
+  while (n < maxNames && macroIndexNext(cur, entry)) {
+    names[n++] = String(entry.name);
   }
-  root.close();
-
-  // Sort the collected basenames numerically if possible, otherwise lexicographically
-  auto isDigits = [](const String& s) {
-    if (s.length() == 0) return false;
-    for (size_t i = 0; i < s.length(); ++i) {
-      char c = s[i];
-      if (c < '0' || c > '9') return false;
-    }
+  macroIndexEnd(cur);
+  return n;
+}
+
+// Index record of the open file `f`. A record whose size or mtime no
+// longer match (edited over USB mass storage, card swapped without
+// REINDEX) or a file the index hasn't seen yet is rescanned first.
+// False if the index can't be written (read-only or full card).
+static bool currentIndexEntry(const String& baseName, File& f, MacroIndexEntry& entry) {
+  if (macroIndexFind(sdFS(), baseName, entry) &&
+      entry.size == (uint32_t)f.size() && entry.mtime == (uint32_t)f.getLastWrite()) {
     return true;
-  };
+  }
+  return macroIndexUpdate(sdFS(), baseName) && macroIndexFind(sdFS(), baseName, entry);
+}
 
-  for (int i = 0; i < count; ++i) {
-    for (int j = i + 1; j < count; ++j) {
-      bool di = isDigits(fileList[i]);
-      bool dj = isDigits(fileList[j]);
-      bool doSwap = false;
-      if (di && dj) {
-        if (fileList[i].toInt() > fileList[j].toInt()) doSwap = true;
-      } else {
-        if (fileList[i].compareTo(fileList[j]) > 0) doSwap = true;
-      }
-      if (doSwap) {
-        String tmp = fileList[i];
-        fileList[i] = fileList[j];
-        fileList[j] = tmp;
-      }
-    }
+// Format comes from the macro index (see currentIndexEntry()), else from
+// sampling the file
+static bool detectTextFileFormat(const String& baseName, MacroFileFormat& format) {
+  File f = sdFS().open(("/" + baseName + ".txt").c_str(), FILE_READ);
+  if (!f) return false;
+  MacroIndexEntry entry;
+  if (currentIndexEntry(baseName, f, entry)) {
+    format = (MacroFileFormat)entry.format;
+  } else {
+    char sample[MACRO_FORMAT_SAMPLE];
+    int n = f.read((uint8_t*)sample, sizeof(sample));
+    format = macroDetectFormat(sample, n > 0 ? n : 0);
   }
+  f.close();
+  return true;
 }
 
-// Auto-detect file format and process accordingly
+// One open per run: the first block decides the format (explicit header,
+// then the index's cached format, then the detectors) and the same File
+// is handed to the engine
 void processTextFileAuto(const String& baseName) {
   startUSBMode(MODE_HID);
 
@@ -1909,100 +1281,101 @@ void processTextFileAuto(const String& baseName) {
   }
 
   String filename = "/" + baseName + ".txt";
-  File f;
-  
-  if (sdUseMMC) {
-    f = SD_MMC.open(filename.c_str(), FILE_READ);
-  } else {
-    f = SD.open(filename.c_str(), FILE_READ);
-  }
-
+  File f = sdFS().open(filename.c_str(), FILE_READ);
   if (!f) {
     showStartupMessage("File not found");
     delay(800);
     return;
   }
 
-  // Read first ~512 bytes to detect format
-  String sample = "";
-  int bytesRead = 0;
-  while (f.available() && bytesRead < 512) {
-    char c = f.read();
-    sample += c;
-    bytesRead++;
+  char head[MACRO_FORMAT_SAMPLE];
+  int n = f.read((uint8_t*)head, sizeof(head));
+  size_t headLen = n > 0 ? n : 0;
+  size_t headerLen = macroHeaderLength(head, headLen);
+  MacroFileFormat format = macroDetectFormat(head, headLen);
+  MacroIndexEntry entry;
+  // The indexed format is sniffed past any comment block
+  if (headerLen == 0 && currentIndexEntry(baseName, f, entry)) {
+    format = (MacroFileFormat)entry.format;
   }
-  f.close();
 
-  // Detect format: Advanced > DuckyScript > Macro
-  bool isAdvanced = isAdvancedScript(sample);
-  bool isDucky = !isAdvanced && isDuckyScriptFile(sample);
+  if (format == MACRO_FORMAT_MACRO) {
+    showStartupMessage("Typing file...");
+    // Compiled once to /<name>.mbc, then replayed from opcodes (50ms key hold)
+    macroPlayFile(sdFS(), f, filename, MACRO_FILE_KEY_HOLD_MS);
+    f.close();
+    showStartupMessage("File typed");
+    delay(600);
+    return;
+  }
 
-  if (isAdvanced) {
+  if (format == MACRO_FORMAT_DUCKY) {
+    // Streams line by line from the file, past the header
+    showStartupMessage("DuckyScript");
+    f.seek(headerLen);
+    processDuckyScriptFile(f);
+    f.close();
+  } else {
+    // Advanced scripts need every line (loops jump back): the file past
+    // the header is read once into the script arena
     showStartupMessage("Advanced script");
-    delay(300);
-    
-    // Re-open and read entire file
-    if (sdUseMMC) {
-      f = SD_MMC.open(filename.c_str(), FILE_READ);
-    } else {
-      f = SD.open(filename.c_str(), FILE_READ);
-    }
-    
-    if (!f) {
-      showStartupMessage("File read error");
-      delay(800);
-      return;
-    }
-    
-    String content = "";
-    while (f.available()) {
-      content += (char)f.read();
-    }
+    f.seek(headerLen);
+    scriptSetTickMs(getScriptTickMs());
+    bool ran = executeAdvancedScriptFile(f);
     f.close();
-    
-    showStartupMessage("Executing...");
-    delay(200);
-    
-    executeAdvancedScript(content);
-    
-    showStartupMessage("Script complete");
-    delay(600);
-  } else if (isDucky) {
-    showStartupMessage("DuckyScript detected");
-    delay(300);
-    
-    // Re-open and read entire file
-    if (sdUseMMC) {
-      f = SD_MMC.open(filename.c_str(), FILE_READ);
-    } else {
-      f = SD.open(filename.c_str(), FILE_READ);
-    }
-    
-    if (!f) {
-      showStartupMessage("File read error");
+    if (!ran) {
+      sendBLEResponse("ERROR: Script too large for free memory");
+      showStartupMessage("Script too large");
       delay(800);
       return;
     }
-    
-    String content = "";
-    while (f.available()) {
-      content += (char)f.read();
+    sendScriptStats();
+  }
+  showStartupMessage("Script complete");
+  delay(600);
+}
+
+// Live Control frames still go out while a main block runs; any other
+// command waits for the script, so it is refused
+bool scriptStopRequested() {
+  while (isBLEDataAvailable()) {
+    String line = readBLEData();
+    if (liveControlFrame(line.c_str(), line.length())) continue;
+    line.trim();
+    if (line.equalsIgnoreCase("STOP")) {
+      sendBLEResponse("OK: Script stopped");
+      return true;
     }
-    f.close();
-    
-    showStartupMessage("Executing...");
-    delay(200);
-    
-    processDuckyScript(content);
-    
-    showStartupMessage("Script complete");
-    delay(600);
-  } else {
-    showStartupMessage("Macro format");
-    delay(300);
-    
-    // Use existing macro processor
-    typeTextFileFromSD(baseName);
+    if (line.length() > 0) sendBLEResponse("ERROR: Script running (send STOP)");
+  }
+  return false;
+}
+
+// Start a macro-format file on the background player (stepped by
+// servicePlayback() from loop()). Only PLAYBACK_NOT_MACRO should fall
+// back to processTextFileAuto(); a macro whose cache can't be written is
+// an error rather than a blocking synchronous run.
+PlaybackStart startMacroPlayback(const String& baseName, uint16_t tempoPct) {
+  if (currentUSBMode != MODE_HID) {
+    startUSBMode(MODE_HID);
+  }
+  if (!ensureSDReady()) return PLAYBACK_NO_SD;
+
+  String filename = "/" + baseName + ".txt";
+  MacroFileFormat format;
+  if (!detectTextFileFormat(baseName, format) || format != MACRO_FORMAT_MACRO) return PLAYBACK_NOT_MACRO;
+  if (!macroPlaybackStart(sdFS(), filename, tempoPct, getPlaybackMinGap())) return PLAYBACK_CACHE_FAILED;
+  macroIndexSetCached(sdFS(), baseName, true);  // start compiled or reused the .mbc
+  playbackName = baseName;
+  return PLAYBACK_STARTED;
+}
+
+void servicePlayback() {
+  if (!macroPlaybackActive()) return;
+  if (!macroPlaybackStep()) {
+    sendBLEResponse("OK: Playback complete - " + String(macroPlaybackElapsedMs()) + " ms (recorded delays " +
+                    String(macroPlaybackRecordedMs()) + " ms)");
+    sendPlaybackTiming();
   }
 }
 
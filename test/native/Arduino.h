@@ -0,0 +1,46 @@
+#ifndef NATIVE_ARDUINO_H
+#define NATIVE_ARDUINO_H
+
+/*
+ * Host stand-in for the parts of the Arduino core used by the modules
+ * under host test (keytable, padframe, scriptengine, duckyscript). Only
+ * what those files touch; timing and pins are provided by the test
+ * program.
+ */
+
+#include <ctype.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+#define HIGH 1
+#define LOW 0
+
+unsigned long millis();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+int digitalRead(int pin);
+
+class String {
+public:
+  String(const char* s = "") : s(s ? s : "") {}
+  unsigned int length() const { return s.size(); }
+  const char* c_str() const { return s.c_str(); }
+  bool concat(const char* p, unsigned int n) { s.append(p, n); return true; }
+  long toInt() const { return atol(s.c_str()); }
+
+private:
+  std::string s;
+};
+
+class EspClass {
+public:
+  uint32_t getCycleCount();
+  uint32_t getCpuFreqMHz() { return 240; }
+  uint32_t getMaxAllocHeap();
+};
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef NATIVE_FS_H
+#define NATIVE_FS_H
+
+#include <Arduino.h>
+
+// An always-empty file: file I/O isn't exercised by the host tests
+namespace fs {
+class File {
+public:
+  size_t size() { return 0; }
+  size_t position() { return 0; }
+  int read(uint8_t*, size_t) { return 0; }
+};
+class FS;
+}  // namespace fs
+
+using fs::File;
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef NATIVE_USBHIDGAMEPAD_H
+#define NATIVE_USBHIDGAMEPAD_H
+
+#include <Arduino.h>
+
+// Button numbers and hat values as defined by arduino-esp32
+#define BUTTON_A 0
+#define BUTTON_B 1
+#define BUTTON_X 3
+#define BUTTON_Y 4
+#define BUTTON_TL 6
+#define BUTTON_TR 7
+#define BUTTON_TL2 8
+#define BUTTON_TR2 9
+#define BUTTON_SELECT 10
+#define BUTTON_START 11
+#define BUTTON_MODE 12
+#define BUTTON_THUMBL 13
+#define BUTTON_THUMBR 14
+
+#define HAT_CENTER 0
+#define HAT_UP 1
+#define HAT_UP_RIGHT 2
+#define HAT_RIGHT 3
+#define HAT_DOWN_RIGHT 4
+#define HAT_DOWN 5
+#define HAT_DOWN_LEFT 6
+#define HAT_LEFT 7
+#define HAT_UP_LEFT 8
+
+class USBHIDGamepad {
+public:
+  bool send(int8_t x, int8_t y, int8_t z, int8_t rz, int8_t rx, int8_t ry,
+            uint8_t hat, uint32_t buttons);
+};
+
+#endif
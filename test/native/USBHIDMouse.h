@@ -0,0 +1,12 @@
+#ifndef NATIVE_USBHIDMOUSE_H
+#define NATIVE_USBHIDMOUSE_H
+
+#include <Arduino.h>
+
+#define MOUSE_LEFT 0x01
+#define MOUSE_RIGHT 0x02
+#define MOUSE_MIDDLE 0x04
+
+class USBHIDMouse {};
+
+#endif
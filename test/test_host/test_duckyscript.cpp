@@ -0,0 +1,35 @@
+#include <unity.h>
+#include <string>
+#include "duckyscript.h"
+
+extern std::string hostKeyLog;  // test_main.cpp
+
+static std::string runScript(const char* script) {
+  hostKeyLog.clear();
+  DuckyScriptStream stream;
+  stream.feed(script, strlen(script));
+  stream.finish();
+  return hostKeyLog;
+}
+
+static void test_string_and_keys() {
+  TEST_ASSERT_EQUAL_STRING("hi<b0>", runScript("STRING hi\nENTER\n").c_str());
+  TEST_ASSERT_EQUAL_STRING("a\r\n", runScript("STRINGLN a").c_str());
+}
+
+static void test_repeat_replays_previous_command() {
+  TEST_ASSERT_EQUAL_STRING("xxx", runScript("STRING x\nREPEAT 2\n").c_str());
+  // Comments and blank lines don't replace the command REPEAT replays
+  TEST_ASSERT_EQUAL_STRING("xxx", runScript("STRING x\nREM note\n\nREPEAT 2\n").c_str());
+}
+
+static void test_repeat_skips_unknown_line() {
+  TEST_ASSERT_EQUAL_STRING("xxx", runScript("STRING x\nBOGUS\nREPEAT 2\n").c_str());
+  TEST_ASSERT_EQUAL_STRING("<b0><b0>", runScript("ENTER\nNOSUCHKEY\nREPEAT 1\n").c_str());
+}
+
+void runDuckyScriptTests() {
+  RUN_TEST(test_string_and_keys);
+  RUN_TEST(test_repeat_replays_previous_command);
+  RUN_TEST(test_repeat_skips_unknown_line);
+}
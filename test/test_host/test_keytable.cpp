@@ -0,0 +1,65 @@
+#include <unity.h>
+#include <USBHIDKeyboard.h>
+#include "keytable.h"
+
+static void test_names_case_insensitive() {
+  TEST_ASSERT_EQUAL_UINT8(KEY_RETURN, keyCodeFromName("enter"));
+  TEST_ASSERT_EQUAL_UINT8(KEY_RETURN, keyCodeFromName("ENTER"));
+  TEST_ASSERT_EQUAL_UINT8(KEY_F12, keyCodeFromName("f12"));
+  TEST_ASSERT_EQUAL_UINT8(KEY_LEFT_CTRL, keyCodeFromName("Ctrl"));
+  TEST_ASSERT_EQUAL_UINT8(KEY_RIGHT_GUI, keyCodeFromName("rwin"));
+}
+
+static void test_single_character_is_itself() {
+  TEST_ASSERT_EQUAL_UINT8('a', keyCodeFromName("a"));
+  TEST_ASSERT_EQUAL_UINT8('7', keyCodeFromName("7"));
+}
+
+static void test_unknown_and_partial_names() {
+  TEST_ASSERT_EQUAL_UINT8(0, keyCodeFromName("nosuchkey"));
+  TEST_ASSERT_EQUAL_UINT8(0, keyCodeFromName(""));
+  // Length-bounded: "enterx" cut to 5 characters is "enter"
+  TEST_ASSERT_EQUAL_UINT8(KEY_RETURN, keyCodeFromName("enterx", 5));
+}
+
+static void test_numpad_names() {
+  TEST_ASSERT_EQUAL_UINT8(KEY_KP_5, keyCodeFromName("numpad5"));
+  TEST_ASSERT_EQUAL_UINT8(KEY_KP_5, keyCodeFromName("KP5"));
+  TEST_ASSERT_EQUAL_UINT8(KEY_KP_ENTER, keyCodeFromName("kp_enter"));
+  TEST_ASSERT_EQUAL_UINT8(KEY_KP_PLUS, keyCodeFromName("numpad_add"));
+  TEST_ASSERT_EQUAL_UINT8(KEY_KP_DOT, keyCodeFromName("kp_dot"));
+}
+
+static void test_modifiers_only() {
+  TEST_ASSERT_EQUAL_UINT8(KEY_LEFT_SHIFT, keyModifierFromName("shift", 5));
+  TEST_ASSERT_EQUAL_UINT8(KEY_RIGHT_ALT, keyModifierFromName("ralt", 4));
+  TEST_ASSERT_EQUAL_UINT8(0, keyModifierFromName("enter", 5));
+}
+
+static void test_parse_combo() {
+  uint8_t codes[KEY_COMBO_MAX];
+  const char* spec = "ctrl+alt+delete";
+  TEST_ASSERT_EQUAL_UINT8(3, keyParseCombo(spec, strlen(spec), "+", codes, KEY_COMBO_MAX));
+  TEST_ASSERT_EQUAL_UINT8(KEY_LEFT_CTRL, codes[0]);
+  TEST_ASSERT_EQUAL_UINT8(KEY_LEFT_ALT, codes[1]);
+  TEST_ASSERT_EQUAL_UINT8(KEY_DELETE, codes[2]);
+
+  // DuckyScript spelling, unknown modifier skipped
+  spec = "CTRL BOGUS c";
+  TEST_ASSERT_EQUAL_UINT8(2, keyParseCombo(spec, strlen(spec), " ", codes, KEY_COMBO_MAX));
+  TEST_ASSERT_EQUAL_UINT8(KEY_LEFT_CTRL, codes[0]);
+  TEST_ASSERT_EQUAL_UINT8('c', codes[1]);
+
+  // Limited to maxCodes
+  spec = "ctrl+shift+alt+x";
+  TEST_ASSERT_EQUAL_UINT8(2, keyParseCombo(spec, strlen(spec), "+", codes, 2));
+}
+
+void runKeyTableTests() {
+  RUN_TEST(test_names_case_insensitive);
+  RUN_TEST(test_single_character_is_itself);
+  RUN_TEST(test_unknown_and_partial_names);
+  RUN_TEST(test_numpad_names);
+  RUN_TEST(test_modifiers_only);
+  RUN_TEST(test_parse_combo);
+}
@@ -0,0 +1,74 @@
+#include <unity.h>
+#include <string>
+#include "macroopt.h"
+
+class StringSink : public MacroTextSink {
+public:
+  std::string text;
+  void write(const char* s, size_t len) override { text.append(s, len); }
+};
+
+static std::string optimize(const char* text, uint16_t slackMs = 0) {
+  StringSink sink;
+  MacroOptimizer opt(sink, slackMs);
+  opt.acceptHeader();
+  opt.feed(text, strlen(text));
+  opt.finish();
+  return sink.text;
+}
+
+static void test_adjacent_delays_merge() {
+  TEST_ASSERT_EQUAL_STRING("{{DELAY:150}}\nx\n", optimize("{{DELAY:100}}{{DELAY:50}}x").c_str());
+}
+
+static void test_zero_delays_dropped() {
+  TEST_ASSERT_EQUAL_STRING("ab\n", optimize("{{DELAY:0}}a{{DELAY:0}}b").c_str());
+}
+
+static void test_relative_moves_fold() {
+  TEST_ASSERT_EQUAL_STRING("{{MOUSE:MOVE_REL:3,7}}\n{{KEY:enter}}\n",
+                           optimize("{{MOUSE:MOVE_REL:5,3}}{{MOUSE:MOVE_REL:-2,4}}{{KEY:enter}}").c_str());
+  // The recorder's dx_dy_MOVE_REL spelling folds the same way
+  TEST_ASSERT_EQUAL_STRING("{{MOUSE:MOVE_REL:6,4}}\n",
+                           optimize("{{MOUSE:5_3_MOVE_REL}}{{MOUSE:1_1_MOVE_REL}}").c_str());
+}
+
+static void test_text_and_single_keys_join() {
+  TEST_ASSERT_EQUAL_STRING("abc\n{{KEY:ctrl+c}}\n", optimize("a{{KEY:b}}c{{KEY:ctrl+c}}").c_str());
+}
+
+static void test_pause_splits_text_without_slack() {
+  TEST_ASSERT_EQUAL_STRING("a\n{{DELAY:20}}\nb\n", optimize("a{{DELAY:20}}b").c_str());
+}
+
+static void test_slack_moves_pause_after_run() {
+  TEST_ASSERT_EQUAL_STRING("ab\n{{DELAY:20}}\n", optimize("a{{DELAY:20}}b", 20).c_str());
+  // Longer than the slack: still split
+  TEST_ASSERT_EQUAL_STRING("a\n{{DELAY:21}}\nb\n", optimize("a{{DELAY:21}}b", 20).c_str());
+}
+
+static void test_header_kept() {
+  TEST_ASSERT_EQUAL_STRING("#!macro\nx\n{{DELAY:10}}\n", optimize("#!macro\nx{{DELAY:10}}").c_str());
+}
+
+static void test_play_time_kept() {
+  StringSink sink;
+  MacroOptimizer opt(sink);
+  const char* text = "{{DELAY:100}}{{DELAY:50}}{{MOUSE:MOVE_REL:1,1}}{{MOUSE:MOVE_REL:1,1}}x{{DELAY:0}}y";
+  opt.feed(text, strlen(text));
+  opt.finish();
+  TEST_ASSERT_EQUAL_UINT32(opt.stats().playMsIn, opt.stats().playMsOut);
+  TEST_ASSERT_EQUAL_UINT32(7, opt.stats().eventsIn);
+  TEST_ASSERT_EQUAL_UINT32(3, opt.stats().eventsOut);
+}
+
+void runMacroOptTests() {
+  RUN_TEST(test_adjacent_delays_merge);
+  RUN_TEST(test_zero_delays_dropped);
+  RUN_TEST(test_relative_moves_fold);
+  RUN_TEST(test_text_and_single_keys_join);
+  RUN_TEST(test_pause_splits_text_without_slack);
+  RUN_TEST(test_slack_moves_pause_after_run);
+  RUN_TEST(test_header_kept);
+  RUN_TEST(test_play_time_kept);
+}
@@ -0,0 +1,94 @@
+#include <unity.h>
+#include <string>
+#include "macrotok.h"
+
+// Records callbacks as "T(text)", "K(body)" and "H(header)"
+class TokLog : public MacroTokenizer {
+public:
+  std::string log;
+
+protected:
+  void onText(const char* s, size_t len) override { add('T', s, len); }
+  void onToken(char* body, size_t len) override { add('K', body, len); }
+  void onHeader(const char* s, size_t len) override { add('H', s, len); }
+
+private:
+  void add(char kind, const char* s, size_t len) {
+    log += kind;
+    log += '(';
+    log.append(s, len);
+    log += ')';
+  }
+};
+
+static std::string tokenize(const char* text) {
+  TokLog tok;
+  tok.feed(text, strlen(text));
+  tok.finish();
+  return tok.log;
+}
+
+static void test_text_and_tokens() {
+  TEST_ASSERT_EQUAL_STRING("T(ab)K(KEY:enter)T(cd)", tokenize("ab{{KEY:enter}}cd").c_str());
+}
+
+static void test_token_body_trimmed() {
+  TEST_ASSERT_EQUAL_STRING("K(DELAY:5)", tokenize("{{  DELAY:5 \t}}").c_str());
+}
+
+static void test_newlines_skipped_outside_tokens() {
+  TEST_ASSERT_EQUAL_STRING("T(a)T(b)K(KEY:x)", tokenize("a\r\nb\n{{KEY:x}}\n").c_str());
+}
+
+static void test_single_brace_is_text() {
+  TEST_ASSERT_EQUAL_STRING("T(a)T({)T(b)T(c)", tokenize("a{bc").c_str());
+  TEST_ASSERT_EQUAL_STRING("T(x)T({)", tokenize("x{").c_str());
+}
+
+static void test_token_split_across_feeds() {
+  TokLog tok;
+  const char* parts[] = {"ab{", "{KEY:", "ctrl+c}", "}cd"};
+  for (const char* p : parts) tok.feed(p, strlen(p));
+  tok.finish();
+  TEST_ASSERT_EQUAL_STRING("T(ab)K(KEY:ctrl+c)T(cd)", tok.log.c_str());
+}
+
+static void test_runaway_token_typed_as_text() {
+  std::string text = "{{" + std::string(MACRO_TOKEN_MAX, 'x');
+  std::string log = tokenize(text.c_str());
+  TEST_ASSERT_EQUAL_STRING(("T({{)T(" + std::string(MACRO_TOKEN_MAX, 'x') + ")").c_str(), log.c_str());
+}
+
+static void test_header_only_when_accepted() {
+  TokLog tok;
+  tok.acceptHeader();
+  const char* text = "#!ducky\nSTRING hi";
+  tok.feed(text, strlen(text));
+  tok.finish();
+  TEST_ASSERT_EQUAL_STRING("H(#!ducky\n)T(STRING hi)", tok.log.c_str());
+
+  // Without acceptHeader() the line is plain text
+  TEST_ASSERT_EQUAL_STRING("T(#!ducky)T(x)", tokenize("#!ducky\nx").c_str());
+}
+
+static void test_recorded_mouse_form() {
+  long dx, dy;
+  const char* action;
+  TEST_ASSERT_TRUE(macroParseRecordedMouse("5_-3_MOVE_REL", dx, dy, action));
+  TEST_ASSERT_EQUAL_INT(5, dx);
+  TEST_ASSERT_EQUAL_INT(-3, dy);
+  TEST_ASSERT_EQUAL_STRING("MOVE_REL", action);
+  TEST_ASSERT_FALSE(macroParseRecordedMouse("5_x_MOVE_REL", dx, dy, action));
+  TEST_ASSERT_FALSE(macroParseRecordedMouse("5_3_", dx, dy, action));
+}
+
+void runMacroTokTests() {
+  RUN_TEST(test_text_and_tokens);
+  RUN_TEST(test_token_body_trimmed);
+  RUN_TEST(test_newlines_skipped_outside_tokens);
+  RUN_TEST(test_single_brace_is_text);
+  RUN_TEST(test_token_split_across_feeds);
+  RUN_TEST(test_runaway_token_typed_as_text);
+  RUN_TEST(test_header_only_when_accepted);
+  RUN_TEST(test_recorded_mouse_form);
+}
@@ -0,0 +1,74 @@
+// Host unit tests for the modules that don't need the USB/BLE hardware:
+//
+//   pio test -e native
+//
+// This file holds the runner and the few firmware symbols the tested
+// modules link against; the tests themselves are in the other files.
+
+#include <unity.h>
+#include <USBHIDGamepad.h>
+#include <USBHIDKeyboard.h>
+#include <USBHIDMouse.h>
+#include <esp_timer.h>
+#include <string>
+#include "hidtyper.h"
+
+void runMacroTokTests();
+void runMacroOptTests();
+void runKeyTableTests();
+void runScriptExprTests();
+void runScriptBlockTests();
+void runDuckyScriptTests();
+
+// Fake clock: delays advance it instead of sleeping
+static int64_t fakeNowUs = 0;
+unsigned long millis() { return fakeNowUs / 1000; }
+void delay(uint32_t ms) { fakeNowUs += (int64_t)ms * 1000; }
+void delayMicroseconds(uint32_t us) { fakeNowUs += us; }
+int64_t esp_timer_get_time() { return fakeNowUs; }
+int digitalRead(int) { return HIGH; }
+
+EspClass ESP;
+uint32_t EspClass::getCycleCount() { return (uint32_t)fakeNowUs * 240; }
+uint32_t EspClass::getMaxAllocHeap() { return 64 * 1024; }
+
+// Keyboard output as text: typed characters as themselves, key presses
+// as <code> (hex)
+std::string hostKeyLog;
+
+USBHIDKeyboard Keyboard;
+size_t USBHIDKeyboard::write(uint8_t c) {
+  hostKeyLog += (char)c;
+  return 1;
+}
+void hidKeyPress(uint8_t k) {
+  char buf[8];
+  snprintf(buf, sizeof(buf), "<%02x>", k);
+  hostKeyLog += buf;
+}
+void hidKeyRelease(uint8_t) {}
+
+USBHIDMouse Mouse;
+USBHIDGamepad Gamepad;
+bool USBHIDGamepad::send(int8_t, int8_t, int8_t, int8_t, int8_t, int8_t, uint8_t, uint32_t) {
+  return true;
+}
+
+void hidLock() {}
+void hidUnlock() {}
+void processMacroText(const char*, size_t) {}
+bool scriptStopRequested() { return false; }
+
+void setUp() {}
+void tearDown() {}
+
+int main() {
+  UNITY_BEGIN();
+  runMacroTokTests();
+  runMacroOptTests();
+  runKeyTableTests();
+  runScriptExprTests();
+  runScriptBlockTests();
+  runDuckyScriptTests();
+  return UNITY_END();
+}
@@ -0,0 +1,67 @@
+#include <unity.h>
+#include "scriptengine.h"
+
+// Compile and link `script` the way a run does, one statement per line
+static void compile(ScriptContext& ctx, const char* script) {
+  ctx.reset();
+  size_t len = strlen(script);
+  ctx.arena.assign(script, script + len + 1);
+  char* text = ctx.arena.data();
+  size_t count = 1;
+  for (size_t i = 0; i < len; i++) {
+    if (text[i] == '\n') count++;
+  }
+  ctx.program.resize(count);
+  size_t start = 0;
+  for (size_t i = 0; i < count; i++) {
+    const char* nl = (const char*)memchr(text + start, '\n', len - start);
+    size_t end = nl ? nl - text : len;
+    compileScriptLine(ctx, i, text + start, end - start);
+    start = end + 1;
+  }
+  linkScriptBlocks(ctx);
+}
+
+static void test_unknown_calls_are_skipped() {
+  ScriptContext ctx;
+  compile(ctx, "foo(1, 2);\nHello (world)\nhello");
+  TEST_ASSERT_EQUAL_INT(STMT_NOP, ctx.program[0].kind);
+  TEST_ASSERT_EQUAL_INT(STMT_NOP, ctx.program[1].kind);
+  TEST_ASSERT_EQUAL_INT(STMT_TEXT, ctx.program[2].kind);
+}
+
+static void test_text_in_main_is_skipped() {
+  ScriptContext ctx;
+  compile(ctx,
+          "main {\n"
+          "if(get_val(XB1_RT)) {\n"
+          "set_val(XB1_A, 100);\n"
+          "} else {\n"
+          "set_val(XB1_A, 0);\n"
+          "}\n"
+          "}\n"
+          "hello");
+  TEST_ASSERT_EQUAL_INT(0, ctx.mainLine);
+  TEST_ASSERT_EQUAL_INT(STMT_NOP, ctx.program[1].kind);
+  TEST_ASSERT_EQUAL_INT(STMT_SET_VAL, ctx.program[2].kind);
+  TEST_ASSERT_EQUAL_INT(STMT_NOP, ctx.program[3].kind);
+  TEST_ASSERT_EQUAL_INT(STMT_NOP, ctx.program[5].kind);
+  // The skipped lines' braces pair up: main still ends at its own brace
+  TEST_ASSERT_EQUAL_INT(STMT_BLOCK_END, ctx.program[6].kind);
+  TEST_ASSERT_EQUAL_UINT16(6, ctx.program[0].jump);
+  TEST_ASSERT_EQUAL_INT(STMT_TEXT, ctx.program[7].kind);
+}
+
+static void test_text_in_combo_is_skipped() {
+  ScriptContext ctx;
+  compile(ctx, "combo rapid {\ntype this\nwait(10);\n}");
+  TEST_ASSERT_EQUAL_INT(STMT_NOP, ctx.program[1].kind);
+  TEST_ASSERT_EQUAL_INT(STMT_WAIT, ctx.program[2].kind);
+  TEST_ASSERT_EQUAL_UINT16(3, ctx.program[0].jump);
+}
+
+void runScriptBlockTests() {
+  RUN_TEST(test_unknown_calls_are_skipped);
+  RUN_TEST(test_text_in_main_is_skipped);
+  RUN_TEST(test_text_in_combo_is_skipped);
+}
@@ -0,0 +1,82 @@
+#include <unity.h>
+#include "scriptengine.h"
+
+// Compile and evaluate `text` against `ctx` (variables already interned)
+static int eval(ScriptContext& ctx, const char* text) {
+  ScriptExpr expr = compileExpression(ctx, text, strlen(text));
+  return evaluateExpression(ctx, expr);
+}
+
+static int eval(const char* text) {
+  ScriptContext ctx;
+  ctx.reset();
+  return eval(ctx, text);
+}
+
+static void test_precedence_and_parentheses() {
+  TEST_ASSERT_EQUAL_INT(14, eval("2 + 3 * 4"));
+  TEST_ASSERT_EQUAL_INT(20, eval("(2 + 3) * 4"));
+  TEST_ASSERT_EQUAL_INT(1, eval("10 - 4 - 5"));
+  TEST_ASSERT_EQUAL_INT(2, eval("20 / 5 / 2"));
+  TEST_ASSERT_EQUAL_INT(2, eval("17 % 5"));
+}
+
+static void test_unary() {
+  TEST_ASSERT_EQUAL_INT(-3, eval("-3"));
+  TEST_ASSERT_EQUAL_INT(3, eval("-(1 - 4)"));
+  TEST_ASSERT_EQUAL_INT(1, eval("!0"));
+  TEST_ASSERT_EQUAL_INT(0, eval("!5"));
+}
+
+static void test_division_by_zero_is_zero() {
+  TEST_ASSERT_EQUAL_INT(0, eval("7 / 0"));
+  TEST_ASSERT_EQUAL_INT(0, eval("7 % 0"));
+}
+
+static void test_comparisons_and_logic() {
+  TEST_ASSERT_EQUAL_INT(1, eval("3 < 4"));
+  TEST_ASSERT_EQUAL_INT(0, eval("3 >= 4"));
+  TEST_ASSERT_EQUAL_INT(1, eval("4 == 4"));
+  TEST_ASSERT_EQUAL_INT(1, eval("4 != 5"));
+  TEST_ASSERT_EQUAL_INT(1, eval("1 < 2 && 2 < 3"));
+  TEST_ASSERT_EQUAL_INT(1, eval("0 || 3 > 2"));
+  TEST_ASSERT_EQUAL_INT(0, eval("1 && 0"));
+}
+
+static void test_variables_read_at_run_time() {
+  ScriptContext ctx;
+  ctx.reset();
+  uint16_t x = ctx.intern("x", 1);
+  ScriptExpr expr = compileExpression(ctx, "x * 2 + 1", 9);
+  ctx.setVar(x, 5);
+  TEST_ASSERT_EQUAL_INT(11, evaluateExpression(ctx, expr));
+  ctx.setVar(x, -1);
+  TEST_ASSERT_EQUAL_INT(-1, evaluateExpression(ctx, expr));
+  // Unknown names are interned on first use and start at 0
+  TEST_ASSERT_EQUAL_INT(3, eval(ctx, "y + 3"));
+}
+
+static void test_compiles_to_rpn() {
+  ScriptContext ctx;
+  ctx.reset();
+  ScriptExpr expr = compileExpression(ctx, "1 + 2 * 3", 9);
+  TEST_ASSERT_EQUAL_UINT16(5, expr.count);
+  TEST_ASSERT_EQUAL_INT(SOP_CONST, ctx.code[expr.start].code);
+  TEST_ASSERT_EQUAL_INT(SOP_MUL, ctx.code[expr.start + 3].code);
+  TEST_ASSERT_EQUAL_INT(SOP_ADD, ctx.code[expr.start + 4].code);
+}
+
+static void test_unparsable_text_is_leading_number() {
+  TEST_ASSERT_EQUAL_INT(42, eval("42abc"));
+  TEST_ASSERT_EQUAL_INT(0, eval("(1 +"));
+}
+
+void runScriptExprTests() {
+  RUN_TEST(test_precedence_and_parentheses);
+  RUN_TEST(test_unary);
+  RUN_TEST(test_division_by_zero_is_zero);
+  RUN_TEST(test_comparisons_and_logic);
+  RUN_TEST(test_variables_read_at_run_time);
+  RUN_TEST(test_compiles_to_rpn);
+  RUN_TEST(test_unparsable_text_is_leading_number);
+}
@@ -0,0 +1,48 @@
+// Host build of the macro optimizer (same code as OPTIMIZE:file on the device)
+//
+//   g++ -std=c++11 -Iinclude tools/macroopt.cpp src/macroopt.cpp src/macrotok.cpp -o macroopt
+//   ./macroopt recording.txt [slackMs] > recording.opt.txt
+//
+// The optimized macro goes to stdout, the size/time report to stderr.
+
+#include "macroopt.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+class StdoutSink : public MacroTextSink {
+public:
+  void write(const char* s, size_t len) override { fwrite(s, 1, len, stdout); }
+};
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s file.txt [slackMs]\n", argv[0]);
+    return 2;
+  }
+  FILE* in = fopen(argv[1], "rb");
+  if (!in) {
+    perror(argv[1]);
+    return 1;
+  }
+  uint16_t slack = argc > 2 ? (uint16_t)atoi(argv[2]) : 0;
+
+  StdoutSink sink;
+  MacroOptimizer optimizer(sink, slack);
+  char buf[MACRO_FEED_CHUNK];
+  unsigned long bytesIn = 0;
+  size_t n;
+  optimizer.acceptHeader();
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+    bytesIn += n;
+    optimizer.feed(buf, n);
+  }
+  fclose(in);
+  optimizer.finish();
+
+  const MacroOptStats& st = optimizer.stats();
+  fprintf(stderr, "bytes %lu -> %lu, events %lu -> %lu, est. play %lu -> %lu ms\n",
+          bytesIn, (unsigned long)st.bytesOut,
+          (unsigned long)st.eventsIn, (unsigned long)st.eventsOut,
+          (unsigned long)st.playMsIn, (unsigned long)st.playMsOut);
+  return 0;
+}